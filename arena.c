@@ -0,0 +1,108 @@
+/**
+ * @file arena.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A slab-based arena allocator. Allocations are carved out of
+ * large slabs and are never freed one by one: the whole arena is
+ * released at once, in time proportional to the amount of slabs.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Size of the first slab. Every new slab doubles in size up to HT_SLAB_MAX.
+#define HT_SLAB_MIN 4096
+#define HT_SLAB_MAX (1 << 20)
+
+/**
+ * @brief Initializer function for an empty arena. No slab is
+ * allocated until the first allocation.
+ *
+ * @return HT_Arena* - The created arena.
+ */
+HT_Arena* HT_arena_create(void) {
+    HT_Arena* arena = malloc(sizeof(HT_Arena));
+    arena->slabs = NULL;
+    arena->next_slab_size = HT_SLAB_MIN;
+    arena->reserved = 0;
+    arena->used = 0;
+    return arena;
+}
+
+/**
+ * @brief Allocate a new slab able to hold at least `size` bytes and
+ * make it the one allocations are carved from. The remainder of the
+ * previous slab is abandoned.
+ *
+ * @param arena - The arena to grow.
+ * @param size - The minimum amount of usable bytes in the new slab.
+ */
+void _HT_arena_grow(HT_Arena* arena, size_t size) {
+    size_t slab_size = arena->next_slab_size;
+    while (slab_size < size)
+        slab_size *= 2;
+    if (arena->next_slab_size < HT_SLAB_MAX)
+        arena->next_slab_size *= 2;
+    HT_Slab* slab = malloc(sizeof(HT_Slab) + slab_size);
+    slab->next = arena->slabs;
+    slab->size = slab_size;
+    slab->used = 0;
+    arena->slabs = slab;
+    arena->reserved += sizeof(HT_Slab) + slab_size;
+}
+
+/**
+ * @brief Round an offset within a slab up so that the address it
+ * points to has the provided alignment.
+ *
+ * @param slab - The slab the offset points into.
+ * @param offset - The offset to round up.
+ * @param align - The alignment to reach. Must be a power of two.
+ * @return size_t - The aligned offset.
+ */
+size_t _HT_align(HT_Slab* slab, size_t offset, size_t align) {
+    uintptr_t address = (uintptr_t) (slab->data + offset);
+    return offset + (((address + align - 1) & ~(uintptr_t) (align - 1)) - address);
+}
+
+/**
+ * @brief Carve a block of memory out of the arena. The block stays
+ * valid until the arena is destroyed.
+ *
+ * @param arena - The arena to allocate from.
+ * @param size - The size of the block in bytes.
+ * @param align - The alignment of the block. Must be a power of two.
+ * @return void* - The allocated block.
+ */
+void* HT_arena_alloc(HT_Arena* arena, size_t size, size_t align) {
+    HT_Slab* slab = arena->slabs;
+    size_t offset = slab ? _HT_align(slab, slab->used, align) : 0;
+    if (!slab || offset + size > slab->size) {
+        _HT_arena_grow(arena, size + align);
+        slab = arena->slabs;
+        offset = _HT_align(slab, 0, align);
+    }
+    slab->used = offset + size;
+    arena->used += size;
+    return slab->data + offset;
+}
+
+/**
+ * @brief Destroy the provided arena and every block allocated from it.
+ *
+ * @param arena - The arena to destroy.
+ */
+void HT_arena_destroy(HT_Arena* arena) {
+    HT_Slab* slab = arena->slabs;
+    while (slab) {
+        HT_Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(arena);
+}
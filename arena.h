@@ -0,0 +1,33 @@
+/**
+ * @file arena.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for a slab-based arena allocator.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+
+struct HT_slab {
+    struct HT_slab * next;
+    size_t size; // Amount of usable bytes in `data`.
+    size_t used;
+    unsigned char data[];
+};
+
+struct HT_arena {
+    struct HT_slab * slabs; // The slab currently carved from comes first.
+    size_t next_slab_size;
+    size_t reserved; // Bytes obtained from malloc, including slab headers.
+    size_t used; // Bytes handed out through `HT_arena_alloc`.
+};
+
+typedef struct HT_slab HT_Slab;
+typedef struct HT_arena HT_Arena;
+
+HT_Arena* HT_arena_create(void);
+void* HT_arena_alloc(HT_Arena* arena, size_t size, size_t align);
+void HT_arena_destroy(HT_Arena* arena);
@@ -0,0 +1,605 @@
+/**
+ * @file bench.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Benchmark harness for the hash table implementations. Measures
+ * the throughput and latency percentiles of inserts, positive and
+ * negative lookups, updates and removals, for several table sizes, key
+ * lengths and key distributions, and prints one machine-readable record
+ * per measurement. With `--perf`, each record also gives the cache and
+ * branch misses per operation read from the processor's counters, and
+ * builds compiled with `-DHT_PROFILE` add the cycles `HT_Ht` spent per
+ * operation, hashing and allocating, which `--folded` writes as stacks
+ * for flame graphs.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "./hash_table.h"
+#include "./robin_hood.h"
+#include "./cuckoo_table.h"
+#include "./swiss_table.h"
+#include "./concurrent_table.h"
+#include "./sharded_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* One operation out of LATENCY_SAMPLE is timed on its own for the percentiles. */
+#define LATENCY_SAMPLE 8
+/* Skew of the Zipfian distribution, as used by YCSB. */
+#define ZIPF_THETA 0.99
+/* The maximum amount of arguments in a comma-separated option. */
+#define MAX_LIST 16
+/* The hardware counters read with `--perf`: L1 data read misses, last
+ * level cache misses and branch mispredictions. */
+#define PERF_COUNTERS 3
+
+// =======
+// ENGINES
+// =======
+
+/**
+ * The operations of a table implementation, so every engine runs
+ * through the same benchmark loop.
+ */
+struct engine {
+    const char* name;
+    void* (*create)(size_t size);
+    void (*add)(void* table, char* key, int value);
+    int (*find)(void* table, char* key); // The key exists.
+    int (*check)(void* table, char* key); // The key may be missing.
+    void (*change)(void* table, char* key, int value);
+    void (*remove)(void* table, char* key);
+    void (*destroy)(void* table);
+};
+
+void* _ht_create(size_t size) { return HT_create(size); }
+void _ht_add(void* t, char* key, int value) { HT_add(t, key, value); }
+int _ht_find(void* t, char* key) { return HT_find(t, key); }
+int _ht_check(void* t, char* key) { return HT_check(t, key); }
+void _ht_change(void* t, char* key, int value) { HT_change(t, key, value); }
+void _ht_remove(void* t, char* key) { HT_remove(t, key); }
+void _ht_destroy(void* t) { HT_destroy(t); }
+
+void* _rh_create(size_t size) { return RH_create(size); }
+void _rh_add(void* t, char* key, int value) { RH_add(t, key, value); }
+int _rh_find(void* t, char* key) { return RH_find(t, key); }
+int _rh_check(void* t, char* key) { return RH_check(t, key); }
+void _rh_change(void* t, char* key, int value) { RH_change(t, key, value); }
+void _rh_remove(void* t, char* key) { RH_remove(t, key); }
+void _rh_destroy(void* t) { RH_destroy(t); }
+
+void* _ck_create(size_t size) { return CK_create(size); }
+void _ck_add(void* t, char* key, int value) { CK_add(t, key, value); }
+int _ck_find(void* t, char* key) { return CK_find(t, key); }
+int _ck_check(void* t, char* key) { return CK_check(t, key); }
+void _ck_change(void* t, char* key, int value) { CK_change(t, key, value); }
+void _ck_remove(void* t, char* key) { CK_remove(t, key); }
+void _ck_destroy(void* t) { CK_destroy(t); }
+
+void* _st_create(size_t size) { return ST_create(size); }
+void _st_add(void* t, char* key, int value) { ST_add(t, key, value); }
+int _st_find(void* t, char* key) { return ST_find(t, key); }
+int _st_check(void* t, char* key) { return ST_check(t, key); }
+void _st_change(void* t, char* key, int value) { ST_change(t, key, value); }
+void _st_remove(void* t, char* key) { ST_remove(t, key); }
+void _st_destroy(void* t) { ST_destroy(t); }
+
+void* _ct_create(size_t size) { return CT_create(size, 16); }
+void _ct_add(void* t, char* key, int value) { CT_add(t, key, value); }
+int _ct_find(void* t, char* key) { return CT_find(t, key); }
+int _ct_check(void* t, char* key) { return CT_check(t, key); }
+void _ct_change(void* t, char* key, int value) { CT_change(t, key, value); }
+void _ct_remove(void* t, char* key) { CT_remove(t, key); }
+void _ct_destroy(void* t) { CT_destroy(t); }
+
+void* _sh_create(size_t size) { return HT_sharded_create(size, 16); }
+void _sh_add(void* t, char* key, int value) { HT_sharded_add(t, key, value); }
+int _sh_find(void* t, char* key) { return HT_sharded_find(t, key); }
+int _sh_check(void* t, char* key) { return HT_sharded_check(t, key); }
+void _sh_change(void* t, char* key, int value) { HT_sharded_change(t, key, value); }
+void _sh_remove(void* t, char* key) { HT_sharded_remove(t, key); }
+void _sh_destroy(void* t) { HT_sharded_destroy(t, 1); }
+
+struct engine engines[] = {
+    {"ht", _ht_create, _ht_add, _ht_find, _ht_check, _ht_change, _ht_remove, _ht_destroy},
+    {"rh", _rh_create, _rh_add, _rh_find, _rh_check, _rh_change, _rh_remove, _rh_destroy},
+    {"ck", _ck_create, _ck_add, _ck_find, _ck_check, _ck_change, _ck_remove, _ck_destroy},
+    {"st", _st_create, _st_add, _st_find, _st_check, _st_change, _st_remove, _st_destroy},
+    {"ct", _ct_create, _ct_add, _ct_find, _ct_check, _ct_change, _ct_remove, _ct_destroy},
+    {"sh", _sh_create, _sh_add, _sh_find, _sh_check, _sh_change, _sh_remove, _sh_destroy},
+};
+
+// ================
+// HELPER FUNCTIONS
+// ================
+
+/**
+ * @brief A small xorshift random number generator, so the benchmark is
+ * reproducible and cheap to drive.
+ *
+ * @param state - The state of the generator. Must not be 0.
+ * @return uint64_t - The next random number.
+ */
+uint64_t _next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Read the monotonic clock.
+ *
+ * @return uint64_t - The current time in nanoseconds.
+ */
+uint64_t _now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The characters of generated keys. Key indices are written in base 62.
+static const char charset[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+/**
+ * @brief Count the base-62 digits needed to write every index below `count`.
+ */
+int _index_digits(uint64_t count) {
+    int digits = 1;
+    for (uint64_t reach = 62; reach < count && digits < 11; reach *= 62)
+        digits++;
+    return digits;
+}
+
+/**
+ * @brief Determine whether keys of the provided length can be made
+ * distinct for `count` indices: sequential keys are the index alone, and
+ * random keys also need a character marking their key set.
+ */
+int _keys_fit(int len, uint64_t count, int sequential) {
+    return len >= _index_digits(count) + !sequential;
+}
+
+/**
+ * @brief Generate the keys of a benchmark. Sequential keys are the key's
+ * index in base 62, padded with zeros, so neighbouring keys only differ in
+ * their last bytes; other keys are random characters ending with their
+ * index. Either way every key is distinct, as long as `_keys_fit`.
+ *
+ * @param amount - The amount of keys to generate.
+ * @param len - The length of each key.
+ * @param sequential - Whether to generate counters.
+ * @param offset - The first index, so that two key sets never overlap.
+ * @param rng - The random number generator.
+ * @return char** - The generated keys.
+ */
+char** _make_keys(size_t amount, int len, int sequential, size_t offset, uint64_t* rng) {
+    int digits = sequential ? len : _index_digits(offset + amount);
+    char** keys = malloc(sizeof(char*) * amount);
+    for (size_t i = 0; i < amount; i++) {
+        keys[i] = malloc(len + 1);
+        if (!sequential) {
+            for (int c = 0; c < len - digits; c++)
+                keys[i][c] = charset[_next_random(rng) % (sizeof(charset) - 1)];
+            // Mark the key set so random key sets never overlap either.
+            keys[i][0] = offset ? '-' : '+';
+        }
+        uint64_t index = offset + i;
+        for (int c = len - 1; c >= len - digits; c--, index /= 62)
+            keys[i][c] = charset[index % 62];
+        keys[i][len] = '\0';
+    }
+    return keys;
+}
+
+/**
+ * @brief Free keys generated by `_make_keys`.
+ */
+void _free_keys(char** keys, size_t amount) {
+    for (size_t i = 0; i < amount; i++)
+        free(keys[i]);
+    free(keys);
+}
+
+/**
+ * @brief Generate the order in which keys are accessed. Uniform picks
+ * any key with the same probability, sequential walks the keys in order,
+ * and Zipfian makes a few scattered keys very hot (YCSB's scrambled
+ * Zipfian generator).
+ *
+ * @param dist - "uniform", "zipf" or "seq".
+ * @param amount - The amount of accesses to generate.
+ * @param n - The amount of keys.
+ * @param rng - The random number generator.
+ * @return size_t* - The index of the key of each access.
+ */
+size_t* _make_order(const char* dist, size_t amount, size_t n, uint64_t* rng) {
+    size_t* order = malloc(sizeof(size_t) * amount);
+    if (!strcmp(dist, "seq")) {
+        for (size_t i = 0; i < amount; i++)
+            order[i] = i % n;
+    } else if (!strcmp(dist, "zipf")) {
+        double zetan = 0, zeta2 = 1 + pow(0.5, ZIPF_THETA);
+        for (size_t i = 1; i <= n; i++)
+            zetan += 1 / pow((double) i, ZIPF_THETA);
+        double alpha = 1 / (1 - ZIPF_THETA);
+        double eta = (1 - pow(2.0 / n, 1 - ZIPF_THETA)) / (1 - zeta2 / zetan);
+        for (size_t i = 0; i < amount; i++) {
+            double u = (double) (_next_random(rng) >> 11) / (double) (1ull << 53);
+            double uz = u * zetan;
+            uint64_t rank;
+            if (uz < 1) rank = 0;
+            else if (uz < zeta2) rank = 1;
+            else rank = (uint64_t) (n * pow(eta * u - eta + 1, alpha));
+            // Scramble the ranks so the hot keys are not neighbours.
+            order[i] = HT_hash_bytes(&rank, sizeof(rank), 0) % n;
+        }
+    } else {
+        for (size_t i = 0; i < amount; i++)
+            order[i] = _next_random(rng) % n;
+    }
+    return order;
+}
+
+// ====================
+// PERFORMANCE COUNTERS
+// ====================
+
+// The descriptor of each hardware counter, or -1 if it is not open.
+int perf_fds[PERF_COUNTERS] = {-1, -1, -1};
+
+/**
+ * @brief Open the hardware counters of the calling thread, counting user
+ * space only. Counters the kernel or the processor do not offer, e.g.
+ * inside most virtual machines, stay closed and read as -1.
+ *
+ * @return int - The amount of counters opened.
+ */
+int _perf_open(void) {
+    int opened = 0;
+#ifdef __linux__
+    static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTERS] = {
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perf_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        opened += perf_fds[i] >= 0;
+    }
+#endif
+    return opened;
+}
+
+/**
+ * @brief Zero and start the open hardware counters.
+ */
+void _perf_start(void) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (perf_fds[i] < 0) continue;
+        ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+ * @brief Stop and read the hardware counters.
+ *
+ * @param out - Set to the count of each counter, or -1 if it is not open.
+ */
+void _perf_stop(int64_t* out) {
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        out[i] = -1;
+#ifdef __linux__
+        uint64_t count;
+        if (perf_fds[i] < 0) continue;
+        ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fds[i], &count, sizeof(count)) == sizeof(count))
+            out[i] = (int64_t) count;
+#endif
+    }
+}
+
+/**
+ * @brief Close the hardware counters.
+ */
+void _perf_close(void) {
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+#ifdef __linux__
+        if (perf_fds[i] >= 0) close(perf_fds[i]);
+#endif
+        perf_fds[i] = -1;
+    }
+}
+
+int _compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * The results of timing one kind of operation.
+ */
+struct measure {
+    uint64_t start;
+    uint64_t* samples;
+    size_t num_samples;
+};
+
+/**
+ * The output options of a run.
+ */
+struct output {
+    int json; // Print JSON lines instead of CSV.
+    int perf; // Add the hardware counters and profiled cycles per operation.
+    FILE* folded; // Where to write folded stacks of the profiled cycles, or NULL.
+};
+
+// The profiled region of `HT_Ht` behind each benchmarked operation.
+const struct { const char* op; int region; const char* function; } op_regions[] = {
+    {"insert", HT_PROF_ADD, "HT_add_bytes"},
+    {"lookup_hit", HT_PROF_FIND, "HT_find_bytes"},
+    {"lookup_miss", HT_PROF_CHECK, "HT_check_bytes"},
+    {"update", HT_PROF_CHANGE, "HT_change"},
+    {"remove", HT_PROF_REMOVE, "HT_remove_bytes"},
+};
+
+/**
+ * @brief Start timing one kind of operation.
+ *
+ * @param m - The measure to reset.
+ * @param out - The output options. The hardware counters and the profiled
+ * regions are only reset when they are reported.
+ */
+void _begin(struct measure* m, struct output* out) {
+    m->num_samples = 0;
+    if (out->perf || out->folded) HT_profile_reset();
+    if (out->perf) _perf_start();
+    m->start = _now_ns();
+}
+
+/**
+ * @brief Write the profiled cycles of one measurement as folded stacks,
+ * `engine;operation;function;part cycles`, splitting the operation's time
+ * into hashing, allocation and the rest. Engines that are not built on
+ * `HT_Ht` write nothing.
+ */
+void _fold(FILE* file, const char* engine, const char* op, HT_Profile* profile, int region, const char* function) {
+    uint64_t total = profile[region].cycles;
+    uint64_t hash = profile[HT_PROF_HASH].cycles, alloc = profile[HT_PROF_ALLOC].cycles;
+    if (!total) return;
+    // Hashing and allocation are nested inside the operation's own region.
+    uint64_t rest = total > hash + alloc ? total - hash - alloc : 0;
+    if (hash) fprintf(file, "%s;%s;%s;hash %llu\n", engine, op, function, (unsigned long long) hash);
+    if (alloc) fprintf(file, "%s;%s;%s;alloc %llu\n", engine, op, function, (unsigned long long) alloc);
+    if (rest) fprintf(file, "%s;%s;%s %llu\n", engine, op, function, (unsigned long long) rest);
+}
+
+/**
+ * @brief Time a single operation whenever it is one of the sampled ones.
+ */
+#define TIMED(m, i, op) do { \
+        if ((i) % LATENCY_SAMPLE == 0) { \
+            uint64_t t0 = _now_ns(); \
+            op; \
+            (m)->samples[(m)->num_samples++] = _now_ns() - t0; \
+        } else { \
+            op; \
+        } \
+    } while (0)
+
+/**
+ * @brief Print one measurement.
+ *
+ * @param out - The output options.
+ * @param m - The measure, whose samples get sorted.
+ * @param ops - The amount of operations that were run.
+ */
+void _report(struct output* out, const char* engine, const char* dist, int key_len, size_t size,
+             const char* op, struct measure* m, size_t ops) {
+    int64_t counts[PERF_COUNTERS];
+    HT_Profile profile[HT_PROF_REGIONS];
+    double seconds = (_now_ns() - m->start) / 1e9;
+    if (out->perf) _perf_stop(counts);
+    int region = -1;
+    const char* function = NULL;
+    for (size_t i = 0; i < sizeof(op_regions) / sizeof(op_regions[0]); i++) {
+        if (!strcmp(op_regions[i].op, op)) {
+            region = op_regions[i].region;
+            function = op_regions[i].function;
+        }
+    }
+    // Only engines that ran the operation's profiled region report
+    // cycles: the others, and engines reaching `HT_Ht` past that region,
+    // would otherwise report 0.
+    int profiled = HT_profile(profile) && region >= 0 && profile[region].calls > 0;
+    if (out->folded && profiled)
+        _fold(out->folded, engine, op, profile, region, function);
+    int json = out->json;
+    qsort(m->samples, m->num_samples, sizeof(uint64_t), _compare_u64);
+    uint64_t p50 = m->num_samples ? m->samples[m->num_samples * 50 / 100] : 0;
+    uint64_t p99 = m->num_samples ? m->samples[m->num_samples * 99 / 100] : 0;
+    uint64_t p999 = m->num_samples ? m->samples[m->num_samples * 999 / 1000] : 0;
+    if (json) {
+        printf("{\"engine\":\"%s\",\"dist\":\"%s\",\"key_len\":%d,\"size\":%zu,\"op\":\"%s\","
+               "\"ops\":%zu,\"seconds\":%.6f,\"mops\":%.3f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu",
+               engine, dist, key_len, size, op, ops, seconds, ops / seconds / 1e6,
+               (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) p999);
+    } else {
+        printf("%s,%s,%d,%zu,%s,%zu,%.6f,%.3f,%llu,%llu,%llu", engine, dist, key_len, size, op,
+               ops, seconds, ops / seconds / 1e6,
+               (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) p999);
+    }
+    if (out->perf) {
+        // Per operation, or -1 where the counter or the profile is missing.
+        double per_op[PERF_COUNTERS + 3];
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            per_op[i] = counts[i] < 0 ? -1 : (double) counts[i] / ops;
+        per_op[PERF_COUNTERS] = profiled ? (double) profile[region].cycles / ops : -1;
+        per_op[PERF_COUNTERS + 1] = profiled ? (double) profile[HT_PROF_HASH].cycles / ops : -1;
+        per_op[PERF_COUNTERS + 2] = profiled ? (double) profile[HT_PROF_ALLOC].cycles / ops : -1;
+        if (json)
+            printf(",\"l1d_misses\":%.3f,\"llc_misses\":%.3f,\"branch_misses\":%.3f,"
+                   "\"cycles\":%.1f,\"hash_cycles\":%.1f,\"alloc_cycles\":%.1f}",
+                   per_op[0], per_op[1], per_op[2], per_op[3], per_op[4], per_op[5]);
+        else
+            printf(",%.3f,%.3f,%.3f,%.1f,%.1f,%.1f", per_op[0], per_op[1], per_op[2], per_op[3], per_op[4], per_op[5]);
+    } else if (json) {
+        printf("}");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Run every operation once for the provided configuration.
+ *
+ * @param e - The engine to benchmark.
+ * @param dist - The key distribution.
+ * @param key_len - The length of every key.
+ * @param size - The amount of keys to insert.
+ * @param max_ops - The maximum amount of lookups and updates.
+ * @param out - The output options.
+ */
+void _run(struct engine* e, const char* dist, int key_len, size_t size, size_t max_ops, struct output* out) {
+    uint64_t rng = 0x9E3779B97F4A7C15ull ^ size ^ ((uint64_t) key_len << 40);
+    int sequential = !strcmp(dist, "seq");
+    size_t ops = size < max_ops ? size : max_ops;
+    if (!_keys_fit(key_len, (uint64_t) size + ops, sequential)) {
+        fprintf(stderr, "keys of %d bytes cannot tell %zu keys apart, skipping\n", key_len, size + ops);
+        return;
+    }
+    char** keys = _make_keys(size, key_len, sequential, 0, &rng);
+    char** missing = _make_keys(ops, key_len, sequential, size, &rng);
+    size_t* order = _make_order(dist, ops, size, &rng);
+    struct measure m;
+    m.samples = malloc(sizeof(uint64_t) * (size / LATENCY_SAMPLE + 1));
+    void* table = e->create(16);
+    int sink = 0;
+
+    _begin(&m, out);
+    for (size_t i = 0; i < size; i++)
+        TIMED(&m, i, e->add(table, keys[i], (int) i));
+    _report(out, e->name, dist, key_len, size, "insert", &m, size);
+
+    _begin(&m, out);
+    for (size_t i = 0; i < ops; i++)
+        TIMED(&m, i, sink += e->find(table, keys[order[i]]));
+    _report(out, e->name, dist, key_len, size, "lookup_hit", &m, ops);
+
+    _begin(&m, out);
+    for (size_t i = 0; i < ops; i++)
+        TIMED(&m, i, sink += e->check(table, missing[i]));
+    _report(out, e->name, dist, key_len, size, "lookup_miss", &m, ops);
+
+    _begin(&m, out);
+    for (size_t i = 0; i < ops; i++)
+        TIMED(&m, i, e->change(table, keys[order[i]], (int) i));
+    _report(out, e->name, dist, key_len, size, "update", &m, ops);
+
+    _begin(&m, out);
+    for (size_t i = 0; i < size; i++)
+        TIMED(&m, i, e->remove(table, keys[i]));
+    _report(out, e->name, dist, key_len, size, "remove", &m, size);
+
+    if (sink == 42) fprintf(stderr, " "); // Keeps the lookups from being optimized away.
+    e->destroy(table);
+    free(m.samples);
+    free(order);
+    _free_keys(keys, size);
+    _free_keys(missing, ops);
+}
+
+/**
+ * @brief Split a comma-separated option into its items. The option's
+ * string is modified.
+ *
+ * @return int - The amount of items.
+ */
+int _split(char* list, char** items) {
+    int count = 0;
+    for (char* item = strtok(list, ","); item && count < MAX_LIST; item = strtok(NULL, ","))
+        items[count++] = item;
+    return count;
+}
+
+void _usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [--engines ht,rh,ck,st,ct,sh] [--sizes 1000,100000,...] [--key-lens 16,48]\n"
+            "          [--dists uniform,zipf,seq] [--max-ops N] [--json] [--perf] [--folded FILE]\n"
+            "Sizes up to 100000000 keys are supported, given enough memory.\n", name);
+}
+
+int main(int argc, char** argv) {
+    char engine_list[256] = "ht,rh,ck,st,ct,sh";
+    char size_list[256] = "1000,100000,1000000";
+    char len_list[256] = "16,48";
+    char dist_list[256] = "uniform,zipf,seq";
+    size_t max_ops = 2000000;
+    struct output out = {0, 0, NULL};
+    for (int i = 1; i < argc; i++) {
+        char* target = NULL;
+        if (!strcmp(argv[i], "--json")) { out.json = 1; continue; }
+        if (!strcmp(argv[i], "--perf")) { out.perf = 1; continue; }
+        if (i + 1 >= argc) { _usage(argv[0]); return 1; }
+        if (!strcmp(argv[i], "--folded")) {
+            if (!(out.folded = fopen(argv[++i], "w"))) { perror(argv[i]); return 1; }
+            continue;
+        }
+        if (!strcmp(argv[i], "--engines")) target = engine_list;
+        else if (!strcmp(argv[i], "--sizes")) target = size_list;
+        else if (!strcmp(argv[i], "--key-lens")) target = len_list;
+        else if (!strcmp(argv[i], "--dists")) target = dist_list;
+        else if (!strcmp(argv[i], "--max-ops")) { max_ops = strtoull(argv[++i], NULL, 10); continue; }
+        else { _usage(argv[0]); return 1; }
+        snprintf(target, 256, "%s", argv[++i]);
+    }
+    char *names[MAX_LIST], *sizes[MAX_LIST], *lens[MAX_LIST], *dists[MAX_LIST];
+    int num_names = _split(engine_list, names), num_sizes = _split(size_list, sizes);
+    int num_lens = _split(len_list, lens), num_dists = _split(dist_list, dists);
+    if (out.perf && !_perf_open())
+        fprintf(stderr, "no hardware counters available, their columns are -1\n");
+    if ((out.perf || out.folded) && !HT_profile(NULL))
+        fprintf(stderr, "not compiled with -DHT_PROFILE, cycle columns are -1\n");
+    if (!out.json)
+        printf("engine,dist,key_len,size,op,ops,seconds,mops,p50_ns,p99_ns,p999_ns%s\n",
+               out.perf ? ",l1d_misses,llc_misses,branch_misses,cycles,hash_cycles,alloc_cycles" : "");
+    for (int n = 0; n < num_names; n++) {
+        struct engine* e = NULL;
+        for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+            if (!strcmp(engines[i].name, names[n]))
+                e = &engines[i];
+        }
+        if (!e) { fprintf(stderr, "unknown engine: %s\n", names[n]); return 1; }
+        for (int d = 0; d < num_dists; d++)
+            for (int l = 0; l < num_lens; l++)
+                for (int s = 0; s < num_sizes; s++)
+                    _run(e, dists[d], atoi(lens[l]), strtoull(sizes[s], NULL, 10), max_ops, &out);
+    }
+    _perf_close();
+    if (out.folded) fclose(out.folded);
+    return 0;
+}
@@ -0,0 +1,309 @@
+/**
+ * @file concurrent_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A thread-safe implementation of hash tables in C. Keys are
+ * spread over stripes by the top bits of their hash, and each stripe has
+ * its own lock, buckets and resize schedule, so writers only contend
+ * within a stripe. Readers never take a lock: chains are only changed in
+ * ways a concurrent reader can follow, a stripe is resized by publishing
+ * a copy of its buckets, and unlinked memory is reclaimed through
+ * epoch-based reclamation once no reader can still reach it.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "concurrent_table.h"
+#include "ebr.h"
+
+/**
+ * @brief Allocate an array of empty buckets.
+ *
+ * @param capacity - The amount of buckets. Must be a power of two.
+ * @return CT_Buckets* - The created buckets.
+ */
+CT_Buckets* _CT_new_buckets(size_t capacity) {
+    CT_Buckets* buckets = malloc(sizeof(CT_Buckets) + sizeof(CT_Node*) * capacity);
+    buckets->capacity = capacity;
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&buckets->heads[i], NULL);
+    return buckets;
+}
+
+/**
+ * @brief Free an array of buckets along with every node it links to.
+ * Used to reclaim the buckets replaced by a resize.
+ *
+ * @param ptr - The buckets to free.
+ */
+void _CT_free_buckets(void* ptr) {
+    CT_Buckets* buckets = ptr;
+    for (size_t i = 0; i < buckets->capacity; i++) {
+        CT_Node* node = atomic_load_explicit(&buckets->heads[i], memory_order_relaxed);
+        while (node) {
+            CT_Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            free(node);
+            node = next;
+        }
+    }
+    free(buckets);
+}
+
+/**
+ * @brief Initializer function for the concurrent hash table.
+ *
+ * @param size - The expected amount of keys, spread over the stripes.
+ * Each stripe grows on its own as keys are added.
+ * @param stripes - The amount of stripes, rounded up to a power of two.
+ * More stripes mean less contention between writers.
+ * @return CT_Ht* - The created table.
+ */
+CT_Ht* CT_create(size_t size, unsigned int stripes) {
+    CT_Ht* c_table = malloc(sizeof(CT_Ht));
+    c_table->stripe_bits = 0;
+    while ((1u << c_table->stripe_bits) < stripes)
+        c_table->stripe_bits++;
+    c_table->seed = 0;
+    size_t count = (size_t) 1 << c_table->stripe_bits;
+    size_t capacity = 1;
+    while (capacity * count < size)
+        capacity *= 2;
+    c_table->stripes = aligned_alloc(_Alignof(CT_Stripe), sizeof(CT_Stripe) * count);
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_init(&c_table->stripes[i].lock, NULL);
+        atomic_init(&c_table->stripes[i].buckets, _CT_new_buckets(capacity));
+        c_table->stripes[i].size = 0;
+    }
+    return c_table;
+}
+
+/**
+ * @brief Find the stripe owning a hash from its top bits. Buckets
+ * within the stripe are picked from the low bits.
+ *
+ * @param c_table - The table to search.
+ * @param hash - The full hash of a key.
+ * @return CT_Stripe* - The stripe owning the key.
+ */
+CT_Stripe* _CT_stripe(CT_Ht* c_table, uint64_t hash) {
+    if (!c_table->stripe_bits) return c_table->stripes;
+    return &(c_table->stripes[hash >> (64 - c_table->stripe_bits)]);
+}
+
+/**
+ * @brief Search the buckets of a stripe for the provided key. Safe to
+ * call without the stripe's lock from inside a read-side section.
+ *
+ * @param buckets - The buckets to search.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return CT_Node* - The node holding the key, or NULL if not found.
+ */
+CT_Node* _CT_lookup(CT_Buckets* buckets, char* key, uint64_t hash, size_t len) {
+    CT_Node* node = atomic_load_explicit(&buckets->heads[hash & (buckets->capacity - 1)], memory_order_acquire);
+    while (node) {
+        if (node->hash == hash && node->key_len == len && !memcmp(node->key, key, len))
+            return node;
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Double the buckets of a stripe. The nodes are copied into a new
+ * array of buckets which is then published in one store, so concurrent
+ * readers either see the old chains or the new ones but never a chain
+ * being relinked. Must be called with the stripe's lock held.
+ *
+ * @param stripe - The stripe to grow.
+ */
+void _CT_grow(CT_Stripe* stripe) {
+    CT_Buckets* old_buckets = atomic_load_explicit(&stripe->buckets, memory_order_relaxed);
+    CT_Buckets* buckets = _CT_new_buckets(old_buckets->capacity * 2);
+    size_t mask = buckets->capacity - 1;
+    for (size_t i = 0; i < old_buckets->capacity; i++) {
+        CT_Node* node = atomic_load_explicit(&old_buckets->heads[i], memory_order_relaxed);
+        for (; node; node = atomic_load_explicit(&node->next, memory_order_relaxed)) {
+            CT_Node* copy = malloc(sizeof(CT_Node) + node->key_len + 1);
+            memcpy(copy->key, node->key, node->key_len + 1);
+            copy->hash = node->hash;
+            copy->key_len = node->key_len;
+            atomic_init(&copy->value, atomic_load_explicit(&node->value, memory_order_relaxed));
+            atomic_init(&copy->next, atomic_load_explicit(&buckets->heads[node->hash & mask], memory_order_relaxed));
+            atomic_init(&buckets->heads[node->hash & mask], copy);
+        }
+    }
+    atomic_store_explicit(&stripe->buckets, buckets, memory_order_release);
+    HT_ebr_retire(old_buckets, _CT_free_buckets);
+}
+
+/**
+ * @brief Add a key-value pair to the table. Adding a key that already
+ * exists replaces its value. Grows the key's stripe once it holds more
+ * keys than buckets.
+ *
+ * @param c_table - The table to add to.
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void CT_add(CT_Ht* c_table, char* key, int value) {
+    size_t len = strlen(key);
+    uint64_t hash = HT_hash_bytes(key, len, c_table->seed);
+    CT_Stripe* stripe = _CT_stripe(c_table, hash);
+    pthread_mutex_lock(&stripe->lock);
+    CT_Buckets* buckets = atomic_load_explicit(&stripe->buckets, memory_order_relaxed);
+    CT_Node* node = _CT_lookup(buckets, key, hash, len);
+    if (node) {
+        atomic_store_explicit(&node->value, value, memory_order_release);
+    } else {
+        node = malloc(sizeof(CT_Node) + len + 1);
+        memcpy(node->key, key, len + 1);
+        node->hash = hash;
+        node->key_len = len;
+        atomic_init(&node->value, value);
+        _Atomic(CT_Node*)* head = &buckets->heads[hash & (buckets->capacity - 1)];
+        atomic_init(&node->next, atomic_load_explicit(head, memory_order_relaxed));
+        // Publishing the fully built node at the head of its chain is the
+        // only store a reader can observe.
+        atomic_store_explicit(head, node, memory_order_release);
+        if (++stripe->size > buckets->capacity)
+            _CT_grow(stripe);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/**
+ * @brief Find the value of the provided key without taking any lock.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int CT_get(CT_Ht* c_table, char* key, int* out) {
+    size_t len = strlen(key);
+    uint64_t hash = HT_hash_bytes(key, len, c_table->seed);
+    CT_Stripe* stripe = _CT_stripe(c_table, hash);
+    HT_ebr_enter();
+    CT_Buckets* buckets = atomic_load_explicit(&stripe->buckets, memory_order_acquire);
+    CT_Node* node = _CT_lookup(buckets, key, hash, len);
+    if (node && out)
+        *out = atomic_load_explicit(&node->value, memory_order_acquire);
+    HT_ebr_exit();
+    return node != NULL;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists within the
+ * table without taking any lock.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int CT_check(CT_Ht* c_table, char* key) {
+    return CT_get(c_table, key, NULL);
+}
+
+/**
+ * @brief Find the value of the provided key without taking any lock.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the provided key, or 0 if it is missing.
+ */
+int CT_find(CT_Ht* c_table, char* key) {
+    int value = 0;
+    CT_get(c_table, key, &value);
+    return value;
+}
+
+/**
+ * @brief Change the value of an existing key. Does nothing if the key
+ * is missing.
+ *
+ * @param c_table - The table to change.
+ * @param key - The key of the value to change.
+ * @param value - The new value.
+ */
+void CT_change(CT_Ht* c_table, char* key, int value) {
+    size_t len = strlen(key);
+    uint64_t hash = HT_hash_bytes(key, len, c_table->seed);
+    CT_Stripe* stripe = _CT_stripe(c_table, hash);
+    pthread_mutex_lock(&stripe->lock);
+    CT_Node* node = _CT_lookup(atomic_load_explicit(&stripe->buckets, memory_order_relaxed), key, hash, len);
+    if (node)
+        atomic_store_explicit(&node->value, value, memory_order_release);
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/**
+ * @brief Remove a key-value pair from the table. The node is unlinked
+ * in one store and keeps pointing to the rest of its chain, so a reader
+ * standing on it can carry on; it is freed once no reader can reach it.
+ *
+ * @param c_table - The table to remove from.
+ * @param key - The key of the key-value pair to be removed.
+ * @return int - 1 if the key was removed, 0 if it did not exist.
+ */
+int CT_remove(CT_Ht* c_table, char* key) {
+    size_t len = strlen(key);
+    uint64_t hash = HT_hash_bytes(key, len, c_table->seed);
+    CT_Stripe* stripe = _CT_stripe(c_table, hash);
+    pthread_mutex_lock(&stripe->lock);
+    CT_Buckets* buckets = atomic_load_explicit(&stripe->buckets, memory_order_relaxed);
+    _Atomic(CT_Node*)* link = &buckets->heads[hash & (buckets->capacity - 1)];
+    CT_Node* node;
+    while ((node = atomic_load_explicit(link, memory_order_relaxed))) {
+        if (node->hash == hash && node->key_len == len && !memcmp(node->key, key, len))
+            break;
+        link = &node->next;
+    }
+    if (node) {
+        atomic_store_explicit(link, atomic_load_explicit(&node->next, memory_order_relaxed), memory_order_release);
+        stripe->size--;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+    if (node)
+        HT_ebr_retire(node, free);
+    return node != NULL;
+}
+
+/**
+ * @brief Count the keys within the table. Each stripe is counted under
+ * its own lock, so the total is only exact while no writer is running.
+ *
+ * @param c_table - The table to count.
+ * @return size_t - The amount of keys.
+ */
+size_t CT_size(CT_Ht* c_table) {
+    size_t size = 0;
+    for (size_t i = 0; i < ((size_t) 1 << c_table->stripe_bits); i++) {
+        pthread_mutex_lock(&c_table->stripes[i].lock);
+        size += c_table->stripes[i].size;
+        pthread_mutex_unlock(&c_table->stripes[i].lock);
+    }
+    return size;
+}
+
+/**
+ * @brief Destroy the provided table. No other thread may use the table
+ * anymore. Waits until memory retired by the table's writers is freed.
+ *
+ * @param c_table - The table to destroy.
+ */
+void CT_destroy(CT_Ht* c_table) {
+    for (size_t i = 0; i < ((size_t) 1 << c_table->stripe_bits); i++) {
+        _CT_free_buckets(atomic_load(&c_table->stripes[i].buckets));
+        pthread_mutex_destroy(&c_table->stripes[i].lock);
+    }
+    free(c_table->stripes);
+    free(c_table);
+    HT_ebr_barrier();
+}
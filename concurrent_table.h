@@ -0,0 +1,61 @@
+/**
+ * @file concurrent_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for a thread-safe hash table with striped
+ * writer locks and lock-free readers.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+struct CT_node {
+    _Atomic(struct CT_node *) next;
+    uint64_t hash;
+    size_t key_len;
+    _Atomic int value;
+    char key[]; // Stored inline, after the node.
+};
+
+struct CT_buckets {
+    size_t capacity; // Always a power of two.
+    _Atomic(struct CT_node *) heads[];
+};
+
+/**
+ * A stripe owns the keys whose hash starts with its index. Writers take
+ * the stripe's lock, readers only load `buckets`. Stripes are aligned to
+ * a cache line so that locking one never slows down its neighbours.
+ */
+struct CT_stripe {
+    _Alignas(64) pthread_mutex_t lock;
+    _Atomic(struct CT_buckets *) buckets;
+    size_t size; // Guarded by `lock`.
+};
+
+struct CT_ht {
+    unsigned int stripe_bits; // There are 2^stripe_bits stripes.
+    uint64_t seed;
+    struct CT_stripe * stripes;
+};
+
+typedef struct CT_node CT_Node;
+typedef struct CT_buckets CT_Buckets;
+typedef struct CT_stripe CT_Stripe;
+typedef struct CT_ht CT_Ht;
+
+CT_Ht* CT_create(size_t size, unsigned int stripes);
+void CT_add(CT_Ht* c_table, char* key, int value);
+int CT_check(CT_Ht* c_table, char* key);
+int CT_find(CT_Ht* c_table, char* key);
+int CT_get(CT_Ht* c_table, char* key, int* out);
+void CT_change(CT_Ht* c_table, char* key, int value);
+int CT_remove(CT_Ht* c_table, char* key);
+size_t CT_size(CT_Ht* c_table);
+void CT_destroy(CT_Ht* c_table);
@@ -0,0 +1,394 @@
+/**
+ * @file cuckoo_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A bucketized cuckoo implementation of hash tables in C. Each key
+ * may only live in one of two buckets picked by its hash, so a lookup
+ * reads at most two buckets, one cache line each, whatever the load.
+ * Inserts that find both buckets full search breadth-first for the
+ * shortest chain of entries to move to their other bucket, and the rare
+ * key with no such chain waits in a small stash until the table grows.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "cuckoo_table.h"
+
+// The table grows once more than CK_MAX_LOAD / 100 of its slots are used.
+#define CK_MAX_LOAD 90
+// The most buckets visited by the search for an eviction path.
+#define CK_SEARCH 256
+
+/**
+ * A bucket reached by the search for an eviction path: the entry in slot
+ * `slot` of the parent's bucket can move to `bucket`.
+ */
+struct CK_step {
+    unsigned int bucket;
+    int parent; // Index of the previous step, or -1 for one of the key's buckets.
+    int slot;
+};
+
+typedef struct CK_step CK_Step;
+
+/**
+ * @brief Scramble a hash to derive the second bucket from it. This is
+ * the finalizer of MurmurHash3, a bijection on 32 bits.
+ */
+uint32_t _CK_mix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * @brief Find the first bucket of a hash.
+ */
+unsigned int _CK_first(CK_Ht* c_table, uint32_t hash) {
+    return hash & (c_table->capacity - 1);
+}
+
+/**
+ * @brief Find the second bucket of a hash. It differs from the first one
+ * as long as the table has more than one bucket.
+ */
+unsigned int _CK_second(CK_Ht* c_table, uint32_t hash) {
+    unsigned int mask = c_table->capacity - 1;
+    unsigned int bucket = _CK_mix(hash) & mask;
+    return bucket == (hash & mask) ? (bucket ^ 1) & mask : bucket;
+}
+
+/**
+ * @brief Find the bucket an entry would move to from the provided bucket.
+ */
+unsigned int _CK_other(CK_Ht* c_table, uint32_t hash, unsigned int bucket) {
+    unsigned int first = _CK_first(c_table, hash);
+    return bucket == first ? _CK_second(c_table, hash) : first;
+}
+
+/**
+ * @brief Allocate an array of empty buckets, each aligned on a cache line.
+ *
+ * @param capacity - The amount of buckets to allocate.
+ * @return CK_Bucket* - The array of buckets.
+ */
+CK_Bucket* _CK_new_buckets(unsigned int capacity) {
+    CK_Bucket* buckets = aligned_alloc(_Alignof(CK_Bucket), sizeof(CK_Bucket) * capacity);
+    for (unsigned int i = 0; i < capacity; i++) {
+        for (int s = 0; s < CK_SLOTS; s++)
+            buckets[i].slots[s].key = NULL;
+    }
+    return buckets;
+}
+
+/**
+ * @brief Initializer function for the cuckoo hash table.
+ *
+ * @param size - The amount of keys to make room for. The table grows on
+ * its own as keys are added.
+ * @return CK_Ht* - The created table.
+ */
+CK_Ht* CK_create(unsigned int size) {
+    unsigned int capacity = 1;
+    while ((uint64_t) capacity * CK_SLOTS < size)
+        capacity *= 2;
+    CK_Ht* c_table = malloc(sizeof(CK_Ht));
+    c_table->capacity = capacity;
+    c_table->size = 0;
+    c_table->buckets = _CK_new_buckets(capacity);
+    c_table->stash_size = 0;
+    return c_table;
+}
+
+/**
+ * @brief Find a free slot within a bucket.
+ *
+ * @param bucket - The bucket to search.
+ * @return int - The index of the first free slot, or -1 if it is full.
+ */
+int _CK_free_slot(CK_Bucket* bucket) {
+    for (int s = 0; s < CK_SLOTS; s++) {
+        if (!bucket->slots[s].key)
+            return s;
+    }
+    return -1;
+}
+
+/**
+ * @brief Determine whether a bucket is already on the path of a step.
+ * Moving an entry through the same bucket twice would overwrite it.
+ */
+int _CK_on_path(CK_Step* steps, int index, unsigned int bucket) {
+    for (; index >= 0; index = steps[index].parent) {
+        if (steps[index].bucket == bucket)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Free a slot in one of the buckets of a hash by moving entries to
+ * their other bucket. The search is breadth-first, so the fewest entries
+ * are moved, and every entry moves before the slot it leaves is reused.
+ *
+ * @param c_table - The table to insert into.
+ * @param hash - The hash of the key to make room for.
+ * @param slot - Set to the freed slot.
+ * @return CK_Bucket* - The bucket of the freed slot, or NULL if no path
+ * was found within `CK_SEARCH` buckets.
+ */
+CK_Bucket* _CK_evict(CK_Ht* c_table, uint32_t hash, int* slot) {
+    CK_Step steps[CK_SEARCH];
+    int count = 0;
+    steps[count++] = (CK_Step) {_CK_first(c_table, hash), -1, 0};
+    steps[count++] = (CK_Step) {_CK_second(c_table, hash), -1, 0};
+    for (int i = 0; i < count; i++) {
+        CK_Bucket* bucket = &(c_table->buckets[steps[i].bucket]);
+        int free_slot = _CK_free_slot(bucket);
+        if (free_slot >= 0) {
+            // Move each entry of the path into the slot freed after it.
+            for (int step = i; steps[step].parent >= 0; step = steps[step].parent) {
+                CK_Bucket* from = &(c_table->buckets[steps[steps[step].parent].bucket]);
+                c_table->buckets[steps[step].bucket].slots[free_slot] = from->slots[steps[step].slot];
+                free_slot = steps[step].slot;
+            }
+            int root = i;
+            while (steps[root].parent >= 0)
+                root = steps[root].parent;
+            c_table->buckets[steps[root].bucket].slots[free_slot].key = NULL;
+            *slot = free_slot;
+            return &(c_table->buckets[steps[root].bucket]);
+        }
+        for (int s = 0; s < CK_SLOTS && count < CK_SEARCH; s++) {
+            unsigned int other = _CK_other(c_table, bucket->slots[s].hash, steps[i].bucket);
+            if (!_CK_on_path(steps, i, other))
+                steps[count++] = (CK_Step) {other, i, s};
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Place an entry in one of its buckets, moving other entries if
+ * needed, or in the stash. The key must not already be present.
+ *
+ * @param c_table - The table to insert into.
+ * @param entry - The entry to place. Its key is owned by the table.
+ * @return int - 1 if the entry was placed, 0 if the table must grow.
+ */
+int _CK_place(CK_Ht* c_table, CK_Slot entry) {
+    int slot;
+    CK_Bucket* bucket = _CK_evict(c_table, entry.hash, &slot);
+    if (bucket) {
+        bucket->slots[slot] = entry;
+        return 1;
+    }
+    if (c_table->stash_size < CK_STASH) {
+        c_table->stash[c_table->stash_size++] = entry;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Double the capacity of the table and place every entry again,
+ * stashed ones included. Capacities keep doubling until every entry did
+ * fit. Stored hashes are reused so no key is hashed again.
+ *
+ * @param c_table - The table to grow.
+ */
+void _CK_grow(CK_Ht* c_table) {
+    CK_Bucket* old_buckets = c_table->buckets;
+    unsigned int old_capacity = c_table->capacity;
+    CK_Slot stash[CK_STASH];
+    unsigned int stash_size = c_table->stash_size;
+    memcpy(stash, c_table->stash, sizeof(CK_Slot) * stash_size);
+    for (unsigned int capacity = old_capacity * 2;; capacity *= 2) {
+        c_table->capacity = capacity;
+        c_table->buckets = _CK_new_buckets(capacity);
+        c_table->stash_size = 0;
+        int placed = 1;
+        for (unsigned int i = 0; placed && i < old_capacity; i++) {
+            for (int s = 0; placed && s < CK_SLOTS; s++) {
+                if (old_buckets[i].slots[s].key)
+                    placed = _CK_place(c_table, old_buckets[i].slots[s]);
+            }
+        }
+        for (unsigned int i = 0; placed && i < stash_size; i++)
+            placed = _CK_place(c_table, stash[i]);
+        if (placed) break;
+        free(c_table->buckets);
+    }
+    free(old_buckets);
+}
+
+/**
+ * @brief Find the slot holding the provided key. Only the key's two
+ * buckets are read, and the stash if it holds any entry.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @param hash - The low half of the key's hash.
+ * @param bucket - Set to the bucket of the key's slot, or to `capacity`
+ * if the key is stashed. May be NULL.
+ * @return CK_Slot* - The key's slot, or NULL if not found.
+ */
+CK_Slot* _CK_lookup(CK_Ht* c_table, char* key, uint32_t hash, unsigned int* bucket) {
+    unsigned int buckets[2] = { _CK_first(c_table, hash), _CK_second(c_table, hash) };
+    for (int b = 0; b < 2; b++) {
+        for (int s = 0; s < CK_SLOTS; s++) {
+            CK_Slot* slot = &(c_table->buckets[buckets[b]].slots[s]);
+            if (slot->key && slot->hash == hash && !strcmp(slot->key, key)) {
+                if (bucket) *bucket = buckets[b];
+                return slot;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < c_table->stash_size; i++) {
+        CK_Slot* slot = &(c_table->stash[i]);
+        if (slot->hash == hash && !strcmp(slot->key, key)) {
+            if (bucket) *bucket = c_table->capacity;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add a key-value pair to the table. Like `RH_add`, adding a key
+ * that already exists replaces its value.
+ *
+ * @param c_table - The table to add to.
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void CK_add(CK_Ht* c_table, char* key, int value) {
+    uint32_t hash = HT_hash_key(key);
+    CK_Slot* found = _CK_lookup(c_table, key, hash, NULL);
+    if (found) {
+        found->value = value;
+        return;
+    }
+    if (((uint64_t) c_table->size + 1) * 100 > (uint64_t) c_table->capacity * CK_SLOTS * CK_MAX_LOAD)
+        _CK_grow(c_table);
+    CK_Slot entry;
+    entry.hash = hash;
+    entry.value = value;
+    entry.key = malloc(sizeof(char) * (strlen(key) + 1));
+    strcpy(entry.key, key);
+    while (!_CK_place(c_table, entry))
+        _CK_grow(c_table);
+    c_table->size++;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists
+ * within the table.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int CK_check(CK_Ht* c_table, char* key) {
+    return _CK_lookup(c_table, key, HT_hash_key(key), NULL) != NULL;
+}
+
+/**
+ * @brief Find the value of the provided key. NOTE: Assumes the key
+ * exists within the table. Use `CK_check` if unsure.
+ *
+ * @param c_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the provided key, or 0 if it is missing.
+ */
+int CK_find(CK_Ht* c_table, char* key) {
+    CK_Slot* slot = _CK_lookup(c_table, key, HT_hash_key(key), NULL);
+    return slot ? slot->value : 0;
+}
+
+/**
+ * @brief Change the value of an existing key. Does nothing if the key
+ * is missing.
+ *
+ * @param c_table - The table to change.
+ * @param key - The key of the value to change.
+ * @param value - The new value.
+ */
+void CK_change(CK_Ht* c_table, char* key, int value) {
+    CK_Slot* slot = _CK_lookup(c_table, key, HT_hash_key(key), NULL);
+    if (slot)
+        slot->value = value;
+}
+
+/**
+ * @brief Remove a key-value pair from the table. The freed slot is
+ * offered to the stashed entries that may live in its bucket, so the
+ * stash empties as keys come and go. Does nothing if the key is missing.
+ *
+ * @param c_table - The table to remove from.
+ * @param key - The key of the key-value pair to be removed.
+ */
+void CK_remove(CK_Ht* c_table, char* key) {
+    uint32_t hash = HT_hash_key(key);
+    unsigned int bucket;
+    CK_Slot* slot = _CK_lookup(c_table, key, hash, &bucket);
+    if (!slot) return;
+    free(slot->key);
+    c_table->size--;
+    if (bucket == c_table->capacity) {
+        *slot = c_table->stash[--c_table->stash_size];
+        return;
+    }
+    slot->key = NULL;
+    for (unsigned int i = 0; i < c_table->stash_size; i++) {
+        uint32_t stashed = c_table->stash[i].hash;
+        if (_CK_first(c_table, stashed) == bucket || _CK_second(c_table, stashed) == bucket) {
+            *slot = c_table->stash[i];
+            c_table->stash[i] = c_table->stash[--c_table->stash_size];
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Print the occupied slots of the table to STDOUT in a
+ * human-readable manner.
+ *
+ * @param c_table - The table to be printed out.
+ */
+void CK_print(CK_Ht* c_table) {
+    for (unsigned int i = 0; i < c_table->capacity; i++) {
+        for (int s = 0; s < CK_SLOTS; s++) {
+            CK_Slot* slot = &(c_table->buckets[i].slots[s]);
+            if (slot->key)
+                printf("=====BUCKET %u (%d)=====\n{\"%s\": %d}\n", i, s, slot->key, slot->value);
+        }
+    }
+    for (unsigned int i = 0; i < c_table->stash_size; i++)
+        printf("=====STASH %u=====\n{\"%s\": %d}\n", i, c_table->stash[i].key, c_table->stash[i].value);
+}
+
+/**
+ * @brief Destroy the provided table and every key it owns.
+ *
+ * @param c_table - The table to destroy.
+ */
+void CK_destroy(CK_Ht* c_table) {
+    for (unsigned int i = 0; i < c_table->capacity; i++) {
+        for (int s = 0; s < CK_SLOTS; s++)
+            free(c_table->buckets[i].slots[s].key);
+    }
+    for (unsigned int i = 0; i < c_table->stash_size; i++)
+        free(c_table->stash[i].key);
+    free(c_table->buckets);
+    free(c_table);
+}
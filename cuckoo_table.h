@@ -0,0 +1,51 @@
+/**
+ * @file cuckoo_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for a bucketized cuckoo hash table, where
+ * every key lives in one of two buckets of a single cache line each.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdint.h>
+
+// Slots per bucket. Four 16-byte slots fill one 64-byte cache line.
+#define CK_SLOTS 4
+// Entries kept aside when no eviction path frees a slot for them.
+#define CK_STASH 4
+
+struct CK_slot {
+    uint32_t hash; // Low half of the key's hash. Gives both of its buckets.
+    int value;
+    char* key; // NULL if the slot is empty.
+};
+
+struct CK_bucket {
+    _Alignas(64) struct CK_slot slots[CK_SLOTS];
+};
+
+struct CK_ht {
+    unsigned int capacity; // The amount of buckets, always a power of two.
+    unsigned int size;
+    struct CK_bucket * buckets;
+    // Only searched while not empty, so lookups of a table with an empty
+    // stash read nothing but the key's two buckets.
+    unsigned int stash_size;
+    struct CK_slot stash[CK_STASH];
+};
+
+typedef struct CK_slot CK_Slot;
+typedef struct CK_bucket CK_Bucket;
+typedef struct CK_ht CK_Ht;
+
+CK_Ht* CK_create(unsigned int size);
+void CK_add(CK_Ht* c_table, char* key, int value);
+int CK_check(CK_Ht* c_table, char* key);
+int CK_find(CK_Ht* c_table, char* key);
+void CK_change(CK_Ht* c_table, char* key, int value);
+void CK_remove(CK_Ht* c_table, char* key);
+void CK_print(CK_Ht* c_table);
+void CK_destroy(CK_Ht* c_table);
@@ -0,0 +1,207 @@
+/**
+ * @file ebr.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Epoch-based memory reclamation. Readers announce the global
+ * epoch they started in; memory unlinked by writers is retired with the
+ * current epoch and only freed once the global epoch has moved two steps
+ * past it, which cannot happen while a reader that might still see the
+ * memory is active.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ebr.h"
+
+// Retiring this many objects triggers an attempt to free old ones.
+#define HT_EBR_COLLECT_EVERY 64
+
+struct HT_ebr_record {
+    struct HT_ebr_record * next;
+    // The epoch the thread entered shifted left by one, with the low
+    // bit set while the thread is inside a read-side section.
+    _Atomic uint64_t state;
+    _Atomic int in_use; // Whether a live thread owns the record.
+};
+
+struct HT_ebr_retired {
+    struct HT_ebr_retired * next;
+    void* ptr;
+    void (*free_fn)(void*);
+    uint64_t epoch;
+};
+
+typedef struct HT_ebr_record HT_Ebr_record;
+typedef struct HT_ebr_retired HT_Ebr_retired;
+
+static _Atomic uint64_t ebr_epoch = 1;
+static _Atomic(HT_Ebr_record*) ebr_records = NULL;
+static pthread_mutex_t ebr_lock = PTHREAD_MUTEX_INITIALIZER;
+static HT_Ebr_retired* ebr_retired = NULL; // Guarded by `ebr_lock`.
+static size_t ebr_pending = 0; // Guarded by `ebr_lock`.
+static pthread_key_t ebr_key;
+static pthread_once_t ebr_once = PTHREAD_ONCE_INIT;
+static _Thread_local HT_Ebr_record* ebr_self = NULL;
+static _Thread_local unsigned int ebr_depth = 0;
+
+/**
+ * @brief Give a thread's record back when the thread exits, so that
+ * another thread can claim it.
+ *
+ * @param record - The record of the exiting thread.
+ */
+void _HT_ebr_release(void* record) {
+    atomic_store(&((HT_Ebr_record*) record)->state, 0);
+    atomic_store(&((HT_Ebr_record*) record)->in_use, 0);
+}
+
+/**
+ * @brief Create the key used to release records of exiting threads.
+ */
+void _HT_ebr_init(void) {
+    pthread_key_create(&ebr_key, _HT_ebr_release);
+}
+
+/**
+ * @brief Find the calling thread's record, claiming a released one or
+ * registering a new one on first use. Records are never freed.
+ *
+ * @return HT_Ebr_record* - The record of the calling thread.
+ */
+HT_Ebr_record* _HT_ebr_self(void) {
+    if (ebr_self) return ebr_self;
+    pthread_once(&ebr_once, _HT_ebr_init);
+    for (HT_Ebr_record* record = atomic_load(&ebr_records); record; record = record->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&record->in_use, &expected, 1)) {
+            ebr_self = record;
+            break;
+        }
+    }
+    if (!ebr_self) {
+        HT_Ebr_record* record = malloc(sizeof(HT_Ebr_record));
+        atomic_init(&record->state, 0);
+        atomic_init(&record->in_use, 1);
+        record->next = atomic_load(&ebr_records);
+        while (!atomic_compare_exchange_weak(&ebr_records, &record->next, record));
+        ebr_self = record;
+    }
+    pthread_setspecific(ebr_key, ebr_self);
+    return ebr_self;
+}
+
+/**
+ * @brief Enter a read-side section. Memory reachable from shared
+ * structures stays valid until the matching `HT_ebr_exit`. Sections
+ * may be nested.
+ */
+void HT_ebr_enter(void) {
+    HT_Ebr_record* self = _HT_ebr_self();
+    if (ebr_depth++) return;
+    atomic_store(&self->state, (atomic_load(&ebr_epoch) << 1) | 1);
+    // The announcement must be visible before any shared pointer is read.
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * @brief Leave a read-side section entered with `HT_ebr_enter`.
+ */
+void HT_ebr_exit(void) {
+    if (--ebr_depth) return;
+    atomic_store_explicit(&ebr_self->state, 0, memory_order_release);
+}
+
+/**
+ * @brief Move the global epoch forward if every active reader has
+ * already observed it.
+ *
+ * @return uint64_t - The global epoch after the attempt.
+ */
+uint64_t _HT_ebr_advance(void) {
+    uint64_t epoch = atomic_load(&ebr_epoch);
+    for (HT_Ebr_record* record = atomic_load(&ebr_records); record; record = record->next) {
+        uint64_t state = atomic_load(&record->state);
+        if ((state & 1) && (state >> 1) != epoch)
+            return epoch;
+    }
+    atomic_compare_exchange_strong(&ebr_epoch, &epoch, epoch + 1);
+    return atomic_load(&ebr_epoch);
+}
+
+/**
+ * @brief Free every retired object that no reader can still reach.
+ * Must be called with `ebr_lock` held.
+ *
+ * @param epoch - The current global epoch.
+ */
+void _HT_ebr_free_old(uint64_t epoch) {
+    HT_Ebr_retired** link = &ebr_retired;
+    while (*link) {
+        HT_Ebr_retired* retired = *link;
+        if (retired->epoch + 2 <= epoch) {
+            *link = retired->next;
+            retired->free_fn(retired->ptr);
+            free(retired);
+            ebr_pending--;
+        } else {
+            link = &(retired->next);
+        }
+    }
+}
+
+/**
+ * @brief Try to advance the global epoch and free the retired objects
+ * that have become unreachable.
+ */
+void HT_ebr_collect(void) {
+    pthread_mutex_lock(&ebr_lock);
+    _HT_ebr_free_old(_HT_ebr_advance());
+    pthread_mutex_unlock(&ebr_lock);
+}
+
+/**
+ * @brief Schedule memory that has been unlinked from every shared
+ * structure to be freed once no reader can still reach it.
+ *
+ * @param ptr - The memory to free.
+ * @param free_fn - The function that frees it.
+ */
+void HT_ebr_retire(void* ptr, void (*free_fn)(void*)) {
+    HT_Ebr_retired* retired = malloc(sizeof(HT_Ebr_retired));
+    retired->ptr = ptr;
+    retired->free_fn = free_fn;
+    pthread_mutex_lock(&ebr_lock);
+    retired->epoch = atomic_load(&ebr_epoch);
+    retired->next = ebr_retired;
+    ebr_retired = retired;
+    if (++ebr_pending % HT_EBR_COLLECT_EVERY == 0)
+        _HT_ebr_free_old(_HT_ebr_advance());
+    pthread_mutex_unlock(&ebr_lock);
+}
+
+/**
+ * @brief Wait until every object retired before the call has been
+ * freed. Must not be called from inside a read-side section.
+ */
+void HT_ebr_barrier(void) {
+    uint64_t target = atomic_load(&ebr_epoch);
+    for (;;) {
+        pthread_mutex_lock(&ebr_lock);
+        _HT_ebr_free_old(_HT_ebr_advance());
+        int done = 1;
+        for (HT_Ebr_retired* retired = ebr_retired; retired; retired = retired->next) {
+            if (retired->epoch <= target)
+                done = 0;
+        }
+        pthread_mutex_unlock(&ebr_lock);
+        if (done) return;
+        sched_yield();
+    }
+}
@@ -0,0 +1,22 @@
+/**
+ * @file ebr.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for epoch-based memory reclamation, which
+ * lets readers traverse shared structures without taking locks.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef EBR_H
+#define EBR_H
+
+void HT_ebr_enter(void);
+void HT_ebr_exit(void);
+void HT_ebr_retire(void* ptr, void (*free_fn)(void*));
+void HT_ebr_collect(void);
+void HT_ebr_barrier(void);
+
+#endif
@@ -0,0 +1,499 @@
+/**
+ * @file frozen_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Immutable tables around a minimal perfect hash function, built
+ * in the style of PTHash. Keys are split into small buckets, and each
+ * bucket gets a 16-bit pilot picked so that its keys land on positions no
+ * other key uses. A lookup then reads one pilot and one entry: there are
+ * no probes, no empty slots, and the pilots cost about 3 bits per key.
+ * The table is a single pointer-free blob, so it can be saved and served
+ * from a mapped file like a snapshot.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hash_table.h"
+#include "frozen_table.h"
+
+// The average amount of keys per bucket. Each bucket costs a 16-bit pilot.
+#define FT_BUCKET_LOAD 5
+// Positions are spread over one extra slot per FT_SPARE_RATIO keys, so the
+// last buckets still find free positions quickly. Keys landing past the
+// end are moved into the holes this leaves.
+#define FT_SPARE_RATIO 50
+// The amount of seeds tried before giving up on building a table.
+#define FT_ATTEMPTS 16
+
+/**
+ * A key being frozen, along with its position in the walk of the table
+ * so that duplicate keys resolve to the newest one.
+ */
+struct FT_key {
+    uint64_t hash;
+    HT_Node* node;
+    uint64_t order;
+};
+
+typedef struct FT_key FT_Key;
+
+/**
+ * @brief Mix the bits of a word. See splitmix64.
+ */
+uint64_t _FT_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Map the high bits of a hash onto `[0, n)` without a division.
+ *
+ * @param hash - The hash to map.
+ * @param n - The size of the range, at most 2^32.
+ * @return uint64_t - The value within the range.
+ */
+uint64_t _FT_range(uint64_t hash, uint64_t n) {
+    return ((hash >> 32) * n) >> 32;
+}
+
+/**
+ * @brief Find the position of a key given the pilot of its bucket.
+ *
+ * @param hash - The hash of the key.
+ * @param pilot - The pilot of the key's bucket.
+ * @param slots - The amount of positions.
+ * @return uint64_t - The position of the key.
+ */
+uint64_t _FT_position(uint64_t hash, uint16_t pilot, uint64_t slots) {
+    return _FT_range(_FT_mix(hash ^ ((pilot + 1ull) * 0x9E3779B97F4A7C15ull)), slots);
+}
+
+/**
+ * @brief Order keys by hash, then by their position in the walk.
+ */
+int _FT_compare_keys(const void* a, const void* b) {
+    const FT_Key* x = a;
+    const FT_Key* y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/**
+ * @brief Hash every key with the provided seed and drop the duplicates
+ * left by `HT_add`, keeping the newest one.
+ *
+ * @param keys - The keys, with their nodes and order set.
+ * @param n - The amount of keys.
+ * @param seed - The seed of `HT_hash_bytes`.
+ * @param distinct - Set to the amount of keys left.
+ * @return int - 1 on success, 0 if two different keys share a hash.
+ */
+int _FT_prepare_keys(FT_Key* keys, size_t n, uint64_t seed, size_t* distinct) {
+    for (size_t i = 0; i < n; i++)
+        keys[i].hash = HT_hash_bytes(keys[i].node->key, keys[i].node->key_len, seed);
+    qsort(keys, n, sizeof(FT_Key), _FT_compare_keys);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (count && keys[count - 1].hash == keys[i].hash) {
+            HT_Node* a = keys[count - 1].node;
+            HT_Node* b = keys[i].node;
+            if (a->key_len == b->key_len && !memcmp(a->key, b->key, a->key_len))
+                continue; // An older copy of the same key.
+            return 0;
+        }
+        keys[count++] = keys[i];
+    }
+    *distinct = count;
+    return 1;
+}
+
+/**
+ * @brief Pick a pilot for every bucket, largest buckets first, so that
+ * no two keys share a position.
+ *
+ * @param keys - The distinct keys.
+ * @param n - The amount of keys.
+ * @param buckets - The amount of buckets.
+ * @param slots - The amount of positions.
+ * @param pilots - Set to the pilot of each bucket.
+ * @param positions - Set to the position of each key.
+ * @return int - 1 on success, 0 if some bucket has no working pilot.
+ */
+int _FT_search_pilots(FT_Key* keys, size_t n, uint64_t buckets, uint64_t slots,
+                      uint16_t* pilots, uint64_t* positions) {
+    // Group the keys by bucket.
+    uint64_t* starts = calloc(buckets + 1, sizeof(uint64_t));
+    uint64_t* members = malloc(sizeof(uint64_t) * n);
+    for (size_t i = 0; i < n; i++)
+        starts[_FT_range(keys[i].hash, buckets) + 1]++;
+    uint64_t largest = 0;
+    for (uint64_t b = 0; b < buckets; b++) {
+        if (starts[b + 1] > largest) largest = starts[b + 1];
+        starts[b + 1] += starts[b];
+    }
+    uint64_t* cursors = malloc(sizeof(uint64_t) * buckets);
+    memcpy(cursors, starts, sizeof(uint64_t) * buckets);
+    for (size_t i = 0; i < n; i++)
+        members[cursors[_FT_range(keys[i].hash, buckets)]++] = i;
+    // Order the buckets by decreasing size.
+    uint64_t* by_size = calloc(largest + 2, sizeof(uint64_t));
+    uint64_t* order = malloc(sizeof(uint64_t) * buckets);
+    for (uint64_t b = 0; b < buckets; b++)
+        by_size[largest - (starts[b + 1] - starts[b]) + 1]++;
+    for (uint64_t s = 0; s <= largest; s++)
+        by_size[s + 1] += by_size[s];
+    for (uint64_t b = 0; b < buckets; b++)
+        order[by_size[largest - (starts[b + 1] - starts[b])]++] = b;
+
+    uint64_t* taken = calloc((slots + 63) / 64, sizeof(uint64_t));
+    uint64_t* candidate = malloc(sizeof(uint64_t) * (largest ? largest : 1));
+    int found = 1;
+    for (uint64_t o = 0; o < buckets && found; o++) {
+        uint64_t b = order[o];
+        uint64_t first = starts[b], count = starts[b + 1] - starts[b];
+        pilots[b] = 0;
+        if (!count) continue;
+        found = 0;
+        for (uint32_t pilot = 0; pilot <= UINT16_MAX && !found; pilot++) {
+            found = 1;
+            for (uint64_t j = 0; j < count && found; j++) {
+                uint64_t pos = _FT_position(keys[members[first + j]].hash, pilot, slots);
+                if (taken[pos >> 6] & (1ull << (pos & 63)))
+                    found = 0;
+                for (uint64_t k = 0; k < j && found; k++)
+                    found = candidate[k] != pos;
+                candidate[j] = pos;
+            }
+            if (found) {
+                pilots[b] = pilot;
+                for (uint64_t j = 0; j < count; j++) {
+                    taken[candidate[j] >> 6] |= 1ull << (candidate[j] & 63);
+                    positions[members[first + j]] = candidate[j];
+                }
+            }
+        }
+    }
+    free(starts);
+    free(members);
+    free(cursors);
+    free(by_size);
+    free(order);
+    free(taken);
+    free(candidate);
+    return found;
+}
+
+/**
+ * @brief Point the fields of a frozen table at the sections of its blob,
+ * after checking that the header and every section fit within the blob.
+ *
+ * @param f_table - The table to set up.
+ * @param base - The blob.
+ * @param length - The length of the blob.
+ * @return int - 1 if the blob is a valid frozen table, 0 otherwise.
+ */
+int _FT_attach(FT_Ht* f_table, void* base, size_t length) {
+    const FT_Header* header = base;
+    if (length < sizeof(FT_Header)) return 0;
+    int valid = !memcmp(header->magic, FT_MAGIC, sizeof(header->magic))
+        && header->version == FT_VERSION
+        && header->byte_order == FT_BYTE_ORDER
+        && header->file_size == length
+        && header->size <= header->slots && header->slots <= ((uint64_t) 1 << 32)
+        && header->buckets <= ((uint64_t) 1 << 32) && (header->buckets || !header->size)
+        && !(header->pilots_offset % 8) && !(header->remap_offset % 8)
+        && !(header->entries_offset % 8) && !(header->keys_offset % 8)
+        // Offsets are bounded by the blob before sections are measured
+        // from them, and every section by the room left after its offset,
+        // so no crafted header can wrap the checks around.
+        && header->pilots_offset >= sizeof(FT_Header)
+        && header->pilots_offset <= length
+        && header->buckets <= (length - header->pilots_offset) / sizeof(uint16_t)
+        && header->remap_offset >= header->pilots_offset
+        && header->remap_offset <= length
+        && header->remap_offset - header->pilots_offset >= sizeof(uint16_t) * header->buckets
+        && header->slots - header->size <= (length - header->remap_offset) / sizeof(uint32_t)
+        && header->entries_offset >= header->remap_offset
+        && header->entries_offset <= length
+        && header->entries_offset - header->remap_offset >= sizeof(uint32_t) * (header->slots - header->size)
+        && header->size <= (length - header->entries_offset) / sizeof(FT_Entry)
+        && header->keys_offset >= header->entries_offset
+        && header->keys_offset <= length
+        && header->keys_offset - header->entries_offset >= sizeof(FT_Entry) * header->size;
+    if (!valid) return 0;
+    const unsigned char* bytes = base;
+    f_table->base = base;
+    f_table->length = length;
+    f_table->header = header;
+    f_table->pilots = (const uint16_t*) (bytes + header->pilots_offset);
+    f_table->remap = (const uint32_t*) (bytes + header->remap_offset);
+    f_table->entries = (const FT_Entry*) (bytes + header->entries_offset);
+    f_table->keys = bytes + header->keys_offset;
+    f_table->key_bytes = length - header->keys_offset;
+    return 1;
+}
+
+/**
+ * @brief Round an offset up to a multiple of 8.
+ */
+uint64_t _FT_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * @brief Lay out the blob of a frozen table once every key has a position.
+ * Entries are stored at their final position and key bytes in the same
+ * order, so neighbouring entries have neighbouring keys.
+ *
+ * @param keys - The distinct keys.
+ * @param n - The amount of keys.
+ * @param seed - The seed the keys were hashed with.
+ * @param buckets - The amount of buckets.
+ * @param slots - The amount of positions.
+ * @param pilots - The pilot of each bucket.
+ * @param positions - The position of each key.
+ * @return FT_Ht* - The frozen table.
+ */
+FT_Ht* _FT_layout(FT_Key* keys, size_t n, uint64_t seed, uint64_t buckets, uint64_t slots,
+                  uint16_t* pilots, uint64_t* positions) {
+    uint64_t spare = slots - n;
+    uint32_t* remap = calloc(spare ? spare : 1, sizeof(uint32_t));
+    uint64_t* slot_key = malloc(sizeof(uint64_t) * (n ? n : 1));
+    uint8_t* used = calloc(n ? n : 1, 1);
+    for (size_t i = 0; i < n; i++) {
+        if (positions[i] < n) used[positions[i]] = 1;
+    }
+    // Move the keys that landed past the end into the holes below it.
+    // There are exactly as many of one as of the other.
+    uint64_t hole = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (positions[i] < n) continue;
+        while (used[hole]) hole++;
+        used[hole] = 1;
+        remap[positions[i] - n] = hole;
+        positions[i] = hole;
+    }
+    uint64_t key_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        slot_key[positions[i]] = i;
+        key_bytes += keys[i].node->key_len;
+    }
+
+    FT_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FT_MAGIC, sizeof(header.magic));
+    header.version = FT_VERSION;
+    header.byte_order = FT_BYTE_ORDER;
+    header.seed = seed;
+    header.size = n;
+    header.buckets = buckets;
+    header.slots = slots;
+    header.pilots_offset = _FT_align(sizeof(FT_Header));
+    header.remap_offset = header.pilots_offset + _FT_align(sizeof(uint16_t) * buckets);
+    header.entries_offset = header.remap_offset + _FT_align(sizeof(uint32_t) * spare);
+    header.keys_offset = header.entries_offset + _FT_align(sizeof(FT_Entry) * n);
+    header.file_size = header.keys_offset + _FT_align(key_bytes);
+
+    unsigned char* blob = calloc(header.file_size, 1);
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + header.pilots_offset, pilots, sizeof(uint16_t) * buckets);
+    memcpy(blob + header.remap_offset, remap, sizeof(uint32_t) * spare);
+    FT_Entry* entries = (FT_Entry*) (blob + header.entries_offset);
+    uint64_t key_offset = 0;
+    for (uint64_t slot = 0; slot < n; slot++) {
+        HT_Node* node = keys[slot_key[slot]].node;
+        entries[slot].key_offset = key_offset;
+        entries[slot].key_len = node->key_len;
+        entries[slot].value = node->value;
+        memcpy(blob + header.keys_offset + key_offset, node->key, node->key_len);
+        key_offset += node->key_len;
+    }
+    free(remap);
+    free(slot_key);
+    free(used);
+
+    FT_Ht* f_table = malloc(sizeof(FT_Ht));
+    _FT_attach(f_table, blob, header.file_size);
+    f_table->mapped = 0;
+    return f_table;
+}
+
+/**
+ * @brief Build an immutable table holding every key of the provided hash
+ * table. Where `HT_add` stored a key more than once, the newest value is
+ * kept. The hash table is left untouched and can be destroyed afterwards.
+ *
+ * @param h_table - The hash table to freeze.
+ * @return FT_Ht* - The frozen table, or NULL if no perfect hash function
+ * was found, which only happens for tables beyond 2^32 keys or after
+ * `FT_ATTEMPTS` unlucky seeds in a row.
+ */
+FT_Ht* HT_freeze(HT_Ht* h_table) {
+    size_t n = h_table->size;
+    FT_Key* walk = malloc(sizeof(FT_Key) * (n ? n : 1));
+    FT_Key* keys = malloc(sizeof(FT_Key) * (n ? n : 1));
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    size_t count = 0;
+    for (HT_Node* node = HT_iter_next(&iter); node; node = HT_iter_next(&iter)) {
+        walk[count].node = node;
+        walk[count].order = count;
+        count++;
+    }
+    FT_Ht* f_table = NULL;
+    uint64_t slots = count + count / FT_SPARE_RATIO;
+    for (uint64_t attempt = 0; attempt < FT_ATTEMPTS && !f_table && slots <= ((uint64_t) 1 << 32); attempt++) {
+        uint64_t seed = _FT_mix(h_table->seed + attempt);
+        size_t distinct;
+        memcpy(keys, walk, sizeof(FT_Key) * count);
+        if (!_FT_prepare_keys(keys, count, seed, &distinct)) continue;
+        uint64_t buckets = (distinct + FT_BUCKET_LOAD - 1) / FT_BUCKET_LOAD;
+        slots = distinct + distinct / FT_SPARE_RATIO;
+        uint16_t* pilots = malloc(sizeof(uint16_t) * (buckets ? buckets : 1));
+        uint64_t* positions = malloc(sizeof(uint64_t) * (distinct ? distinct : 1));
+        if (_FT_search_pilots(keys, distinct, buckets, slots, pilots, positions))
+            f_table = _FT_layout(keys, distinct, seed, buckets, slots, pilots, positions);
+        free(pilots);
+        free(positions);
+    }
+    HT_iter_release(&iter);
+    free(walk);
+    free(keys);
+    return f_table;
+}
+
+/**
+ * @brief Find the value of the provided binary key with a single probe.
+ * Keys that were never frozen still land on some entry, so its key is
+ * compared before the value is trusted.
+ *
+ * @param f_table - The table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int FT_get_bytes(FT_Ht* f_table, const void* key, size_t len, int* out) {
+    const FT_Header* header = f_table->header;
+    if (!header->size) return 0;
+    uint64_t hash = HT_hash_bytes(key, len, header->seed);
+    uint64_t pos = _FT_position(hash, f_table->pilots[_FT_range(hash, header->buckets)], header->slots);
+    if (pos >= header->size) {
+        pos = f_table->remap[pos - header->size];
+        if (pos >= header->size) return 0; // Only possible in a corrupted file.
+    }
+    const FT_Entry* entry = &(f_table->entries[pos]);
+    if (entry->key_len != len || entry->key_offset > f_table->key_bytes
+        || len > f_table->key_bytes - entry->key_offset
+        || memcmp(f_table->keys + entry->key_offset, key, len))
+        return 0;
+    if (out) *out = entry->value;
+    return 1;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists within the
+ * frozen table.
+ *
+ * @param f_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int FT_check(FT_Ht* f_table, char* key) {
+    return FT_get_bytes(f_table, key, strlen(key), NULL);
+}
+
+/**
+ * @brief Find the value of the provided key within the frozen table.
+ *
+ * @param f_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the key, or 0 if it is missing.
+ */
+int FT_find(FT_Ht* f_table, char* key) {
+    int value = 0;
+    FT_get_bytes(f_table, key, strlen(key), &value);
+    return value;
+}
+
+/**
+ * @brief Save the frozen table to a file, to be served later by
+ * `FT_open_mmap`. The blob is written as is, next to `path`, and renamed
+ * over it so processes that mapped a previous file keep a complete one.
+ *
+ * @param f_table - The table to save.
+ * @param path - The path of the file.
+ * @return int - 1 if the table was saved, 0 otherwise.
+ */
+int FT_save(FT_Ht* f_table, const char* path) {
+    size_t path_len = strlen(path);
+    char* temp_path = malloc(path_len + 5);
+    memcpy(temp_path, path, path_len);
+    memcpy(temp_path + path_len, ".tmp", 5);
+    FILE* file = fopen(temp_path, "wb");
+    int saved = file != NULL;
+    if (file) {
+        saved = fwrite(f_table->base, 1, f_table->length, file) == f_table->length;
+        saved = (fclose(file) == 0) && saved;
+        saved = saved && rename(temp_path, path) == 0;
+        if (!saved)
+            remove(temp_path);
+    }
+    free(temp_path);
+    return saved;
+}
+
+/**
+ * @brief Map a frozen table saved by `FT_save` and serve it in place.
+ *
+ * @param path - The path of the file.
+ * @return FT_Ht* - The mapped table, or NULL if the file cannot be
+ * mapped or is not a valid frozen table.
+ */
+FT_Ht* FT_open_mmap(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FT_Header)) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = st.st_size;
+    void* base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file alive.
+    if (base == MAP_FAILED) return NULL;
+    FT_Ht* f_table = malloc(sizeof(FT_Ht));
+    if (!_FT_attach(f_table, base, length)) {
+        munmap(base, length);
+        free(f_table);
+        return NULL;
+    }
+    f_table->mapped = 1;
+    return f_table;
+}
+
+/**
+ * @brief Destroy the provided frozen table, unmapping its file if it was
+ * opened with `FT_open_mmap`.
+ *
+ * @param f_table - The table to destroy.
+ */
+void FT_destroy(FT_Ht* f_table) {
+    if (f_table->mapped)
+        munmap(f_table->base, f_table->length);
+    else
+        free(f_table->base);
+    free(f_table);
+}
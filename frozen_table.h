@@ -0,0 +1,75 @@
+/**
+ * @file frozen_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for immutable tables built from a populated
+ * hash table around a minimal perfect hash function, so every lookup
+ * takes exactly one probe.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FT_MAGIC "HTFROZE\0"
+#define FT_VERSION 1
+// Written in the byte order of the machine building the table, so a
+// saved table from a machine of the other byte order is rejected.
+#define FT_BYTE_ORDER 0x01020304u
+
+/**
+ * The start of a frozen table. The table is a single pointer-free blob
+ * whose sections are addressed by their offset from the header, so the
+ * same bytes are served from memory or from a mapped file.
+ */
+struct FT_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t seed; // Seed of `HT_hash_bytes` for every key.
+    uint64_t size; // Amount of keys, and of entries.
+    uint64_t buckets; // Amount of pilots.
+    uint64_t slots; // Positions the pilots map keys to, at least `size`.
+    // Offsets of the sections: one 16-bit pilot per bucket, the entries
+    // that positions past `size` are moved to, the entries, and the keys.
+    uint64_t pilots_offset;
+    uint64_t remap_offset;
+    uint64_t entries_offset;
+    uint64_t keys_offset;
+};
+
+struct FT_entry {
+    uint64_t key_offset; // From the start of the key bytes.
+    uint32_t key_len;
+    int32_t value;
+};
+
+struct FT_ht {
+    void* base; // The blob, either allocated or mapped.
+    size_t length;
+    int mapped; // Whether `base` is a mapped file.
+    const struct FT_header * header;
+    const uint16_t * pilots;
+    const uint32_t * remap;
+    const struct FT_entry * entries;
+    const unsigned char * keys;
+    size_t key_bytes; // Length of the key section, including padding.
+};
+
+struct HT_ht;
+
+typedef struct FT_header FT_Header;
+typedef struct FT_entry FT_Entry;
+typedef struct FT_ht FT_Ht;
+
+FT_Ht* HT_freeze(struct HT_ht * h_table);
+int FT_check(FT_Ht* f_table, char* key);
+int FT_find(FT_Ht* f_table, char* key);
+int FT_get_bytes(FT_Ht* f_table, const void* key, size_t len, int* out);
+int FT_save(FT_Ht* f_table, const char* path);
+FT_Ht* FT_open_mmap(const char* path);
+void FT_destroy(FT_Ht* f_table);
@@ -0,0 +1,194 @@
+/**
+ * @file generic_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Macro-generated hash tables whose key type, value type, hash
+ * and equality are compile-time parameters. Keys and values are stored
+ * inline in open-addressed slots, so integer-keyed tables never allocate
+ * per key and compare keys in a register.
+ *
+ * `GT_DECLARE(name, key_type, value_type)` declares the `name##_Ht` type
+ * and the prototypes of its functions, and can be used in a header.
+ * `GT_DEFINE(name, key_type, value_type, hash_fn, equal_fn)` defines the
+ * functions once in a single source file. `hash_fn(key)` must return a
+ * well-mixed `uint64_t`, as its top bits pick the slot; `equal_fn(a, b)`
+ * must return non-zero for equal keys. For example:
+ *
+ *     GT_DECLARE(U64, uint64_t, int)
+ *     GT_DEFINE(U64, uint64_t, int, GT_hash_int, GT_equal)
+ *
+ *     U64_Ht* table = U64_create(100);
+ *     U64_add(table, 42, 7);
+ *
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef GENERIC_TABLE_H
+#define GENERIC_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The table grows once more than GT_MAX_LOAD_NUM/GT_MAX_LOAD_DEN of its slots are used.
+#define GT_MAX_LOAD_NUM 3
+#define GT_MAX_LOAD_DEN 4
+
+// Fibonacci hashing: one multiplication spreads an integer key over the top bits.
+#define GT_hash_int(key) ((uint64_t) (key) * 0x9E3779B97F4A7C15ull)
+// Equality of keys comparable with `==`.
+#define GT_equal(a, b) ((a) == (b))
+
+/**
+ * Declare a table named `name` mapping `key_type` to `value_type`:
+ *
+ * - `name##_Ht* name##_create(size_t size)`: create a table sized for
+ *   `size` keys.
+ * - `void name##_add(name##_Ht*, key_type, value_type)`: set the value
+ *   of a key, adding the key if it does not exist yet.
+ * - `int name##_check(name##_Ht*, key_type)`: 1 if the key exists.
+ * - `int name##_get(name##_Ht*, key_type, value_type* out)`: 1 and the
+ *   value in `out` (which may be NULL) if the key exists, 0 otherwise.
+ * - `value_type* name##_get_ptr(name##_Ht*, key_type)`: the slot holding
+ *   the value of a key, or NULL. Only valid until the table is changed.
+ * - `int name##_remove(name##_Ht*, key_type)`: 1 if the key was removed.
+ * - `void name##_destroy(name##_Ht*)`: free the table.
+ */
+#define GT_DECLARE(name, key_type, value_type)                                  \
+    struct name##_slot {                                                        \
+        key_type key;                                                           \
+        value_type value;                                                       \
+    };                                                                          \
+    struct name##_ht {                                                          \
+        size_t capacity; /* A power of two. */                                  \
+        size_t size;                                                            \
+        unsigned int shift; /* 64 - log2(capacity). */                          \
+        uint8_t * used; /* One flag per slot. */                                \
+        struct name##_slot * slots;                                             \
+    };                                                                          \
+    typedef struct name##_slot name##_Slot;                                     \
+    typedef struct name##_ht name##_Ht;                                         \
+    name##_Ht* name##_create(size_t size);                                      \
+    void name##_add(name##_Ht* table, key_type key, value_type value);          \
+    int name##_check(name##_Ht* table, key_type key);                           \
+    int name##_get(name##_Ht* table, key_type key, value_type* out);            \
+    value_type* name##_get_ptr(name##_Ht* table, key_type key);                 \
+    int name##_remove(name##_Ht* table, key_type key);                          \
+    void name##_destroy(name##_Ht* table);
+
+/**
+ * Define the functions declared by `GT_DECLARE` with the same `name`.
+ * Slots are probed linearly from the top bits of the hash, and removals
+ * shift the following keys back so no tombstones are needed.
+ */
+#define GT_DEFINE(name, key_type, value_type, hash_fn, equal_fn)                \
+    void _##name##_alloc(name##_Ht* table, size_t capacity) {                   \
+        table->capacity = capacity;                                             \
+        table->shift = 64;                                                      \
+        while (capacity > 1) {                                                  \
+            table->shift--;                                                     \
+            capacity >>= 1;                                                     \
+        }                                                                       \
+        table->used = calloc(table->capacity, 1);                               \
+        table->slots = malloc(sizeof(name##_Slot) * table->capacity);           \
+    }                                                                           \
+                                                                                \
+    size_t _##name##_home(name##_Ht* table, key_type key) {                     \
+        /* A shift by 64 is undefined, so a single-slot table is avoided. */    \
+        return (size_t) ((uint64_t) (hash_fn(key)) >> table->shift);            \
+    }                                                                           \
+                                                                                \
+    name##_Ht* name##_create(size_t size) {                                     \
+        name##_Ht* table = malloc(sizeof(name##_Ht));                           \
+        size_t capacity = 8;                                                    \
+        while (capacity * GT_MAX_LOAD_NUM < size * GT_MAX_LOAD_DEN)             \
+            capacity *= 2;                                                      \
+        _##name##_alloc(table, capacity);                                       \
+        table->size = 0;                                                        \
+        return table;                                                           \
+    }                                                                           \
+                                                                                \
+    /* Find the slot of a key, or the empty slot ending its probe. */           \
+    size_t _##name##_probe(name##_Ht* table, key_type key) {                    \
+        size_t mask = table->capacity - 1;                                      \
+        size_t i = _##name##_home(table, key);                                  \
+        while (table->used[i] && !(equal_fn(table->slots[i].key, key)))         \
+            i = (i + 1) & mask;                                                 \
+        return i;                                                               \
+    }                                                                           \
+                                                                                \
+    void _##name##_grow(name##_Ht* table) {                                     \
+        size_t old_capacity = table->capacity;                                  \
+        uint8_t* old_used = table->used;                                        \
+        name##_Slot* old_slots = table->slots;                                  \
+        _##name##_alloc(table, old_capacity * 2);                               \
+        for (size_t j = 0; j < old_capacity; j++) {                             \
+            if (!old_used[j]) continue;                                         \
+            size_t i = _##name##_probe(table, old_slots[j].key);                \
+            table->used[i] = 1;                                                 \
+            table->slots[i] = old_slots[j];                                     \
+        }                                                                       \
+        free(old_used);                                                         \
+        free(old_slots);                                                        \
+    }                                                                           \
+                                                                                \
+    void name##_add(name##_Ht* table, key_type key, value_type value) {         \
+        size_t i = _##name##_probe(table, key);                                 \
+        if (!table->used[i]) {                                                  \
+            if ((table->size + 1) * GT_MAX_LOAD_DEN >                           \
+                table->capacity * GT_MAX_LOAD_NUM) {                            \
+                _##name##_grow(table);                                          \
+                i = _##name##_probe(table, key);                                \
+            }                                                                   \
+            table->used[i] = 1;                                                 \
+            table->slots[i].key = key;                                          \
+            table->size++;                                                      \
+        }                                                                       \
+        table->slots[i].value = value;                                          \
+    }                                                                           \
+                                                                                \
+    value_type* name##_get_ptr(name##_Ht* table, key_type key) {                \
+        size_t i = _##name##_probe(table, key);                                 \
+        return table->used[i] ? &(table->slots[i].value) : NULL;                \
+    }                                                                           \
+                                                                                \
+    int name##_get(name##_Ht* table, key_type key, value_type* out) {           \
+        value_type* value = name##_get_ptr(table, key);                         \
+        if (!value) return 0;                                                   \
+        if (out) *out = *value;                                                 \
+        return 1;                                                               \
+    }                                                                           \
+                                                                                \
+    int name##_check(name##_Ht* table, key_type key) {                          \
+        return name##_get_ptr(table, key) != NULL;                              \
+    }                                                                           \
+                                                                                \
+    int name##_remove(name##_Ht* table, key_type key) {                         \
+        size_t mask = table->capacity - 1;                                      \
+        size_t hole = _##name##_probe(table, key);                              \
+        if (!table->used[hole]) return 0;                                       \
+        /* Move back every following key whose home is not between the */     \
+        /* hole and the key, so no probe crosses the emptied slot. */          \
+        for (size_t i = (hole + 1) & mask; table->used[i]; i = (i + 1) & mask) { \
+            size_t home = _##name##_home(table, table->slots[i].key);           \
+            if (((i - home) & mask) >= ((i - hole) & mask)) {                   \
+                table->slots[hole] = table->slots[i];                           \
+                hole = i;                                                       \
+            }                                                                   \
+        }                                                                       \
+        table->used[hole] = 0;                                                  \
+        table->size--;                                                          \
+        return 1;                                                               \
+    }                                                                           \
+                                                                                \
+    void name##_destroy(name##_Ht* table) {                                     \
+        free(table->used);                                                      \
+        free(table->slots);                                                     \
+        free(table);                                                            \
+    }
+
+#endif
@@ -12,10 +12,245 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/mman.h>
 #include "hash_table.h"
+#include "arena.h"
+#include "ordered_index.h"
+#include "numa_placement.h"
 
-// Prime number for the hashing function. See `The C Programming Language Section Second Edition 6.6`.
+// Prime number for the legacy hashing function. See `The C Programming Language Section Second Edition 6.6`.
 #define HASHPRIME 31 
+// The table grows once it holds more keys than buckets (load factor of 1).
+#define HT_GROW_LOAD 1
+// A shrinkable table halves once less than 1/HT_SHRINK_RATIO of its buckets are used.
+#define HT_SHRINK_RATIO 8
+// The amount of old buckets migrated by every operation during a rehash.
+#define HT_REHASH_STEP 4
+// The amount of keys whose buckets are prefetched together by batched operations.
+#define HT_BATCH 16
+
+#ifdef HT_STATS_COUNTERS
+// Count operations for `HT_stats`. Relaxed atomics are enough since the
+// counters do not order anything.
+#define HT_COUNT(h_table, counter, amount) __atomic_fetch_add(&((h_table)->counter), (amount), __ATOMIC_RELAXED)
+#else
+#define HT_COUNT(h_table, counter, amount) ((void) 0)
+#endif
+// Count a lookup as a hit or a miss.
+#define HT_COUNT_LOOKUP(h_table, found) ((found) ? HT_COUNT(h_table, hits, 1) : HT_COUNT(h_table, misses, 1))
+
+#ifdef HT_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+// Calls and cycles of every profiled region, see `HT_profile`.
+HT_Profile _HT_profile_regions[HT_PROF_REGIONS];
+
+/**
+ * @brief Read the cheapest cycle counter of the processor: the time stamp
+ * counter on x86, the virtual counter on ARM, and the monotonic clock in
+ * nanoseconds elsewhere.
+ */
+static inline uint64_t _HT_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t cycles;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+    return cycles;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+// Time a region of `-DHT_PROFILE` builds, from `HT_PROF_BEGIN` to the
+// matching `HT_PROF_END` in the same scope.
+#define HT_PROF_BEGIN(region) uint64_t _prof_##region = _HT_cycles()
+#define HT_PROF_END(region) do { \
+        __atomic_fetch_add(&(_HT_profile_regions[region].calls), 1, __ATOMIC_RELAXED); \
+        __atomic_fetch_add(&(_HT_profile_regions[region].cycles), _HT_cycles() - _prof_##region, __ATOMIC_RELAXED); \
+    } while (0)
+#else
+#define HT_PROF_BEGIN(region) ((void) 0)
+#define HT_PROF_END(region) ((void) 0)
+#endif
+
+// Default secret of the word-at-a-time hash. See wyhash by Wang Yi.
+static const uint64_t HT_SECRET[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/**
+ * @brief Multiply two 64-bit words into a 128-bit product, returning
+ * the low half in `a` and the high half in `b`.
+ */
+static inline void _HT_mum(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), lo, hi;
+    uint64_t c = t < rl;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+/**
+ * @brief Fold the 128-bit product of two words back into 64 bits.
+ */
+static inline uint64_t _HT_mix(uint64_t a, uint64_t b) {
+    _HT_mum(&a, &b);
+    return a ^ b;
+}
+
+// Unaligned little-endian reads of 8, 4 and up to 3 bytes.
+static inline uint64_t _HT_read8(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint64_t _HT_read4(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64_t _HT_read3(const uint8_t* p, size_t k) {
+    return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
+}
+
+/**
+ * @brief The default hash function. A wyhash-style hash that consumes
+ * its input 8 to 48 bytes at a time and mixes with 64x64->128 bit
+ * multiplications, so similar keys spread well across buckets.
+ * 
+ * @param key - The bytes to hash.
+ * @param len - The amount of bytes to hash.
+ * @param seed - The seed of the hash. A random seed stops attackers from
+ * picking keys that collide on purpose.
+ * @return uint64_t - The full hashed value of the provided bytes.
+ */
+uint64_t HT_hash_bytes(const void* key, size_t len, uint64_t seed) {
+    const uint8_t* p = key;
+    uint64_t a, b;
+    seed ^= _HT_mix(seed ^ HT_SECRET[0], HT_SECRET[1]);
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (_HT_read4(p) << 32) | _HT_read4(p + ((len >> 3) << 2));
+            b = (_HT_read4(p + len - 4) << 32) | _HT_read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = _HT_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = _HT_mix(_HT_read8(p) ^ HT_SECRET[1], _HT_read8(p + 8) ^ seed);
+                see1 = _HT_mix(_HT_read8(p + 16) ^ HT_SECRET[2], _HT_read8(p + 24) ^ see1);
+                see2 = _HT_mix(_HT_read8(p + 32) ^ HT_SECRET[3], _HT_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = _HT_mix(_HT_read8(p) ^ HT_SECRET[1], _HT_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = _HT_read8(p + i - 16);
+        b = _HT_read8(p + i - 8);
+    }
+    a ^= HT_SECRET[1];
+    b ^= seed;
+    _HT_mum(&a, &b);
+    return _HT_mix(a ^ HT_SECRET[0] ^ len, b ^ HT_SECRET[1]);
+}
+
+/**
+ * @brief The original byte-at-a-time hash function. Kept as an
+ * alternative for `HT_set_hash`.
+ * 
+ * @param key - The bytes to hash.
+ * @param len - The amount of bytes to hash.
+ * @param seed - The starting value of the hash.
+ * @return uint64_t - The full hashed value of the provided bytes.
+ */
+uint64_t HT_hash_kr(const void* key, size_t len, uint64_t seed) {
+    const char* bytes = key;
+    uint64_t hashval = seed;
+    for (size_t i = 0; i < len; i++) {
+        hashval = bytes[i] + HASHPRIME * hashval;
+    }
+    return hashval;
+}
+
+/**
+ * @brief Pick a random seed for `HT_set_hash`. Reads from
+ * `/dev/urandom`, falling back on the clock and the stack's address.
+ * 
+ * @return uint64_t - The seed.
+ */
+uint64_t HT_random_seed(void) {
+    uint64_t seed = 0;
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if (urandom) {
+        if (fread(&seed, sizeof(seed), 1, urandom) != 1)
+            seed = 0;
+        fclose(urandom);
+    }
+    if (!seed)
+        seed = ((uint64_t) time(NULL) << 32) ^ (uint64_t) (uintptr_t) &seed;
+    return seed;
+}
+
+/**
+ * @brief Hash the provided bytes with the table's hash function.
+ * 
+ * @param h_table - The hash table whose hash function is used.
+ * @param key - The bytes to hash.
+ * @param len - The amount of bytes to hash.
+ * @return uint64_t - The full hashed value of the provided bytes.
+ */
+uint64_t _HT_hash_of(HT_Ht* h_table, const void* key, size_t len) {
+    HT_PROF_BEGIN(HT_PROF_HASH);
+    uint64_t hash = h_table->hash_fn(key, len, h_table->seed);
+    HT_PROF_END(HT_PROF_HASH);
+    return hash;
+}
+
+/**
+ * @brief Hash the provided key with the table's hash function and
+ * measure its length.
+ * 
+ * @param h_table - The hash table whose hash function is used.
+ * @param key - The key to hash.
+ * @param len - Set to the length of the key, excluding the null character.
+ * @return uint64_t - The full hashed value of the provided key.
+ */
+uint64_t _HT_hash_len(HT_Ht* h_table, char* key, size_t* len) {
+    *len = strlen(key);
+    return _HT_hash_of(h_table, key, *len);
+}
+
+/**
+ * @brief Hash the provided key without reducing it to a bucket index,
+ * using the default hash function and seed.
+ * Tables that store hashes alongside their keys use this full value.
+ * 
+ * @param key - The key to hash.
+ * @return uint64_t - The full hashed value of the provided key.
+ */
+uint64_t HT_hash_key(char* key) {
+    return HT_hash_bytes(key, strlen(key), 0);
+}
 
 /**
  * @brief Hash the provided key and return the hashed value.
@@ -23,257 +258,2138 @@
  * @param key - The key to hash.
  * @param size - The capacity of the hash table. NOTE: NOT the
  * amount of keys within the hash table.
- * @return int - The hashed value of the provided key.
+ * @return uint64_t - The index of the bucket of the provided key.
  */
-unsigned int HT_hash(char* key, int size) {
-    unsigned int hashval;
-    for (hashval = 0; *key != '\0'; key++) {
-        hashval = *key + HASHPRIME * hashval;
-    }
-    return hashval % size;
+uint64_t HT_hash(char* key, size_t size) {
+    return HT_hash_key(key) % size;
 }
 
 /**
- * @brief Initializer function for the hash table.
+ * @brief Pick the size of the pages a large array of buckets is mapped
+ * with. Reserved pages larger than `HT_HUGE_PAGE`, such as 1 GB ones,
+ * are only used if rounding the array up to them wastes at most an
+ * eighth of it, so that a 4 MB array does not take a whole gigabyte.
  * 
- * @param size - The capacity of the hashtable to generate. A larger size
- * means less collisions, but a larger memory allocation.
+ * @param bytes - The bytes of the array.
+ * @param huge_pages - The size of the reserved huge pages, or 0.
+ * @return size_t - The page size, `HT_HUGE_PAGE` unless `huge_pages` is
+ * larger and fits the array.
+ */
+size_t _HT_page_size(size_t bytes, size_t huge_pages) {
+    if (huge_pages <= HT_HUGE_PAGE) return HT_HUGE_PAGE;
+    size_t waste = ((bytes + huge_pages - 1) & ~(huge_pages - 1)) - bytes;
+    return waste <= bytes / 8 ? huge_pages : HT_HUGE_PAGE;
+}
+
+/**
+ * @brief Measure the mapping of a large array of buckets: its bytes
+ * rounded up to whole pages of the size it is mapped with.
  * 
+ * @param bytes - The bytes of the array.
+ * @param huge_pages - The size of the reserved huge pages, or 0.
+ * @return size_t - The length of the mapping.
  */
-HT_Ht* HT_create(unsigned int size) {
-    HT_Ht* hash_table = malloc(sizeof(HT_Ht));
-    hash_table->capacity = size;
-    hash_table->nodes = malloc(sizeof(HT_Node) * size);
+size_t _HT_mapped_bytes(size_t bytes, size_t huge_pages) {
+    size_t page = _HT_page_size(bytes, huge_pages);
+    return (bytes + page - 1) & ~(page - 1);
+}
+
+/**
+ * @brief Allocate an array of empty buckets. Arrays of at least
+ * `HT_HUGE_PAGE` bytes are mapped on their own so that huge pages back
+ * them, sparing lookups of very large tables a TLB miss on most buckets:
+ * reserved huge pages if the table asks for them and some are left, or
+ * else transparent huge pages. Their pages may also be spread over the
+ * NUMA nodes before any of them is touched.
+ * 
+ * @param size - The amount of buckets to allocate.
+ * @param huge_pages - The size of the reserved huge pages to use, or 0.
+ * @param interleave - Whether to interleave the pages over the NUMA nodes.
+ * @return HT_Node** - The array of buckets, all set to NULL, or NULL if
+ * a large array cannot be mapped.
+ */
+HT_Node** _HT_new_buckets(size_t size, size_t huge_pages, int interleave) {
+    size_t bytes = sizeof(HT_Node*) * size;
+    if (bytes >= HT_HUGE_PAGE) {
+        size_t length = _HT_mapped_bytes(bytes, huge_pages);
+        void* nodes = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (huge_pages) {
+            // The page size is given by its logarithm, see mmap(2).
+            int page_bits = __builtin_ctzll(_HT_page_size(bytes, huge_pages)) << 26;
+            nodes = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | page_bits, -1, 0);
+        }
+#endif
+        if (nodes == MAP_FAILED) {
+            nodes = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (nodes != MAP_FAILED)
+                madvise(nodes, length, MADV_HUGEPAGE);
+#endif
+        }
+        if (interleave && nodes != MAP_FAILED)
+            HT_numa_interleave(nodes, length);
+        // Anonymous pages are zeroed, so every bucket is already NULL.
+        return nodes == MAP_FAILED ? NULL : nodes;
+    }
+    HT_Node** nodes = malloc(bytes);
     // Initializing all entries in the table to NULL may take longer, but
     // it's a one-off operation that saves some computations in the long term.
     // If the values are not explicitly set to NULL, we cannot rely on their
     // values.
-    for (int i = 0; i < size; i++)
-        hash_table->nodes[i] = NULL;
-    return hash_table;
+    for (size_t i = 0; i < size; i++)
+        nodes[i] = NULL;
+    return nodes;
 }
 
 /**
- * @brief Helper function to recursively search a linked
- * list of nodes within a bucket of the hash table to find 
- * whether or not the provided value exists.
+ * @brief Free an array of buckets allocated by `_HT_new_buckets`.
  * 
- * @param node - The root node of the linked list of nodes
- * to search.
- * @param key - The key to search within the provided linked list. 
- * @return int - 0 if not found, 1 if found.
+ * @param nodes - The array of buckets. May be NULL.
+ * @param size - The amount of buckets of the array.
+ * @param huge_pages - The size of the reserved huge pages it was allocated with.
  */
-int _HT_check(HT_Node* node, char* key) {
-    
-    if (node == NULL) {
-        return 0;
+void _HT_free_buckets(HT_Node** nodes, size_t size, size_t huge_pages) {
+    size_t bytes = sizeof(HT_Node*) * size;
+    if (bytes < HT_HUGE_PAGE)
+        free(nodes);
+    else if (nodes)
+        munmap(nodes, _HT_mapped_bytes(bytes, huge_pages));
+}
+
+/**
+ * @brief Allocate an occupancy bitmap with a cleared bit per bucket.
+ * 
+ * @param size - The amount of buckets the bitmap covers.
+ * @return uint64_t* - The bitmap, all set to 0.
+ */
+uint64_t* _HT_new_bitmap(size_t size) {
+    return calloc((size + 63) / 64, sizeof(uint64_t));
+}
+
+/**
+ * @brief Find the first bucket at or after `index` that is not empty.
+ * 
+ * @param bitmap - The occupancy bitmap of the buckets.
+ * @param size - The amount of buckets.
+ * @param index - The bucket to start from.
+ * @return size_t - The index of the bucket, or `size` if every
+ * following bucket is empty.
+ */
+size_t _HT_next_occupied(uint64_t* bitmap, size_t size, size_t index) {
+    if (index >= size) return size;
+    size_t word = index >> 6;
+    uint64_t bits = bitmap[word] & (~0ull << (index & 63));
+    while (!bits) {
+        if (++word >= (size + 63) / 64) return size;
+        bits = bitmap[word];
     }
-    
-    if (!strcmp(node->key,key)) {
-        return 1;
+    index = (word << 6) + __builtin_ctzll(bits);
+    return index < size ? index : size;
+}
+
+/**
+ * @brief Update the occupancy bit of a bucket whose head has changed.
+ * 
+ * @param h_table - The hash table owning the bucket.
+ * @param bucket - The head of the bucket, as returned by `_HT_bucket`.
+ */
+void _HT_sync_bit(HT_Ht* h_table, HT_Node** bucket) {
+    uint64_t* bitmap = h_table->occupied;
+    size_t index = bucket - h_table->nodes;
+    if (h_table->old_nodes && bucket >= h_table->old_nodes
+        && bucket < h_table->old_nodes + h_table->old_capacity) {
+        bitmap = h_table->old_occupied;
+        index = bucket - h_table->old_nodes;
     }
-    return _HT_check(node->next, key);
+    if (*bucket)
+        bitmap[index >> 6] |= 1ull << (index & 63);
+    else
+        bitmap[index >> 6] &= ~(1ull << (index & 63));
 }
 
 /**
- * @brief Determine whether or not the provided key
- * exists within the hash table. NOTE: The function does
- * not return the value of the provided key -- only whether
- * or not it exists.
+ * @brief Initializer function for the hash table.
+ * 
+ * @param size - The initial capacity of the hashtable to generate, rounded
+ * up to a power of two, at most `HT_MAX_CAPACITY`. The table grows on its own as keys are added, so
+ * this is only a hint of the expected amount of keys.
  * 
- * @param h_table - The hash table to search.
- * @param key - The key of the searched value.
- * @return int - 0 if not found, 1 if found.
  */
-int HT_check(HT_Ht* h_table, char* key) {
-    unsigned int hash_val = HT_hash(key, h_table->capacity);
-    return _HT_check(h_table->nodes[hash_val], key);
+HT_Ht* HT_create(size_t size) {
+    // Capacities are powers of two so a hash is reduced to a
+    // bucket with a mask instead of a division.
+    size_t capacity = 1;
+    while (capacity < size && capacity < HT_MAX_CAPACITY)
+        capacity *= 2;
+    HT_Ht* hash_table = malloc(sizeof(HT_Ht));
+    hash_table->capacity = capacity;
+    hash_table->huge_pages = 0;
+    hash_table->interleave = 0;
+    hash_table->nodes = _HT_new_buckets(capacity, 0, 0);
+    hash_table->occupied = _HT_new_bitmap(capacity);
+    hash_table->old_occupied = NULL;
+    hash_table->paused = 0;
+    hash_table->hits = 0;
+    hash_table->misses = 0;
+    hash_table->resizes = 0;
+    hash_table->evictions = 0;
+    hash_table->expirations = 0;
+    hash_table->cache = 0;
+    hash_table->clock = HT_clock_seconds;
+    hash_table->max_entries = 0;
+    hash_table->max_bytes = 0;
+    hash_table->bytes = 0;
+    hash_table->clock_hand = 0;
+    hash_table->size = 0;
+    hash_table->min_capacity = capacity;
+    hash_table->hash_fn = HT_hash_bytes;
+    hash_table->seed = 0;
+    hash_table->node_arena = NULL;
+    hash_table->key_arena = NULL;
+    hash_table->free_nodes = NULL;
+    hash_table->compacting = 0;
+    hash_table->old_node_arena = NULL;
+    hash_table->old_key_arena = NULL;
+    hash_table->index = NULL;
+    hash_table->borrow_keys = 0;
+    hash_table->intern = NULL;
+    hash_table->shrink = 0;
+    hash_table->old_capacity = 0;
+    hash_table->old_nodes = NULL;
+    hash_table->rehash_index = 0;
+    return hash_table;
 }
 
 /**
- * @brief A helper function to search the provided linked
- * list of nodes to find the value of a particular key. It is
- * assumed that the key is present. Use `HT_check` if unsure.
+ * @brief Allow or forbid the provided hash table to shrink
+ * when keys are removed. Tables never shrink below the
+ * capacity they were created with. Disabled by default.
  * 
- * @param nodes - Pointer to the root of the linked list
- * of nodes.
- * @param key - The key to search.
- * @return int - The value of the provided key.
+ * @param h_table - The hash table to configure.
+ * @param enabled - 1 to allow shrinking, 0 to forbid it.
+ */
+void HT_set_shrink(HT_Ht* h_table, int enabled) {
+    h_table->shrink = enabled;
+}
+
+/**
+ * @brief Back the large arrays of buckets of the provided hash table
+ * (of at least `HT_HUGE_PAGE` bytes) with huge pages reserved by the
+ * system, e.g. through `vm.nr_hugepages`. Whenever none are left, arrays
+ * fall back to transparent huge pages, which large arrays of every table
+ * ask for. Arrays much smaller than `HT_HUGE_PAGE_1G` use `HT_HUGE_PAGE`
+ * pages even if 1 GB ones are asked for. This is only possible while the
+ * table is empty.
+ * 
+ * @param h_table - The hash table to configure.
+ * @param page_size - `HT_HUGE_PAGE`, `HT_HUGE_PAGE_1G`, or 0 to only ask
+ * for transparent huge pages.
+ * @return int - 1 if the page size was set, 0 if the table is not empty,
+ * the size is not a power of two of at least `HT_HUGE_PAGE`, or the array
+ * cannot be mapped again, in which case the table keeps its old one.
+ */
+int HT_use_huge_pages(HT_Ht* h_table, size_t page_size) {
+    if (h_table->size || h_table->old_nodes) return 0;
+    if (page_size && (page_size < HT_HUGE_PAGE || (page_size & (page_size - 1)))) return 0;
+    // The empty array is mapped again so that it is freed with the page
+    // size it was allocated with.
+    HT_Node** nodes = _HT_new_buckets(h_table->capacity, page_size, h_table->interleave);
+    if (!nodes) return 0;
+    _HT_free_buckets(h_table->nodes, h_table->capacity, h_table->huge_pages);
+    h_table->huge_pages = page_size;
+    h_table->nodes = nodes;
+    return 1;
+}
+
+/**
+ * @brief Spread the pages of the large arrays of buckets of the provided
+ * hash table (of at least `HT_HUGE_PAGE` bytes) round-robin over the NUMA
+ * nodes of the machine, so that threads of every node share the memory
+ * bandwidth of lookups and each pays the same remote latency on average,
+ * instead of the threads of every other node paying it in full. The
+ * current array is moved at once, and later ones are interleaved as they
+ * are allocated. Nodes still live wherever they were allocated; see
+ * `HT_versioned_replicate` for read-mostly tables with a copy per node.
+ * 
+ * @param h_table - The hash table to configure.
+ * @return int - 1 if the machine has several nodes to spread over, 0 if
+ * interleaving changes nothing.
+ */
+int HT_use_interleave(HT_Ht* h_table) {
+    h_table->interleave = 1;
+    if (HT_numa_nodes() <= 1) return 0;
+    size_t bytes = sizeof(HT_Node*) * h_table->capacity;
+    if (bytes >= HT_HUGE_PAGE)
+        HT_numa_interleave(h_table->nodes, _HT_mapped_bytes(bytes, h_table->huge_pages));
+    bytes = sizeof(HT_Node*) * h_table->old_capacity;
+    if (h_table->old_nodes && bytes >= HT_HUGE_PAGE)
+        HT_numa_interleave(h_table->old_nodes, _HT_mapped_bytes(bytes, h_table->huge_pages));
+    return 1;
+}
+
+/**
+ * @brief Replace the hash function of the provided hash table. This
+ * is only possible while the table is empty, since stored hashes
+ * would no longer match.
+ * 
+ * @param h_table - The hash table to configure.
+ * @param hash_fn - The hash function to use, or NULL for `HT_hash_bytes`.
+ * @param seed - The seed passed to every call of the hash function. Use
+ * `HT_random_seed` to protect against keys chosen to collide.
+ * @return int - 1 if the hash function was replaced, 0 if the table
+ * is not empty.
+ */
+int HT_set_hash(HT_Ht* h_table, HT_Hash_fn hash_fn, uint64_t seed) {
+    if (h_table->size) return 0;
+    h_table->hash_fn = hash_fn ? hash_fn : HT_hash_bytes;
+    h_table->seed = seed;
+    return 1;
+}
+
+/**
+ * @brief Make the provided hash table carve its nodes and keys out of
+ * per-table arenas instead of calling `malloc` twice per key. Removed
+ * nodes are kept on a free list for later keys, and `HT_destroy` then
+ * releases the whole table in time proportional to the amount of slabs.
+ * This is only possible while the table is empty.
+ * 
+ * @param h_table - The hash table to configure.
+ * @return int - 1 if the table now uses arenas, 0 if it is not empty.
  */
-int _HT_find(HT_Node* nodes, char* key) {
-    if (!strcmp(nodes->key,key)) { // if 0 they are equal (idk why they wrote it this way).
-        return nodes->value;
+int HT_use_arena(HT_Ht* h_table) {
+    if (h_table->size) return 0;
+    if (!h_table->node_arena) {
+        h_table->node_arena = HT_arena_create();
+        h_table->key_arena = HT_arena_create();
     }
-    return _HT_find(nodes->next, key);
+    return 1;
 }
 
 /**
- * @brief Find the value of a provided key within a linked
- * list and return it. NOTE: This will segfault if the value does
- * not exist.
+ * @brief Make the provided hash table keep pointers to the keys it is
+ * given instead of copying them. Keys shorter than `HT_INLINE_KEY` are
+ * still copied into their node, which costs no allocation. The caller
+ * must keep every longer key alive and unchanged for as long as it is in
+ * the table, and frees them itself. This is only possible while the
+ * table is empty, and not along with `HT_use_intern`.
  * 
- * @param h_table - The hash table to search.
- * @param key - The key to compare within the hash table.
- * @return int - The value of the provided key within the hash
- * table.
+ * @param h_table - The hash table to configure.
+ * @return int - 1 if the table now borrows its keys, 0 otherwise.
  */
-int HT_find(HT_Ht* h_table, char* key) {
-    unsigned int hash_val = HT_hash(key, h_table->capacity);
-    return _HT_find(h_table->nodes[hash_val], key);
+int HT_borrow_keys(HT_Ht* h_table) {
+    if (h_table->size || h_table->intern) return 0;
+    h_table->borrow_keys = 1;
+    return 1;
 }
 
 /**
- * @brief A helper function to find the provided key
- * within a hash table and return a pointer to its node.
+ * @brief Make the provided hash table store the keys too long to be
+ * inlined in a pool shared with other tables, so that a key held by
+ * several of them is stored once. The pool counts the nodes referencing
+ * each key and frees it along with the last one. Pools lock every access,
+ * so tables sharing one may be changed, or destroyed, on different
+ * threads at the same time, as versions of an `HT_Versioned` are when
+ * readers retire them. Each table still needs its own synchronization,
+ * and the pool must outlive them. This is only possible while the table
+ * is empty, and not along with `HT_borrow_keys`.
  * 
- * @param h_table - The hash table to search.
- * @param s - The key within the hash table to compare. The node
- * containing the first matching key will be returned.
- * @return HT_Node* - The node containing the provided
- * key within the hash table.
+ * @param h_table - The hash table to configure.
+ * @param pool - The pool to share keys through.
+ * @return int - 1 if the table now uses the pool, 0 otherwise.
+ */
+int HT_use_intern(HT_Ht* h_table, HT_Intern* pool) {
+    if (h_table->size || h_table->borrow_keys) return 0;
+    h_table->intern = pool;
+    return 1;
+}
+
+/**
+ * @brief Migrate a single bucket of the old array of buckets during a
+ * compaction. The array keeps its capacity, so the bucket's chain moves
+ * to the same bucket of the new array, its nodes copied one after the
+ * other into the new arenas, in order. Nodes on the heap are freed as
+ * they are copied, and those of old arenas are freed with them later.
+ * 
+ * @param h_table - The hash table being compacted.
+ * @param index - The index of the old bucket to migrate.
  */
-HT_Node* _lookup(HT_Ht* h_table, char* s) {
-    HT_Node* np;
-    for (np = h_table->nodes[HT_hash(s, h_table->capacity)]; np != NULL; np = np->next) {
-        if (!strcmp(s, np->key))
-            return np; /* found */
+void _HT_compact_bucket(HT_Ht* h_table, size_t index) {
+    int owned = !h_table->borrow_keys && !h_table->intern;
+    HT_Node** tail = &(h_table->nodes[index]);
+    for (HT_Node* node = h_table->old_nodes[index]; node;) {
+        HT_Node* next = node->next;
+        HT_Node* copy = HT_arena_alloc(h_table->node_arena, sizeof(HT_Node), _Alignof(HT_Node));
+        *copy = *node;
+        if (node->key == node->inline_key) {
+            copy->key = copy->inline_key;
+        } else if (owned) {
+            copy->key = HT_arena_alloc(h_table->key_arena, node->key_len + 1, 1);
+            memcpy(copy->key, node->key, node->key_len + 1);
+            if (!h_table->old_node_arena)
+                free(node->key);
+        }
+        // Borrowed and interned keys stay where they are, along with
+        // the reference of the node.
+        if (h_table->index)
+            HT_index_replace(h_table->index, node, copy);
+        if (!h_table->old_node_arena)
+            free(node);
+        *tail = copy;
+        tail = &(copy->next);
+        node = next;
     }
-    return NULL; /* not found */
+    *tail = NULL;
+    if (h_table->nodes[index])
+        h_table->occupied[index >> 6] |= 1ull << (index & 63);
+    h_table->old_nodes[index] = NULL;
+    h_table->old_occupied[index >> 6] &= ~(1ull << (index & 63));
 }
 
 /**
- * @brief A helper function to recurse through a linked
- * list of nodes in a bucket and print them out in a
- * human-readable format.
+ * @brief Migrate a single bucket of the old array of buckets
+ * into the new one. The chain is reversed before being moved so
+ * that prepending each node keeps keys in the same relative order.
  * 
- * @param node - The root node of the linked list representing
- * a bucket of the hash table.
+ * @param h_table - The hash table being rehashed.
+ * @param index - The index of the old bucket to migrate.
  */
-void _HT_print(HT_Node* node) {
-    if (!node) return;
-    printf("{\"%s\": %d}\n",node->key, node->value);
-    _HT_print(node->next);
+void _HT_migrate_bucket(HT_Ht* h_table, size_t index) {
+    if (h_table->compacting == 2) {
+        _HT_compact_bucket(h_table, index);
+        return;
+    }
+    HT_Node* reversed = NULL;
+    HT_Node* node = h_table->old_nodes[index];
+    while (node) {
+        HT_Node* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+    while (reversed) {
+        HT_Node* next = reversed->next;
+        size_t hash_val = reversed->hash & (h_table->capacity - 1); // No key bytes are read.
+        reversed->next = h_table->nodes[hash_val];
+        h_table->nodes[hash_val] = reversed;
+        h_table->occupied[hash_val >> 6] |= 1ull << (hash_val & 63);
+        reversed = next;
+    }
+    h_table->old_nodes[index] = NULL;
+    h_table->old_occupied[index >> 6] &= ~(1ull << (index & 63));
 }
 
 /**
- * @brief Print the provided hash table to STDOUT in a human-readable
- * manner.
+ * @brief Migrate the next buckets of an incremental rehash, if one is in
+ * progress, and finish it once the old array is empty. The old arenas
+ * of a compaction are freed with it.
  * 
- * @param h_table - The table to be printed out.
+ * @param h_table - The hash table being rehashed.
+ * @param amount - The most buckets to migrate.
  */
-void HT_print(HT_Ht* h_table) {
-    for (int x = 0; x < h_table->capacity; x++) {
-        printf("=====BUCKET %d=====\n",x);
-        if (h_table->nodes[x]) {
-            _HT_print(h_table->nodes[x]);
-        } else {
-            printf("{{{EMPTY}}}\n");
+void _HT_rehash_buckets(HT_Ht* h_table, size_t amount) {
+    if (!h_table->old_nodes || h_table->paused) return;
+    for (size_t step = 0; step < amount && h_table->rehash_index < h_table->old_capacity; step++) {
+        _HT_migrate_bucket(h_table, h_table->rehash_index++);
+    }
+    if (h_table->rehash_index == h_table->old_capacity) {
+        _HT_free_buckets(h_table->old_nodes, h_table->old_capacity, h_table->huge_pages);
+        free(h_table->old_occupied);
+        h_table->old_nodes = NULL;
+        h_table->old_occupied = NULL;
+        h_table->old_capacity = 0;
+        h_table->rehash_index = 0;
+        if (h_table->compacting == 2) {
+            if (h_table->old_node_arena) {
+                HT_arena_destroy(h_table->old_node_arena);
+                HT_arena_destroy(h_table->old_key_arena);
+            }
+            h_table->old_node_arena = NULL;
+            h_table->old_key_arena = NULL;
+            h_table->compacting = 0;
         }
     }
 }
 
 /**
- * @brief Add a key-value pair to the provided hash table.
+ * @brief Perform one step of an incremental rehash, if one
+ * is in progress. Each step migrates at most `HT_REHASH_STEP`
+ * buckets, so no single operation pays for a full rehash.
  * 
- * @param key - The key to be added.
- * @param value - The value to be added.
+ * @param h_table - The hash table being rehashed.
  */
-void HT_add(HT_Ht* h_table, char* key, int value) {
-    unsigned int hash_val = HT_hash(key, h_table->capacity);
-    HT_Node* new_node = malloc(sizeof(HT_Node));
-    char* new_key = malloc(sizeof(char) * (strlen(key) + 1));
-    strcpy(new_key, key);
-    new_node->key = new_key;
-    new_node->value = value;
-    // We can do this because the values are initialized
-    // to null.
-    new_node->next = h_table->nodes[hash_val];
-    h_table->nodes[hash_val] = new_node;
+void _HT_rehash_step(HT_Ht* h_table) {
+    _HT_rehash_buckets(h_table, HT_REHASH_STEP);
 }
 
 /**
- * @brief Change the value of an entry in the hash
- * table provided the key. NOTE: This assumes the value
- * already exists. This will cause errors if it dosen't.
+ * @brief Start migrating the hash table to a new array of buckets.
+ * The keys themselves are moved over later by `_HT_rehash_step`.
  * 
- * @param h_table - The hash table to change.
- * @param key - The key of the value to change.
- * @param new_value - The new value to add.
+ * @param h_table - The hash table to resize.
+ * @param capacity - The new capacity of the hash table.
+ * @return int - 1 if the rehash started, 0 if the new array of buckets
+ * cannot be allocated, in which case the table is left as it was.
  */
-void HT_change(HT_Ht* h_table, char* key, int new_value) {
-    HT_Node* node = _lookup(h_table,key);
-    node->value = new_value;
+int _HT_start_rehash(HT_Ht* h_table, size_t capacity) {
+    HT_Node** nodes = _HT_new_buckets(capacity, h_table->huge_pages, h_table->interleave);
+    if (!nodes) return 0;
+    HT_COUNT(h_table, resizes, 1);
+    h_table->old_nodes = h_table->nodes;
+    h_table->old_capacity = h_table->capacity;
+    h_table->rehash_index = 0;
+    h_table->old_occupied = h_table->occupied;
+    h_table->nodes = nodes;
+    h_table->occupied = _HT_new_bitmap(capacity);
+    h_table->capacity = capacity;
+    return 1;
 }
 
 /**
- * @brief Helper function to recursively remove a node given a key within a
- * bucket of a hash-table.
+ * @brief Start a rehash if the load factor of the hash table is out of
+ * bounds. A resize is postponed while a previous one is still in progress
+ * or while rehashing is paused, and retried later if its array of
+ * buckets cannot be allocated.
  * 
- * @param node - The root node of the linked list to search.
- * @param key - The key to compare within the linked list.
+ * @param h_table - The hash table to check.
  */
-void _HT_remove_node(HT_Node** node, char* key) {
-    if (!strcmp((*node)->key,key)) {
-        // The first node is the one that must be removed.
-        free(*node);
-        *node = NULL;
-        return;
+void _HT_check_load(HT_Ht* h_table) {
+    if (h_table->old_nodes || h_table->paused) return;
+    if (h_table->size > h_table->capacity * HT_GROW_LOAD) {
+        _HT_start_rehash(h_table, h_table->capacity * 2);
+    } else if (h_table->shrink && h_table->capacity / 2 >= h_table->min_capacity
+               && h_table->size < h_table->capacity / HT_SHRINK_RATIO) {
+        _HT_start_rehash(h_table, h_table->capacity / 2);
     }
-    if (!strcmp((*node)->next->key,key)) {
-        HT_Node* next = (*node)->next->next;
-        HT_Node* cur = (*node)->next;
-        HT_Node* prev = *node;
-        prev->next = next;
-        free(cur);
-        return;
+}
+
+/**
+ * @brief Find the bucket a key with the provided hash belongs to. While
+ * the table is being rehashed, keys whose old bucket has not been
+ * migrated yet still live in the old array of buckets.
+ * 
+ * @param h_table - The hash table to search.
+ * @param hash - The full hash of the key to locate.
+ * @return HT_Node** - A pointer to the head of the key's bucket.
+ */
+HT_Node** _HT_bucket(HT_Ht* h_table, uint64_t hash) {
+    if (h_table->old_nodes) {
+        size_t old_val = hash & (h_table->old_capacity - 1);
+        if (old_val >= h_table->rehash_index)
+            return &(h_table->old_nodes[old_val]);
     }
-    _HT_remove_node(&((*node)->next), key);
+    return &(h_table->nodes[hash & (h_table->capacity - 1)]);
 }
 
 /**
- * @brief Remove a key-value pair from the hash table given
- * a key. The key's node will be deleted. NOTE: Assumes the
- * key already exists within the hash table. Will cause errors
- * if it dosen't.
+ * @brief Determine whether the provided node holds the provided key.
+ * The cached hash and length are compared first, so the key bytes are
+ * only read when they are very likely to match.
  * 
- * @param h_table - The hash table on which the lookup is to
- * be performed.
- * @param key - The key of the key-value pair to be deleted. 
+ * @param node - The node to compare.
+ * @param key - The key to compare against.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return int - 1 if the node holds the key, 0 otherwise.
  */
-void HT_remove(HT_Ht* h_table, char* key) {
-    return _HT_remove_node(&(h_table->nodes[HT_hash(key,h_table->capacity)]), key);
+int _HT_matches(HT_Node* node, const void* key, uint64_t hash, size_t len) {
+    return node->hash == hash && node->key_len == len && !memcmp(node->key, key, len);
 }
 
 /**
- * @brief A helper function to destroy an array
- * of nodes within a bucket within a hash table.
+ * @brief Find the link pointing to the node holding the provided key:
+ * either the head of its bucket or the `next` field of the node before
+ * it. Returning the link instead of the node lets callers unlink or
+ * insert in the same pass as the lookup.
  * 
- * @param node - The first node in the linked
- * list of nodes to destroy.
+ * @param h_table - The hash table to search.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return HT_Node** - The link to the key's node. It points to NULL,
+ * at the end of the key's bucket, if the key is not found.
+ */
+HT_Node** _HT_link(HT_Ht* h_table, const void* key, uint64_t hash, size_t len) {
+    HT_Node** link = _HT_bucket(h_table, hash);
+    while (*link && !_HT_matches(*link, key, hash, len))
+        link = &((*link)->next);
+    return link;
+}
+
+/**
+ * @brief Determine whether the nodes of a bucket are still in the storage
+ * a compaction is moving them out of. During a compaction, every bucket of
+ * the old array keeps its nodes where they were, in the old arenas or on
+ * the heap, until it is migrated.
+ * 
+ * @param h_table - The hash table owning the bucket.
+ * @param bucket - The head of the bucket.
+ * @return int - 1 if the bucket's nodes are in the old storage, 0 if they
+ * are in `node_arena` or on the heap for a table without arenas.
+ */
+int _HT_old_storage(HT_Ht* h_table, HT_Node** bucket) {
+    return h_table->compacting == 2 && h_table->old_nodes && bucket >= h_table->old_nodes
+        && bucket < h_table->old_nodes + h_table->old_capacity;
+}
+
+/**
+ * @brief Compute the bytes a key takes up in a table, as counted
+ * against the byte limit of cache mode.
+ * 
+ * @param h_table - The hash table the key is for.
+ * @param len - The length of the key.
+ * @return size_t - The bytes of the key's node, and of the key itself
+ * if the table stores its own copy outside the node.
+ */
+size_t _HT_node_bytes(HT_Ht* h_table, size_t len) {
+    int shared = h_table->borrow_keys || h_table->intern;
+    return sizeof(HT_Node) + (len < HT_INLINE_KEY || shared ? 0 : len + 1);
+}
+
+/**
+ * @brief Take a reference to a key of an intern pool, adding the key to
+ * the pool if it is not there yet. Pools are plain tables whose nodes
+ * are allocated one by one, and which never hold keys of another pool.
+ * 
+ * @param pool - The pool to search.
+ * @param key - The key to intern.
+ * @param len - The length of the key.
+ * @return unsigned char* - The pool's copy of the key. It stays at the
+ * same address until its last reference is dropped.
+ */
+unsigned char* _HT_intern_acquire(HT_Intern* pool, const void* key, size_t len) {
+    pthread_mutex_lock(&pool->lock);
+    HT_Ht* keys = pool->keys;
+    _HT_rehash_step(keys);
+    uint64_t hash = keys->hash_fn(key, len, keys->seed);
+    HT_Node** link = _HT_link(keys, key, hash, len);
+    if (*link) {
+        (*link)->value++;
+        unsigned char* copy = (*link)->key;
+        pthread_mutex_unlock(&pool->lock);
+        return copy;
+    }
+    HT_Node** bucket = _HT_bucket(keys, hash);
+    HT_Node* node = malloc(sizeof(HT_Node));
+    node->key = len < HT_INLINE_KEY ? node->inline_key : malloc(sizeof(char) * (len + 1));
+    memcpy(node->key, key, len);
+    node->key[len] = '\0';
+    node->key_len = len;
+    node->hash = hash;
+    node->value = 1;
+    node->expires = 0;
+    node->referenced = 0;
+    node->next = *bucket;
+    *bucket = node;
+    _HT_sync_bit(keys, bucket);
+    keys->size++;
+    keys->bytes += _HT_node_bytes(keys, len);
+    _HT_check_load(keys);
+    pthread_mutex_unlock(&pool->lock);
+    return node->key;
+}
+
+/**
+ * @brief Drop a reference to a key of an intern pool, removing the key
+ * from the pool once nothing references it anymore.
+ * 
+ * @param pool - The pool holding the key.
+ * @param key - The key to release.
+ * @param len - The length of the key.
  */
-void _HT_destroy_nodes(HT_Node * node) {
-    if (node == NULL) return;
-    HT_Node* next = node->next;
-    free(node->key); // Free string key.
+void _HT_intern_drop(HT_Intern* pool, const void* key, size_t len) {
+    pthread_mutex_lock(&pool->lock);
+    HT_Ht* keys = pool->keys;
+    _HT_rehash_step(keys);
+    uint64_t hash = keys->hash_fn(key, len, keys->seed);
+    HT_Node** link = _HT_link(keys, key, hash, len);
+    HT_Node* node = *link;
+    if (!node || --node->value > 0) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    *link = node->next;
+    _HT_sync_bit(keys, _HT_bucket(keys, hash));
+    keys->size--;
+    keys->bytes -= _HT_node_bytes(keys, len);
+    if (node->key != node->inline_key)
+        free(node->key);
     free(node);
-    _HT_destroy_nodes(next);
+    _HT_check_load(keys);
+    pthread_mutex_unlock(&pool->lock);
 }
 
 /**
- * @brief Destroy the provided hash table.
+ * @brief Allocate a node holding the provided key. Keys shorter than
+ * `HT_INLINE_KEY` are copied into the node itself, and longer keys are
+ * copied, borrowed or interned depending on the table. Tables using an
+ * arena first reuse a removed node, along with its key bytes if the new
+ * key fits in them, then carve from the arena's slabs.
  * 
- * @param h_table - The table to destroy.
+ * @param h_table - The hash table the node is for.
+ * @param bucket - The head of the bucket the node is for.
+ * @param key - The key to store in the node.
+ * @param len - The length of the key.
+ * @return HT_Node* - The new node. Only its key is set.
+ */
+HT_Node* _HT_new_node(HT_Ht* h_table, HT_Node** bucket, const void* key, size_t len) {
+    HT_PROF_BEGIN(HT_PROF_ALLOC);
+    HT_Node* node;
+    int inline_key = len < HT_INLINE_KEY;
+    // Only long keys of tables that copy their keys need storage of their own.
+    int owned = !inline_key && !h_table->borrow_keys && !h_table->intern;
+    HT_Arena* node_arena = h_table->node_arena;
+    HT_Arena* key_arena = h_table->key_arena;
+    // Buckets a compaction has not reached yet keep to the old storage.
+    if (_HT_old_storage(h_table, bucket)) {
+        node_arena = h_table->old_node_arena;
+        key_arena = h_table->old_key_arena;
+    }
+    if (!node_arena) {
+        node = malloc(sizeof(HT_Node));
+        node->key = owned ? malloc(sizeof(char) * (len + 1)) : node->inline_key;
+    } else if (node_arena == h_table->node_arena && h_table->free_nodes) {
+        node = h_table->free_nodes;
+        h_table->free_nodes = node->next;
+        if (!owned)
+            node->key = node->inline_key;
+        else if (node->key == node->inline_key || node->key_len < len)
+            node->key = HT_arena_alloc(h_table->key_arena, len + 1, 1);
+    } else {
+        node = HT_arena_alloc(node_arena, sizeof(HT_Node), _Alignof(HT_Node));
+        node->key = owned ? HT_arena_alloc(key_arena, len + 1, 1) : node->inline_key;
+    }
+    if (inline_key || owned) {
+        // Binary keys have no terminator of their own, but printing needs one.
+        memcpy(node->key, key, len);
+        node->key[len] = '\0';
+    } else if (h_table->intern) {
+        node->key = _HT_intern_acquire(h_table->intern, key, len);
+    } else {
+        node->key = (unsigned char*) key;
+    }
+    node->key_len = len;
+    node->expires = 0;
+    node->referenced = 0;
+    h_table->bytes += _HT_node_bytes(h_table, len);
+    HT_PROF_END(HT_PROF_ALLOC);
+    return node;
+}
+
+/**
+ * @brief Let go of the key of a node that is being released: free the
+ * table's own copy, or drop the node's reference to an interned key.
+ * Borrowed keys are left alone, as are keys living in an arena, whose
+ * bytes are reused or freed along with it.
  * 
+ * @param h_table - The hash table the node belongs to.
+ * @param node - The node whose key to let go of.
+ * @param in_arena - Whether the node lives in an arena.
  */
-void HT_destroy(HT_Ht* h_table) {
-    // Free each individual node to account for nodes
-    // having been added. The entire block cannot
-    // simply be removed because of `HT_add`.
-    for (int cur = 0; cur < h_table->capacity; cur++) {
-        if (!(h_table->nodes[cur] == NULL)) {
-            // Exists.
-            _HT_destroy_nodes(h_table->nodes[cur]);
+void _HT_drop_key(HT_Ht* h_table, HT_Node* node, int in_arena) {
+    if (node->key == node->inline_key || h_table->borrow_keys) return;
+    if (h_table->intern)
+        _HT_intern_drop(h_table->intern, node->key, node->key_len);
+    else if (!in_arena)
+        free(node->key);
+}
+
+/**
+ * @brief Give back a node that has been unlinked from its bucket.
+ * 
+ * @param h_table - The hash table the node belonged to.
+ * @param bucket - The head of the bucket the node belonged to.
+ * @param node - The node to release.
+ */
+void _HT_release_node(HT_Ht* h_table, HT_Node** bucket, HT_Node* node) {
+    HT_PROF_BEGIN(HT_PROF_ALLOC);
+    h_table->bytes -= _HT_node_bytes(h_table, node->key_len);
+    HT_Arena* arena = _HT_old_storage(h_table, bucket) ? h_table->old_node_arena : h_table->node_arena;
+    _HT_drop_key(h_table, node, arena != NULL);
+    if (!arena) {
+        free(node);
+    } else if (arena == h_table->node_arena) {
+        // The node and its key bytes stay in the arena for reuse.
+        node->next = h_table->free_nodes;
+        h_table->free_nodes = node;
+    }
+    // Nodes of the old arenas of a compaction are freed along with them.
+    HT_PROF_END(HT_PROF_ALLOC);
+}
+
+/**
+ * @brief Determine whether the time to live of a node has run out. The
+ * clock is only read for nodes given a time to live.
+ * 
+ * @param h_table - The hash table owning the node.
+ * @param node - The node to check.
+ * @return int - 1 if the node has expired, 0 otherwise.
+ */
+int _HT_expired(HT_Ht* h_table, HT_Node* node) {
+    return node->expires && h_table->clock() >= node->expires;
+}
+
+/**
+ * @brief Unlink a node from its bucket and release it.
+ * 
+ * @param h_table - The hash table owning the node.
+ * @param link - The link pointing to the node.
+ * @param bucket - The head of the node's bucket.
+ */
+void _HT_delete(HT_Ht* h_table, HT_Node** link, HT_Node** bucket) {
+    HT_Node* node = *link;
+    *link = node->next;
+    _HT_sync_bit(h_table, bucket);
+    if (h_table->index)
+        HT_index_erase(h_table->index, node);
+    _HT_release_node(h_table, bucket, node);
+    h_table->size--;
+}
+
+/**
+ * @brief Unlink a node found by a walk over the table and release it.
+ * 
+ * @param h_table - The hash table owning the node.
+ * @param node - The node to remove.
+ */
+void _HT_unlink(HT_Ht* h_table, HT_Node* node) {
+    HT_Node** bucket = _HT_bucket(h_table, node->hash);
+    HT_Node** link = bucket;
+    while (*link != node)
+        link = &((*link)->next);
+    _HT_delete(h_table, link, bucket);
+}
+
+/**
+ * @brief Find the node of a key in a table in cache mode. Expired keys
+ * are removed as they are found, unless an iterator has paused the table,
+ * and found keys are marked as referenced for the eviction hand. The mark
+ * is only written once, so repeated reads do not dirty the node.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return HT_Node* - The node of the key, or NULL if it is missing or expired.
+ */
+HT_Node* _HT_cache_get(HT_Ht* h_table, const void* key, uint64_t hash, size_t len) {
+    for (;;) {
+        HT_Node** link = _HT_link(h_table, key, hash, len);
+        HT_Node* node = *link;
+        if (!node) return NULL;
+        if (_HT_expired(h_table, node)) {
+            if (h_table->paused) return NULL;
+            _HT_delete(h_table, link, _HT_bucket(h_table, hash));
+            HT_COUNT(h_table, expirations, 1);
+            continue; // A duplicate of the key may still be alive.
         }
+        if (!node->referenced)
+            node->referenced = 1;
+        return node;
     }
-    free(h_table); // Destroy the struct itself.
+}
+
+/**
+ * @brief Find the node of a key, going through `_HT_cache_get` for
+ * tables in cache mode.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return HT_Node* - The node of the key, or NULL if it is missing.
+ */
+HT_Node* _HT_live(HT_Ht* h_table, const void* key, uint64_t hash, size_t len) {
+    if (h_table->cache)
+        return _HT_cache_get(h_table, key, hash, len);
+    return *_HT_link(h_table, key, hash, len);
+}
+
+/**
+ * @brief Evict one key with the CLOCK algorithm. The hand moves over the
+ * occupied buckets and evicts the first key that was not read since the
+ * hand last passed it, or that has expired. The hand only leaves a bucket
+ * once every key left in it was read, clearing their marks as it goes, so
+ * two turns clear every mark and a key is always found in a table that is
+ * not empty.
+ * 
+ * @param h_table - The hash table to evict from.
+ * @return int - 1 if a key was evicted, 0 if the table is empty.
+ */
+int _HT_evict(HT_Ht* h_table) {
+    size_t total = h_table->capacity + (h_table->old_nodes ? h_table->old_capacity : 0);
+    for (size_t visited = 0; h_table->size && visited <= 2 * total; visited++) {
+        if (h_table->clock_hand >= total)
+            h_table->clock_hand = 0;
+        int old = h_table->clock_hand >= h_table->capacity;
+        HT_Node** nodes = old ? h_table->old_nodes : h_table->nodes;
+        uint64_t* bitmap = old ? h_table->old_occupied : h_table->occupied;
+        size_t size = old ? h_table->old_capacity : h_table->capacity;
+        size_t base = old ? h_table->capacity : 0;
+        size_t index = _HT_next_occupied(bitmap, size, h_table->clock_hand - base);
+        if (index >= size) {
+            h_table->clock_hand = base + size;
+            continue;
+        }
+        for (HT_Node** link = &(nodes[index]); *link; link = &((*link)->next)) {
+            if (!(*link)->referenced || _HT_expired(h_table, *link)) {
+                _HT_delete(h_table, link, &(nodes[index]));
+                HT_COUNT(h_table, evictions, 1);
+                h_table->clock_hand = base + index; // The bucket may hold other victims.
+                return 1;
+            }
+        }
+        // Every key of the bucket was read since the last pass.
+        for (HT_Node* node = nodes[index]; node; node = node->next)
+            node->referenced = 0;
+        h_table->clock_hand = base + index + 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Determine whether a table in cache mode would exceed its limits.
+ * 
+ * @param h_table - The hash table to check.
+ * @param bytes - The bytes of a key about to be added, or 0.
+ * @return int - 1 if the table is over its limits, 0 otherwise.
+ */
+int _HT_over_limit(HT_Ht* h_table, size_t bytes) {
+    size_t entries = h_table->size + (bytes != 0);
+    return (h_table->max_entries && entries > h_table->max_entries)
+        || (h_table->max_bytes && h_table->bytes + bytes > h_table->max_bytes);
+}
+
+/**
+ * @brief Evict keys until a table in cache mode is within its limits. No
+ * key is evicted while an iterator has paused the table, since it may
+ * hold the next node of the walk.
+ * 
+ * @param h_table - The hash table to evict from.
+ * @param bytes - The bytes of a key about to be added, or 0.
+ */
+void _HT_make_room(HT_Ht* h_table, size_t bytes) {
+    if (h_table->paused) return;
+    while (_HT_over_limit(h_table, bytes)) {
+        if (!_HT_evict(h_table)) return;
+    }
+}
+
+/**
+ * @brief Helper function to search a linked list of nodes
+ * within a bucket of the hash table to find whether or not
+ * the provided value exists.
+ * 
+ * @param node - The root node of the linked list of nodes
+ * to search.
+ * @param key - The key to search within the provided linked list. 
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return int - 0 if not found, 1 if found.
+ */
+int _HT_check(HT_Node* node, const void* key, uint64_t hash, size_t len) {
+    for (; node; node = node->next) {
+        if (_HT_matches(node, key, hash, len))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Determine whether or not the provided key
+ * exists within the hash table. NOTE: The function does
+ * not return the value of the provided key -- only whether
+ * or not it exists.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key of the searched value.
+ * @return int - 0 if not found, 1 if found.
+ */
+int HT_check(HT_Ht* h_table, char* key) {
+    return HT_check_bytes(h_table, key, strlen(key));
+}
+
+/**
+ * @brief Determine whether or not the provided binary key exists within
+ * the hash table. The key may contain null bytes.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @return int - 0 if not found, 1 if found.
+ */
+int HT_check_bytes(HT_Ht* h_table, const void* key, size_t len) {
+    HT_PROF_BEGIN(HT_PROF_CHECK);
+    _HT_rehash_step(h_table);
+    uint64_t hash = _HT_hash_of(h_table, key, len);
+    int found;
+    if (h_table->cache)
+        found = _HT_cache_get(h_table, key, hash, len) != NULL;
+    else
+        found = _HT_check(*_HT_bucket(h_table, hash), key, hash, len);
+    HT_COUNT_LOOKUP(h_table, found);
+    HT_PROF_END(HT_PROF_CHECK);
+    return found;
+}
+
+/**
+ * @brief A helper function to search the provided linked
+ * list of nodes to find the value of a particular key. It is
+ * assumed that the key is present. Use `HT_check` if unsure.
+ * 
+ * @param nodes - Pointer to the root of the linked list
+ * of nodes.
+ * @param key - The key to search.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return int - The value of the provided key.
+ */
+int _HT_find(HT_Node* nodes, const void* key, uint64_t hash, size_t len) {
+    while (!_HT_matches(nodes, key, hash, len))
+        nodes = nodes->next;
+    return nodes->value;
+}
+
+/**
+ * @brief Find the value of a provided key within a linked
+ * list and return it. NOTE: This will segfault if the value does
+ * not exist.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key to compare within the hash table.
+ * @return int - The value of the provided key within the hash
+ * table.
+ */
+int HT_find(HT_Ht* h_table, char* key) {
+    return HT_find_bytes(h_table, key, strlen(key));
+}
+
+/**
+ * @brief Find the value of the provided binary key. NOTE: This will
+ * segfault if the key does not exist, unless the table is in cache mode,
+ * where a missing or expired key gives 0. Use `HT_get_bytes` if unsure.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @return int - The value of the provided key.
+ */
+int HT_find_bytes(HT_Ht* h_table, const void* key, size_t len) {
+    HT_PROF_BEGIN(HT_PROF_FIND);
+    _HT_rehash_step(h_table);
+    uint64_t hash = _HT_hash_of(h_table, key, len);
+    int value;
+    if (h_table->cache) {
+        HT_Node* node = _HT_cache_get(h_table, key, hash, len);
+        HT_COUNT_LOOKUP(h_table, node);
+        value = node ? node->value : 0;
+    } else {
+        HT_COUNT(h_table, hits, 1);
+        value = _HT_find(*_HT_bucket(h_table, hash), key, hash, len);
+    }
+    HT_PROF_END(HT_PROF_FIND);
+    return value;
+}
+
+/**
+ * @brief A helper function to walk through a linked
+ * list of nodes in a bucket and print them out in a
+ * human-readable format.
+ * 
+ * @param node - The root node of the linked list representing
+ * a bucket of the hash table.
+ */
+void _HT_print(HT_Node* node) {
+    for (; node; node = node->next)
+        printf("{\"%.*s\": %d}\n", (int) node->key_len, node->key, node->value);
+}
+
+/**
+ * @brief Print the provided hash table to STDOUT in a human-readable
+ * manner.
+ * 
+ * @param h_table - The table to be printed out.
+ */
+void HT_print(HT_Ht* h_table) {
+    for (size_t x = 0; x < h_table->capacity; x++) {
+        printf("=====BUCKET %zu=====\n",x);
+        if (h_table->nodes[x]) {
+            _HT_print(h_table->nodes[x]);
+        } else {
+            printf("{{{EMPTY}}}\n");
+        }
+    }
+    // Buckets that have not been migrated yet by an ongoing rehash.
+    for (size_t x = h_table->rehash_index; h_table->old_nodes && x < h_table->old_capacity; x++) {
+        if (h_table->old_nodes[x]) {
+            printf("=====OLD BUCKET %zu=====\n",x);
+            _HT_print(h_table->old_nodes[x]);
+        }
+    }
+}
+
+/**
+ * @brief Insert a key whose hash is already known at the head of its
+ * bucket. Tables in cache mode first evict keys to make room for it.
+ * 
+ * @param h_table - The hash table to add to.
+ * @param key - The key to be added.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @param value - The value to be added.
+ * @return HT_Node* - The node of the added key.
+ */
+HT_Node* _HT_insert(HT_Ht* h_table, const void* key, uint64_t hash, size_t len, int value) {
+    if (h_table->cache)
+        _HT_make_room(h_table, _HT_node_bytes(h_table, len));
+    HT_Node** bucket = _HT_bucket(h_table, hash);
+    HT_Node* new_node = _HT_new_node(h_table, bucket, key, len);
+    new_node->hash = hash;
+    new_node->value = value;
+    // We can do this because the values are initialized
+    // to null.
+    new_node->next = *bucket;
+    *bucket = new_node;
+    _HT_sync_bit(h_table, bucket);
+    if (h_table->index)
+        HT_index_insert(h_table->index, new_node);
+    h_table->size++;
+    _HT_check_load(h_table);
+    return new_node;
+}
+
+/**
+ * @brief Add a key-value pair to the provided hash table.
+ * 
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void HT_add(HT_Ht* h_table, char* key, int value) {
+    HT_add_bytes(h_table, key, strlen(key), value);
+}
+
+/**
+ * @brief Add a binary key and its value to the provided hash table.
+ * The key may contain null bytes.
+ * 
+ * @param h_table - The hash table to add to.
+ * @param key - The bytes of the key to be added.
+ * @param len - The length of the key.
+ * @param value - The value to be added.
+ */
+void HT_add_bytes(HT_Ht* h_table, const void* key, size_t len, int value) {
+    HT_PROF_BEGIN(HT_PROF_ADD);
+    _HT_rehash_step(h_table);
+    uint64_t hash = _HT_hash_of(h_table, key, len);
+    _HT_insert(h_table, key, hash, len, value);
+    HT_PROF_END(HT_PROF_ADD);
+}
+
+/**
+ * @brief Add a binary key whose hash is already known, so that callers
+ * hashing keys ahead of time, on another thread for instance, do not pay
+ * for it twice.
+ * 
+ * @param h_table - The hash table to add to.
+ * @param key - The bytes of the key to be added.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key, from the table's own hash function
+ * and seed. Any other hash corrupts the table.
+ * @param value - The value to be added.
+ */
+void HT_add_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int value) {
+    _HT_rehash_step(h_table);
+    _HT_insert(h_table, key, hash, len, value);
+}
+
+/**
+ * @brief Change the value of an entry in the hash
+ * table provided the key. NOTE: This assumes the value
+ * already exists. This will cause errors if it dosen't.
+ * 
+ * @param h_table - The hash table to change.
+ * @param key - The key of the value to change.
+ * @param new_value - The new value to add.
+ */
+void HT_change(HT_Ht* h_table, char* key, int new_value) {
+    HT_PROF_BEGIN(HT_PROF_CHANGE);
+    _HT_rehash_step(h_table);
+    size_t len;
+    uint64_t hash = _HT_hash_len(h_table, key, &len);
+    (*_HT_link(h_table, key, hash, len))->value = new_value;
+    HT_PROF_END(HT_PROF_CHANGE);
+}
+
+/**
+ * @brief Find the value of the provided key in a single lookup. Unlike
+ * `HT_find`, missing keys are safe.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key to search for.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_get(HT_Ht* h_table, char* key, int* out) {
+    return HT_get_bytes(h_table, key, strlen(key), out);
+}
+
+/**
+ * @brief Find the value of the provided binary key in a single lookup.
+ * See `HT_get`.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_get_bytes(HT_Ht* h_table, const void* key, size_t len, int* out) {
+    return HT_get_hashed(h_table, key, len, _HT_hash_of(h_table, key, len), out);
+}
+
+/**
+ * @brief Find the value of a binary key whose hash is already known.
+ * See `HT_get` and `HT_add_hashed`.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key, from the table's own hash function
+ * and seed.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_get_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int* out) {
+    _HT_rehash_step(h_table);
+    HT_Node* node = _HT_live(h_table, key, hash, len);
+    HT_COUNT_LOOKUP(h_table, node);
+    if (!node) return 0;
+    if (out) *out = node->value;
+    return 1;
+}
+
+/**
+ * @brief Find the slot holding the value of the provided key, so it
+ * can be read and written without another lookup. Nodes never move
+ * during rehashes, so the pointer stays valid until the key is removed,
+ * the table is destroyed, or a compaction starts (see `HT_compact_step`),
+ * since compacting copies every node elsewhere. Any later operation may
+ * advance a compaction in progress, so obtain the pointer again after
+ * one may have started.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The key to search for.
+ * @return int* - A pointer to the value of the key, or NULL if not found.
+ */
+int* HT_get_ptr(HT_Ht* h_table, char* key) {
+    size_t len;
+    uint64_t hash = _HT_hash_len(h_table, key, &len);
+    return HT_get_ptr_hashed(h_table, key, len, hash);
+}
+
+/**
+ * @brief Find the slot holding the value of a binary key whose hash is
+ * already known. See `HT_get_ptr` and `HT_add_hashed`, and for how long
+ * the pointer stays valid.
+ * 
+ * @param h_table - The hash table to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key, from the table's own hash function
+ * and seed.
+ * @return int* - A pointer to the value of the key, or NULL if not found.
+ */
+int* HT_get_ptr_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash) {
+    _HT_rehash_step(h_table);
+    HT_Node* node = _HT_live(h_table, key, hash, len);
+    HT_COUNT_LOOKUP(h_table, node);
+    return node ? &(node->value) : NULL;
+}
+
+/**
+ * @brief Set the value of the provided key, adding the key if it does
+ * not exist yet. Unlike `HT_add`, the key is never stored twice.
+ * 
+ * @param h_table - The hash table to change.
+ * @param key - The key to set.
+ * @param value - The value to set.
+ * @return int - 1 if the key was added, 0 if an existing value was replaced.
+ */
+int HT_upsert(HT_Ht* h_table, char* key, int value) {
+    size_t len;
+    uint64_t hash = _HT_hash_len(h_table, key, &len);
+    return HT_upsert_hashed(h_table, key, len, hash, value);
+}
+
+/**
+ * @brief Set the value of a binary key whose hash is already known,
+ * adding the key if it does not exist yet. See `HT_upsert` and
+ * `HT_add_hashed`.
+ * 
+ * @param h_table - The hash table to change.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key, from the table's own hash function
+ * and seed.
+ * @param value - The value to set.
+ * @return int - 1 if the key was added, 0 if an existing value was replaced.
+ */
+int HT_upsert_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int value) {
+    _HT_rehash_step(h_table);
+    HT_Node* node = _HT_live(h_table, key, hash, len);
+    if (node) {
+        node->value = value;
+        return 0;
+    }
+    _HT_insert(h_table, key, hash, len, value);
+    return 1;
+}
+
+/**
+ * @brief Remove a key-value pair from the hash table given
+ * a key. The key's node is unlinked through the link that
+ * points to it, so removing the head of a bucket keeps the
+ * rest of the bucket. Missing keys are safe.
+ * 
+ * @param h_table - The hash table on which the lookup is to
+ * be performed.
+ * @param key - The key of the key-value pair to be deleted. 
+ * @return int - 1 if the key was removed, 0 if it did not exist.
+ */
+int HT_remove(HT_Ht* h_table, char* key) {
+    return HT_remove_bytes(h_table, key, strlen(key));
+}
+
+/**
+ * @brief Remove a binary key and its value from the hash table. See
+ * `HT_remove`.
+ * 
+ * @param h_table - The hash table to remove from.
+ * @param key - The bytes of the key to be removed.
+ * @param len - The length of the key.
+ * @return int - 1 if the key was removed, 0 if it did not exist.
+ */
+int HT_remove_bytes(HT_Ht* h_table, const void* key, size_t len) {
+    HT_PROF_BEGIN(HT_PROF_REMOVE);
+    int removed = HT_remove_hashed(h_table, key, len, _HT_hash_of(h_table, key, len));
+    HT_PROF_END(HT_PROF_REMOVE);
+    return removed;
+}
+
+/**
+ * @brief Remove a binary key whose hash is already known. See
+ * `HT_remove` and `HT_add_hashed`.
+ * 
+ * @param h_table - The hash table to remove from.
+ * @param key - The bytes of the key to be removed.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key, from the table's own hash function
+ * and seed.
+ * @return int - 1 if the key was removed, 0 if it did not exist.
+ */
+int HT_remove_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash) {
+    _HT_rehash_step(h_table);
+    HT_Node** link = _HT_link(h_table, key, hash, len);
+    int removed = *link != NULL;
+    if (removed) {
+        _HT_delete(h_table, link, _HT_bucket(h_table, hash));
+        _HT_check_load(h_table);
+    }
+    return removed;
+}
+
+/**
+ * @brief A helper function to destroy an array
+ * of nodes within a bucket within a hash table.
+ * 
+ * @param h_table - The hash table owning the nodes.
+ * @param bucket - The head of the linked
+ * list of nodes to destroy.
+ */
+void _HT_destroy_nodes(HT_Ht* h_table, HT_Node** bucket) {
+    int in_arena = (_HT_old_storage(h_table, bucket) ? h_table->old_node_arena : h_table->node_arena) != NULL;
+    HT_Node* node = *bucket;
+    while (node) {
+        HT_Node* next = node->next;
+        _HT_drop_key(h_table, node, in_arena); // Free string key.
+        if (!in_arena)
+            free(node);
+        node = next;
+    }
+}
+
+/**
+ * @brief Destroy the provided hash table.
+ * 
+ * @param h_table - The table to destroy.
+ * 
+ */
+void HT_destroy(HT_Ht* h_table) {
+    // Every node and key of a table using arenas lives in the arenas, so
+    // the buckets are only walked to drop references to interned keys, or
+    // to free the nodes a compaction has not moved off the heap yet.
+    if (!h_table->node_arena || h_table->intern || (h_table->compacting == 2 && !h_table->old_node_arena)) {
+        // Free each individual node to account for nodes
+        // having been added. The entire block cannot
+        // simply be removed because of `HT_add`.
+        for (size_t cur = 0; cur < h_table->capacity; cur++) {
+            if (!(h_table->nodes[cur] == NULL)) {
+                // Exists.
+                _HT_destroy_nodes(h_table, &(h_table->nodes[cur]));
+            }
+        }
+        // Buckets below `rehash_index` have already been emptied.
+        for (size_t cur = h_table->rehash_index; h_table->old_nodes && cur < h_table->old_capacity; cur++) {
+            _HT_destroy_nodes(h_table, &(h_table->old_nodes[cur]));
+        }
+    }
+    if (h_table->node_arena) {
+        HT_arena_destroy(h_table->node_arena);
+        HT_arena_destroy(h_table->key_arena);
+    }
+    if (h_table->old_node_arena) {
+        HT_arena_destroy(h_table->old_node_arena);
+        HT_arena_destroy(h_table->old_key_arena);
+    }
+    if (h_table->index)
+        HT_index_destroy(h_table->index);
+    _HT_free_buckets(h_table->old_nodes, h_table->old_capacity, h_table->huge_pages);
+    free(h_table->old_occupied);
+    _HT_free_buckets(h_table->nodes, h_table->capacity, h_table->huge_pages);
+    free(h_table->occupied);
+    free(h_table); // Destroy the struct itself.
+}
+
+/**
+ * @brief Hash a window of keys and prefetch the buckets they belong to.
+ * One rehash step is taken per key beforehand, as the single-key
+ * operations would, so the buckets stay valid until the window is walked.
+ * 
+ * @param h_table - The hash table to search.
+ * @param keys - The keys of the window.
+ * @param count - The amount of keys in the window, at most `HT_BATCH`.
+ * @param hashes - Set to the full hash of each key.
+ * @param lens - Set to the length of each key.
+ * @param buckets - Set to the bucket of each key.
+ */
+void _HT_batch_prepare(HT_Ht* h_table, char** keys, size_t count,
+                       uint64_t* hashes, size_t* lens, HT_Node*** buckets) {
+    for (size_t i = 0; i < count; i++)
+        _HT_rehash_step(h_table);
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = _HT_hash_len(h_table, keys[i], &lens[i]);
+        buckets[i] = _HT_bucket(h_table, hashes[i]);
+        __builtin_prefetch(buckets[i]);
+    }
+    // The bucket heads are in cache by now; fetch the first node of each chain.
+    for (size_t i = 0; i < count; i++) {
+        if (*buckets[i])
+            __builtin_prefetch(*buckets[i]);
+    }
+}
+
+/**
+ * @brief Walk the bucket of a prepared key to find its node.
+ * 
+ * @param bucket - The bucket of the key.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @param len - The length of the key.
+ * @return HT_Node* - The node containing the key, or NULL if not found.
+ */
+HT_Node* _HT_batch_walk(HT_Node** bucket, char* key, uint64_t hash, size_t len) {
+    for (HT_Node* node = *bucket; node; node = node->next) {
+        if (_HT_matches(node, key, hash, len))
+            return node;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the values of many keys at once. Keys are processed in
+ * windows of `HT_BATCH`: every key of a window is hashed and its bucket
+ * prefetched before any chain is walked, so the cache misses of the
+ * window overlap instead of happening one after another.
+ * 
+ * @param h_table - The hash table to search.
+ * @param keys - The keys to search for.
+ * @param values - Set to the value of each key that is found. Entries
+ * of missing keys are left untouched. Expired keys of tables in cache
+ * mode count as missing, and are left for lookups or `HT_sweep` to remove.
+ * @param n - The amount of keys.
+ * @return size_t - The amount of keys that were found.
+ */
+size_t HT_find_batch(HT_Ht* h_table, char** keys, int* values, size_t n) {
+    uint64_t hashes[HT_BATCH];
+    size_t lens[HT_BATCH];
+    HT_Node** buckets[HT_BATCH];
+    size_t found = 0;
+    for (size_t start = 0; start < n; start += HT_BATCH) {
+        size_t count = n - start < HT_BATCH ? n - start : HT_BATCH;
+        _HT_batch_prepare(h_table, keys + start, count, hashes, lens, buckets);
+        for (size_t i = 0; i < count; i++) {
+            HT_Node* node = _HT_batch_walk(buckets[i], keys[start + i], hashes[i], lens[i]);
+            if (node && !_HT_expired(h_table, node)) {
+                if (h_table->cache && !node->referenced)
+                    node->referenced = 1;
+                values[start + i] = node->value;
+                found++;
+            }
+        }
+    }
+    HT_COUNT(h_table, hits, found);
+    HT_COUNT(h_table, misses, n - found);
+    return found;
+}
+
+/**
+ * @brief Determine whether or not many keys exist within the hash
+ * table at once. See `HT_find_batch`.
+ * 
+ * @param h_table - The hash table to search.
+ * @param keys - The keys to search for.
+ * @param results - Set to 1 for each key that exists, 0 otherwise.
+ * @param n - The amount of keys.
+ * @return size_t - The amount of keys that exist.
+ */
+size_t HT_check_batch(HT_Ht* h_table, char** keys, int* results, size_t n) {
+    uint64_t hashes[HT_BATCH];
+    size_t lens[HT_BATCH];
+    HT_Node** buckets[HT_BATCH];
+    size_t found = 0;
+    for (size_t start = 0; start < n; start += HT_BATCH) {
+        size_t count = n - start < HT_BATCH ? n - start : HT_BATCH;
+        _HT_batch_prepare(h_table, keys + start, count, hashes, lens, buckets);
+        for (size_t i = 0; i < count; i++) {
+            HT_Node* node = _HT_batch_walk(buckets[i], keys[start + i], hashes[i], lens[i]);
+            results[start + i] = node && !_HT_expired(h_table, node);
+            found += results[start + i];
+        }
+    }
+    HT_COUNT(h_table, hits, found);
+    HT_COUNT(h_table, misses, n - found);
+    return found;
+}
+
+/**
+ * @brief Add many key-value pairs at once. The buckets of a window are
+ * prefetched as in `HT_find_batch`, and each bucket is looked up again
+ * right before inserting since an insert may start a rehash.
+ * 
+ * @param h_table - The hash table to add to.
+ * @param keys - The keys to be added.
+ * @param values - The value of each key.
+ * @param n - The amount of keys.
+ */
+void HT_add_batch(HT_Ht* h_table, char** keys, int* values, size_t n) {
+    uint64_t hashes[HT_BATCH];
+    size_t lens[HT_BATCH];
+    HT_Node** buckets[HT_BATCH];
+    for (size_t start = 0; start < n; start += HT_BATCH) {
+        size_t count = n - start < HT_BATCH ? n - start : HT_BATCH;
+        _HT_batch_prepare(h_table, keys + start, count, hashes, lens, buckets);
+        for (size_t i = 0; i < count; i++)
+            _HT_insert(h_table, keys[start + i], hashes[i], lens[i], values[start + i]);
+    }
+}
+
+/**
+ * @brief Start walking every key of the provided hash table. Empty
+ * buckets are skipped through the occupancy bitmap. Rehashing is paused
+ * until `HT_iter_release`, so the table may be searched, changed and
+ * even added to or removed from while it is walked: keys present for the
+ * whole walk are returned exactly once, and keys added meanwhile may or
+ * may not be. Only the node returned last may be removed.
+ * 
+ * @param h_table - The hash table to walk.
+ * @param iter - The iterator to initialize.
+ */
+void HT_iter_init(HT_Ht* h_table, HT_Iter* iter) {
+    iter->table = h_table;
+    iter->old = 0;
+    iter->index = 0;
+    iter->next = NULL;
+    h_table->paused++;
+}
+
+/**
+ * @brief Return the next node of a walk started with `HT_iter_init`.
+ * Buckets of the new array are visited first, then the buckets of the
+ * old array that an ongoing rehash has not migrated yet.
+ * 
+ * @param iter - The iterator to advance.
+ * @return HT_Node* - The next node, or NULL once every key was returned.
+ */
+HT_Node* HT_iter_next(HT_Iter* iter) {
+    HT_Ht* h_table = iter->table;
+    while (!iter->next) {
+        if (!iter->old) {
+            iter->index = _HT_next_occupied(h_table->occupied, h_table->capacity, iter->index);
+            if (iter->index < h_table->capacity) {
+                iter->next = h_table->nodes[iter->index++];
+                continue;
+            }
+            iter->old = 1;
+            iter->index = h_table->rehash_index;
+        }
+        if (!h_table->old_nodes) return NULL;
+        iter->index = _HT_next_occupied(h_table->old_occupied, h_table->old_capacity, iter->index);
+        if (iter->index >= h_table->old_capacity) return NULL;
+        iter->next = h_table->old_nodes[iter->index++];
+    }
+    HT_Node* node = iter->next;
+    // Read ahead so the returned node may be removed.
+    iter->next = node->next;
+    return node;
+}
+
+/**
+ * @brief Finish a walk started with `HT_iter_init`, whether or not every
+ * key was returned, and let rehashing resume.
+ * 
+ * @param iter - The iterator to release.
+ */
+void HT_iter_release(HT_Iter* iter) {
+    iter->table->paused--;
+}
+
+/**
+ * @brief Reverse the bits of a 64-bit word.
+ */
+uint64_t _HT_reverse_bits(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+    v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+/**
+ * @brief Increment the masked bits of a cursor starting from the high
+ * bit, so the cursor walks buckets in reverse binary order.
+ * 
+ * @param cursor - The cursor to advance.
+ * @param mask - The mask of the buckets being scanned.
+ * @return uint64_t - The advanced cursor.
+ */
+uint64_t _HT_next_cursor(uint64_t cursor, uint64_t mask) {
+    cursor |= ~mask;
+    cursor = _HT_reverse_bits(cursor);
+    cursor++;
+    return _HT_reverse_bits(cursor);
+}
+
+/**
+ * @brief Call the scan function on every node of a bucket. The next node
+ * is read first so the function may remove the node it is given.
+ */
+void _HT_scan_bucket(HT_Node* node, HT_Scan_fn fn, void* data) {
+    while (node) {
+        HT_Node* next = node->next;
+        fn(node, data);
+        node = next;
+    }
+}
+
+/**
+ * @brief Visit the next bucket of a resumable scan over the table. Each
+ * call handles a single bucket, so sweeps can be spread over time, and
+ * the table may be freely changed and resized between calls: every key
+ * present for the whole scan is visited at least once (keys may be
+ * visited twice if the table shrinks). Like Redis `SCAN`, the cursor
+ * counts buckets in reverse binary order so that growing or shrinking
+ * the table never moves a key to a bucket the scan has already passed.
+ * 
+ * @param h_table - The hash table to scan.
+ * @param cursor - 0 to start a scan, then the value returned by the
+ * previous call.
+ * @param fn - The function called on each visited node. It may remove
+ * the node it is given, but must not add keys.
+ * @param data - Passed to every call of `fn`.
+ * @return uint64_t - The cursor of the next call, or 0 once the scan is
+ * complete.
+ */
+uint64_t HT_scan(HT_Ht* h_table, uint64_t cursor, HT_Scan_fn fn, void* data) {
+    h_table->paused++;
+    if (!h_table->old_nodes) {
+        uint64_t mask = h_table->capacity - 1;
+        _HT_scan_bucket(h_table->nodes[cursor & mask], fn, data);
+        cursor = _HT_next_cursor(cursor, mask);
+    } else {
+        // Visit the key's bucket in the smaller array, then every bucket
+        // of the larger array that it expands to.
+        HT_Node** small = h_table->nodes;
+        HT_Node** large = h_table->old_nodes;
+        uint64_t small_mask = h_table->capacity - 1;
+        uint64_t large_mask = h_table->old_capacity - 1;
+        if (small_mask > large_mask) {
+            small = h_table->old_nodes;
+            large = h_table->nodes;
+            small_mask = h_table->old_capacity - 1;
+            large_mask = h_table->capacity - 1;
+        }
+        _HT_scan_bucket(small[cursor & small_mask], fn, data);
+        do {
+            _HT_scan_bucket(large[cursor & large_mask], fn, data);
+            cursor = _HT_next_cursor(cursor, large_mask);
+        } while (cursor & (small_mask ^ large_mask));
+    }
+    h_table->paused--;
+    return cursor;
+}
+
+/**
+ * @brief Build a hash table from many key-value pairs at once. The
+ * capacity is picked from the amount of keys, every key is hashed in a
+ * single pass, and the keys are then sorted by bucket with a counting
+ * sort so that their nodes are laid out in one block, bucket after
+ * bucket: walking a chain reads consecutive memory. The table uses
+ * arenas (see `HT_use_arena`), and behaves as if each pair had been added
+ * with `HT_add` in order, duplicates included.
+ * 
+ * @param keys - The keys to add.
+ * @param values - The value of each key.
+ * @param n - The amount of keys.
+ * @return HT_Ht* - The built table.
+ */
+HT_Ht* HT_build(char** keys, int* values, size_t n) {
+    HT_Ht* h_table = HT_create(n / HT_GROW_LOAD);
+    HT_use_arena(h_table);
+    if (!n) return h_table;
+    size_t mask = h_table->capacity - 1;
+    uint64_t* hashes = malloc(sizeof(uint64_t) * n);
+    size_t* lens = malloc(sizeof(size_t) * n);
+    size_t* starts = calloc(h_table->capacity + 1, sizeof(size_t));
+    size_t key_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = _HT_hash_len(h_table, keys[i], &lens[i]);
+        starts[(hashes[i] & mask) + 1]++;
+        if (lens[i] >= HT_INLINE_KEY)
+            key_bytes += lens[i] + 1;
+    }
+    for (size_t x = 0; x < h_table->capacity; x++)
+        starts[x + 1] += starts[x];
+    HT_Node* block = HT_arena_alloc(h_table->node_arena, sizeof(HT_Node) * n, _Alignof(HT_Node));
+    unsigned char* key_block = key_bytes ? HT_arena_alloc(h_table->key_arena, key_bytes, 1) : NULL;
+    // Later keys are placed first within their bucket, as `HT_add`
+    // would have put them at the head of the chain.
+    for (size_t i = n; i-- > 0;) {
+        HT_Node* node = &(block[starts[hashes[i] & mask]++]);
+        if (lens[i] < HT_INLINE_KEY) {
+            node->key = node->inline_key;
+        } else {
+            node->key = key_block;
+            key_block += lens[i] + 1;
+        }
+        memcpy(node->key, keys[i], lens[i] + 1);
+        node->hash = hashes[i];
+        node->key_len = lens[i];
+        node->value = values[i];
+        node->expires = 0;
+        node->referenced = 0;
+        h_table->bytes += _HT_node_bytes(h_table, lens[i]);
+    }
+    // Every bucket's cursor now points at the start of the next bucket.
+    for (size_t x = 0, start = 0; x < h_table->capacity; start = starts[x++]) {
+        if (start == starts[x]) continue;
+        for (size_t i = start; i + 1 < starts[x]; i++)
+            block[i].next = &(block[i + 1]);
+        block[starts[x] - 1].next = NULL;
+        h_table->nodes[x] = &(block[start]);
+        h_table->occupied[x >> 6] |= 1ull << (x & 63);
+    }
+    h_table->size = n;
+    free(hashes);
+    free(lens);
+    free(starts);
+    return h_table;
+}
+
+/**
+ * @brief Advance the compaction of the provided hash table by a bounded
+ * amount of work, starting one if none is in progress. A compaction first
+ * shrinks the array of buckets to the smallest capacity holding every key
+ * (but never below the capacity the table was created with), then
+ * rehashes it into an array of the same capacity, copying each chain's
+ * nodes and keys one after the other into fresh arenas, in bucket order.
+ * Walking a chain then reads consecutive memory again, as after
+ * `HT_build`. Both phases are incremental rehashes: operations on the
+ * table keep working, and advance them too, between steps. The table
+ * uses arenas from then on. Does nothing while rehashing is paused. The
+ * compaction is abandoned if an array of buckets cannot be allocated.
+ * Nodes are moved, so pointers from `HT_get_ptr` taken before the
+ * compaction started are invalid once any operation advances it.
+ * 
+ * @param h_table - The hash table to compact.
+ * @param buckets - The most buckets to migrate during this step.
+ * @return int - 1 while the compaction is in progress, 0 once it is done
+ * or abandoned.
+ */
+int HT_compact_step(HT_Ht* h_table, size_t buckets) {
+    if (h_table->paused) return h_table->compacting != 0;
+    if (!h_table->compacting)
+        h_table->compacting = 1;
+    while (buckets && h_table->compacting) {
+        if (h_table->old_nodes) {
+            // Any ongoing rehash is finished first.
+            size_t amount = h_table->old_capacity - h_table->rehash_index;
+            if (amount > buckets) amount = buckets;
+            _HT_rehash_buckets(h_table, amount);
+            buckets -= amount;
+            continue;
+        }
+        size_t capacity = 1;
+        while (capacity < h_table->size / HT_GROW_LOAD || capacity < h_table->min_capacity)
+            capacity *= 2;
+        if (capacity < h_table->capacity) {
+            if (!_HT_start_rehash(h_table, capacity))
+                h_table->compacting = 0;
+        } else if (!_HT_start_rehash(h_table, h_table->capacity)) {
+            h_table->compacting = 0;
+        } else {
+            h_table->old_node_arena = h_table->node_arena;
+            h_table->old_key_arena = h_table->key_arena;
+            h_table->node_arena = HT_arena_create();
+            h_table->key_arena = HT_arena_create();
+            h_table->free_nodes = NULL; // They live in the old arena.
+            h_table->compacting = 2;
+        }
+    }
+    return h_table->compacting != 0;
+}
+
+/**
+ * @brief Compact the provided hash table at once. See `HT_compact_step`.
+ * Every pointer from `HT_get_ptr` is invalid afterwards.
+ * 
+ * @param h_table - The hash table to compact.
+ * @return int - 1 if the table was compacted, 0 if rehashing is paused.
+ */
+int HT_compact(HT_Ht* h_table) {
+    if (h_table->paused) return 0;
+    while (HT_compact_step(h_table, UINT_MAX));
+    return 1;
+}
+
+/**
+ * @brief Add the chains of an array of buckets to a summary of the table.
+ * 
+ * @param out - The summary to add to.
+ * @param nodes - The buckets.
+ * @param from - The first bucket to count.
+ * @param capacity - The amount of buckets.
+ * @param probes - Incremented by the amount of nodes read to find each key.
+ * @param key_bytes - Incremented by the bytes of keys stored outside their node.
+ */
+void _HT_stats_buckets(HT_Stats* out, HT_Node** nodes, size_t from, size_t capacity,
+                       size_t* probes, size_t* key_bytes) {
+    for (size_t x = from; x < capacity; x++) {
+        size_t length = 0;
+        for (HT_Node* node = nodes[x]; node; node = node->next) {
+            length++;
+            *probes += length;
+            if (node->key != node->inline_key)
+                *key_bytes += node->key_len + 1;
+        }
+        out->chains[length < HT_STATS_CHAINS ? length : HT_STATS_CHAINS - 1]++;
+        if (length > out->max_chain) out->max_chain = length;
+    }
+}
+
+/**
+ * @brief Summarize the health of the provided hash table: how full it
+ * is, how long its chains are and how much memory it uses. Every bucket
+ * is walked, so this takes time proportional to the capacity plus the
+ * amount of keys. The operation counters are only maintained when
+ * compiled with `-DHT_STATS_COUNTERS`, and are 0 otherwise.
+ * 
+ * @param h_table - The hash table to summarize.
+ * @param out - Set to the summary.
+ */
+void HT_stats(HT_Ht* h_table, HT_Stats* out) {
+    memset(out, 0, sizeof(HT_Stats));
+    size_t probes = 0, key_bytes = 0;
+    _HT_stats_buckets(out, h_table->nodes, 0, h_table->capacity, &probes, &key_bytes);
+    out->buckets = h_table->capacity;
+    out->bucket_bytes = sizeof(HT_Node*) * h_table->capacity + sizeof(uint64_t) * ((h_table->capacity + 63) / 64);
+    if (h_table->old_nodes) {
+        // Migrated buckets of the old array are empty but still allocated.
+        _HT_stats_buckets(out, h_table->old_nodes, h_table->rehash_index, h_table->old_capacity, &probes, &key_bytes);
+        out->chains[0] += h_table->rehash_index;
+        out->buckets += h_table->old_capacity;
+        out->bucket_bytes += sizeof(HT_Node*) * h_table->old_capacity + sizeof(uint64_t) * ((h_table->old_capacity + 63) / 64);
+        out->rehashing = 1;
+    }
+    out->size = h_table->size;
+    out->load_factor = (double) out->size / out->buckets;
+    out->empty_ratio = (double) out->chains[0] / out->buckets;
+    out->mean_probes = out->size ? (double) probes / out->size : 0;
+    if (h_table->node_arena) {
+        out->node_bytes = h_table->node_arena->reserved;
+        out->key_bytes = h_table->key_arena->reserved;
+        if (h_table->old_node_arena) {
+            out->node_bytes += h_table->old_node_arena->reserved;
+            out->key_bytes += h_table->old_key_arena->reserved;
+        }
+    } else {
+        out->node_bytes = sizeof(HT_Node) * h_table->size;
+        // Borrowed and interned keys belong to someone else.
+        out->key_bytes = h_table->borrow_keys || h_table->intern ? 0 : key_bytes;
+    }
+    out->hits = __atomic_load_n(&(h_table->hits), __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&(h_table->misses), __ATOMIC_RELAXED);
+    out->resizes = __atomic_load_n(&(h_table->resizes), __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&(h_table->evictions), __ATOMIC_RELAXED);
+    out->expirations = __atomic_load_n(&(h_table->expirations), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Read the time spent in each profiled region since the start of
+ * the process or the last `HT_profile_reset`. Regions are only timed when
+ * compiled with `-DHT_PROFILE`, and are 0 otherwise.
+ *
+ * @param out - Set to the `HT_PROF_REGIONS` regions, indexed by region.
+ * May be NULL to only ask whether this build profiles its operations.
+ * @return int - 1 if this build profiles its operations, 0 otherwise.
+ */
+int HT_profile(HT_Profile* out) {
+    if (out) memset(out, 0, sizeof(HT_Profile) * HT_PROF_REGIONS);
+#ifdef HT_PROFILE
+    for (int x = 0; out && x < HT_PROF_REGIONS; x++) {
+        out[x].calls = __atomic_load_n(&(_HT_profile_regions[x].calls), __ATOMIC_RELAXED);
+        out[x].cycles = __atomic_load_n(&(_HT_profile_regions[x].cycles), __ATOMIC_RELAXED);
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Zero the time spent in every profiled region, e.g. between the
+ * phases of a benchmark.
+ */
+void HT_profile_reset(void) {
+#ifdef HT_PROFILE
+    for (int x = 0; x < HT_PROF_REGIONS; x++) {
+        __atomic_store_n(&(_HT_profile_regions[x].calls), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(_HT_profile_regions[x].cycles), 0, __ATOMIC_RELAXED);
+    }
+#endif
+}
+
+/**
+ * @brief The default clock of tables in cache mode: seconds of the
+ * monotonic clock, offset so that it never returns 0.
+ * 
+ * @return uint32_t - The current time in seconds.
+ */
+uint32_t HT_clock_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) now.tv_sec + 1;
+}
+
+/**
+ * @brief Replace the clock that times to live are measured with, e.g. to
+ * share a coarse clock updated once per second, or to control time in
+ * tests. Times to live already set are read against the new clock.
+ * 
+ * @param h_table - The hash table to configure.
+ * @param clock - The clock to use, or NULL for `HT_clock_seconds`.
+ */
+void HT_set_clock(HT_Ht* h_table, HT_Clock_fn clock) {
+    h_table->clock = clock ? clock : HT_clock_seconds;
+}
+
+/**
+ * @brief Turn the provided hash table into a bounded cache. Once a limit
+ * would be exceeded by an insert, keys are evicted with the CLOCK
+ * algorithm: reads only mark the key's node, and a hand sweeping the
+ * buckets evicts keys that were not read since it last passed them.
+ * Expired keys are evicted first when met. Keys already over the limits
+ * are evicted right away.
+ * 
+ * @param h_table - The hash table to configure.
+ * @param max_entries - The most keys the table holds, or 0 for no limit.
+ * @param max_bytes - The most bytes of nodes and keys the table holds,
+ * or 0 for no limit. See `HT_Ht.bytes`.
+ */
+void HT_set_limit(HT_Ht* h_table, size_t max_entries, size_t max_bytes) {
+    h_table->cache = 1;
+    h_table->max_entries = max_entries;
+    h_table->max_bytes = max_bytes;
+    _HT_make_room(h_table, 0);
+}
+
+/**
+ * @brief Find when a key given a time to live expires. Deadlines past the
+ * end of the clock stop at its last second, rather than wrapping around
+ * to a past one, or to 0, which would mean never.
+ * 
+ * @param h_table - The hash table whose clock is used.
+ * @param ttl - Seconds until the key expires, or 0 if it never does.
+ * @return uint32_t - The time the key expires at, or 0 if it never does.
+ */
+uint32_t _HT_expiry(HT_Ht* h_table, uint32_t ttl) {
+    if (!ttl) return 0;
+    uint32_t now = h_table->clock();
+    return ttl > UINT32_MAX - now ? UINT32_MAX : now + ttl;
+}
+
+/**
+ * @brief Set the value and the time to live of the provided key, adding
+ * the key if it does not exist yet. This puts the table in cache mode:
+ * from then on, lookups treat expired keys as missing and remove them.
+ * 
+ * @param h_table - The hash table to change.
+ * @param key - The key to set.
+ * @param value - The value to set.
+ * @param ttl - Seconds until the key expires, or 0 if it never does.
+ * @return int - 1 if the key was added, 0 if an existing value was replaced.
+ */
+int HT_upsert_ttl(HT_Ht* h_table, char* key, int value, uint32_t ttl) {
+    h_table->cache = 1;
+    _HT_rehash_step(h_table);
+    size_t len;
+    uint64_t hash = _HT_hash_len(h_table, key, &len);
+    HT_Node* node = _HT_cache_get(h_table, key, hash, len);
+    int added = !node;
+    if (added)
+        node = _HT_insert(h_table, key, hash, len, value);
+    else
+        node->value = value;
+    node->expires = _HT_expiry(h_table, ttl);
+    return added;
+}
+
+/**
+ * @brief Change the time to live of an existing key. This puts the table
+ * in cache mode, see `HT_upsert_ttl`.
+ * 
+ * @param h_table - The hash table to change.
+ * @param key - The key to change.
+ * @param ttl - Seconds until the key expires, or 0 if it never does.
+ * @return int - 1 if the key was found, 0 if it is missing or expired.
+ */
+int HT_set_ttl(HT_Ht* h_table, char* key, uint32_t ttl) {
+    h_table->cache = 1;
+    _HT_rehash_step(h_table);
+    size_t len;
+    uint64_t hash = _HT_hash_len(h_table, key, &len);
+    HT_Node* node = _HT_cache_get(h_table, key, hash, len);
+    if (!node) return 0;
+    node->expires = _HT_expiry(h_table, ttl);
+    return 1;
+}
+
+/**
+ * @brief Remove a node visited by `HT_sweep` if it has expired.
+ */
+void _HT_sweep_node(HT_Node* node, void* data) {
+    HT_Ht* h_table = data;
+    if (_HT_expired(h_table, node)) {
+        _HT_unlink(h_table, node);
+        HT_COUNT(h_table, expirations, 1);
+    }
+}
+
+/**
+ * @brief Remove the expired keys of the next bucket of a resumable sweep,
+ * so keys that are never read again still expire. Sweeps are built on
+ * `HT_scan`, with the same cursor: calling this from time to time, e.g.
+ * a few buckets per insert or on a timer, spreads the cost of expiry.
+ * It must not be called while the table is walked by an iterator.
+ * 
+ * @param h_table - The hash table to sweep.
+ * @param cursor - 0 to start a sweep, then the value returned by the
+ * previous call.
+ * @return uint64_t - The cursor of the next call, or 0 once the sweep is
+ * complete.
+ */
+uint64_t HT_sweep(HT_Ht* h_table, uint64_t cursor) {
+    return HT_scan(h_table, cursor, _HT_sweep_node, h_table);
+}
+
+/**
+ * @brief Give the provided hash table an ordered index of its keys, for
+ * `HT_scan_range` and `HT_scan_prefix`. The keys already in the table are
+ * indexed at once, and every later addition and removal keeps the index
+ * in sync, at a cost of O(log n) each. Lookups do not use the index.
+ * 
+ * @param h_table - The hash table to index.
+ */
+void HT_use_index(HT_Ht* h_table) {
+    if (h_table->index) return;
+    h_table->index = HT_index_create();
+    for (size_t x = 0; x < h_table->capacity; x++) {
+        for (HT_Node* node = h_table->nodes[x]; node; node = node->next)
+            HT_index_insert(h_table->index, node);
+    }
+    for (size_t x = h_table->rehash_index; h_table->old_nodes && x < h_table->old_capacity; x++) {
+        for (HT_Node* node = h_table->old_nodes[x]; node; node = node->next)
+            HT_index_insert(h_table->index, node);
+    }
+}
+
+/**
+ * @brief Initializer function for an intern pool. See `HT_use_intern`.
+ * 
+ * @return HT_Intern* - The created pool, empty.
+ */
+HT_Intern* HT_intern_create(void) {
+    HT_Intern* pool = malloc(sizeof(HT_Intern));
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->keys = HT_create(64);
+    return pool;
+}
+
+/**
+ * @brief Intern a key directly, to compare keys by address or to hand the
+ * same copy to tables borrowing their keys. Each call takes a reference
+ * that `HT_intern_release` gives back.
+ * 
+ * @param pool - The pool to intern into.
+ * @param key - The key to intern.
+ * @return const char* - The pool's copy of the key.
+ */
+const char* HT_intern(HT_Intern* pool, char* key) {
+    return (const char*) _HT_intern_acquire(pool, key, strlen(key));
+}
+
+/**
+ * @brief Give back a reference taken by `HT_intern`.
+ * 
+ * @param pool - The pool holding the key.
+ * @param key - The key to release.
+ */
+void HT_intern_release(HT_Intern* pool, const char* key) {
+    _HT_intern_drop(pool, key, strlen(key));
+}
+
+/**
+ * @brief Find how many distinct keys the provided pool holds.
+ * 
+ * @param pool - The pool to query.
+ * @return size_t - The amount of keys.
+ */
+size_t HT_intern_size(HT_Intern* pool) {
+    pthread_mutex_lock(&pool->lock);
+    size_t size = pool->keys->size;
+    pthread_mutex_unlock(&pool->lock);
+    return size;
+}
+
+/**
+ * @brief Destroy the provided pool. Every table using it must have been
+ * destroyed first.
+ * 
+ * @param pool - The pool to destroy.
+ */
+void HT_intern_destroy(HT_Intern* pool) {
+    HT_destroy(pool->keys);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
 }
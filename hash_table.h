@@ -9,26 +9,264 @@
  * 
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * A hash function over `len` bytes of `key`. Every call made by a
+ * table passes that table's seed.
+ */
+typedef uint64_t (*HT_Hash_fn)(const void* key, size_t len, uint64_t seed);
+
+/**
+ * A clock giving the current time in seconds, used to expire the keys of
+ * tables in cache mode. It must never return 0.
+ */
+typedef uint32_t (*HT_Clock_fn)(void);
+
+// Arrays of buckets of at least this many bytes are mapped on their own,
+// with the length rounded up to whole huge pages. See `HT_use_huge_pages`.
+#define HT_HUGE_PAGE ((size_t) 2 << 20)
+// The largest huge pages of x86-64 and ARM64.
+#define HT_HUGE_PAGE_1G ((size_t) 1 << 30)
+
+// The largest power of two of buckets whose array size_t can measure.
+// Capacities stop doubling there, whatever size is asked for.
+#define HT_MAX_CAPACITY ((SIZE_MAX / 2 + 1) / sizeof(void*))
+
+// Keys shorter than this many bytes are stored inside their node. This
+// fills the node up to 64 bytes.
+#define HT_INLINE_KEY 23
+
 struct HT_node {
     struct HT_node * next;
-    unsigned char* key;
+    unsigned char* key; // Points to `inline_key` for short keys.
+    uint64_t hash; // Full hash of the key, so it never has to be rehashed.
+    size_t key_len; // Length of the key, excluding the null character.
     int value;
+    uint32_t expires; // Time of the clock at which the key expires, 0 if it never does.
+    unsigned char referenced; // Set when the key is read, cleared as the eviction hand passes.
+    // Storage for short keys, so they need no allocation of their own and
+    // are compared without leaving the node's cache line.
+    unsigned char inline_key[HT_INLINE_KEY];
 };
 
 struct HT_ht {
-    unsigned int capacity;
+    size_t capacity; // Always a power of two.
     struct HT_node ** nodes;
+    size_t size; // The amount of keys within the table.
+    size_t min_capacity; // The table never shrinks below this capacity.
+    int shrink; // Whether the table may shrink when keys are removed.
+    // Incremental rehashing state. `old_nodes` is NULL unless the table
+    // is being migrated from `old_nodes` to `nodes`, in which case every
+    // bucket of `old_nodes` below `rehash_index` has already been moved.
+    size_t old_capacity;
+    struct HT_node ** old_nodes;
+    size_t rehash_index;
+    // The size of the reserved huge pages (`MAP_HUGETLB`) that large arrays
+    // of buckets are mapped with, or 0 to only advise transparent huge pages.
+    size_t huge_pages;
+    // Whether large arrays of buckets are interleaved over the NUMA nodes.
+    int interleave;
+    HT_Hash_fn hash_fn;
+    uint64_t seed;
+    // Arenas the nodes and keys are carved from. NULL unless `HT_use_arena`
+    // was called, in which case removed nodes wait in `free_nodes` for reuse.
+    struct HT_arena * node_arena;
+    struct HT_arena * key_arena;
+    struct HT_node * free_nodes;
+    // Compaction state, see `HT_compact_step`: 0 if none is in progress, 1
+    // while the buckets are shrunk to fit, 2 while the nodes are copied out
+    // of the old arenas, or off the heap if they are NULL.
+    int compacting;
+    struct HT_arena * old_node_arena;
+    struct HT_arena * old_key_arena;
+    // Ordered index of the nodes, kept in sync by every addition and
+    // removal. NULL unless `HT_use_index` was called.
+    struct HT_index * index;
+    // Where keys too long to be inlined live. The table copies them unless
+    // `HT_borrow_keys` made it keep the caller's pointers, or `HT_use_intern`
+    // made it share them through a pool.
+    int borrow_keys;
+    struct HT_intern * intern;
+    // One bit per bucket of `nodes` and `old_nodes`, set while the bucket
+    // is not empty, so walks over the table skip empty buckets in bulk.
+    uint64_t * occupied;
+    uint64_t * old_occupied;
+    // While non-zero, rehashing neither starts nor advances, so buckets
+    // stay where iterators and scans expect them.
+    unsigned int paused;
+    // Operation counters, only updated when compiled with `-DHT_STATS_COUNTERS`.
+    // They are incremented atomically so another thread may read them.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t resizes;
+    uint64_t evictions;
+    uint64_t expirations;
+    // Cache mode, see `HT_set_limit` and `HT_upsert_ttl`. Keys given a
+    // time to live expire once `clock` reaches it, and a CLOCK hand evicts
+    // keys not read since it last passed them to stay within the limits.
+    int cache;
+    HT_Clock_fn clock;
+    size_t max_entries; // 0 if the amount of keys is unbounded.
+    size_t max_bytes; // 0 if the bytes of the keys are unbounded.
+    size_t bytes; // Bytes of the nodes and of the keys they own outside them.
+    // The next bucket the eviction hand visits. Buckets past `capacity`
+    // are those of the old array of an ongoing rehash.
+    size_t clock_hand;
+};
+
+/**
+ * A pool of keys shared by several tables, so that a key added to many of
+ * them is stored once. See `HT_use_intern`.
+ */
+struct HT_intern {
+    // Taken by every access to `keys`, since the tables sharing the pool
+    // may be changed, and versions retired, on different threads.
+    pthread_mutex_t lock;
+    struct HT_ht * keys; // Maps each key to the amount of its users.
+};
+
+// The amount of entries of the chain-length histogram of `HT_stats`.
+#define HT_STATS_CHAINS 16
+
+/**
+ * A summary of the health of a table. See `HT_stats`.
+ */
+struct HT_stats {
+    size_t size; // The amount of keys.
+    size_t buckets; // The amount of buckets, including those of an ongoing rehash.
+    double load_factor; // Keys per bucket.
+    double empty_ratio; // The share of buckets holding no key.
+    // `chains[i]` counts the buckets holding `i` keys. The last entry
+    // counts every longer chain as well.
+    size_t chains[HT_STATS_CHAINS];
+    size_t max_chain;
+    double mean_probes; // The mean amount of nodes read by a lookup that finds its key.
+    int rehashing; // Whether an incremental rehash is in progress.
+    size_t node_bytes; // Bytes of the nodes, or reserved by their arena.
+    size_t key_bytes; // Bytes of keys stored outside their node, or reserved by their arena.
+    size_t bucket_bytes; // Bytes of the arrays of buckets and their bitmaps.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t resizes;
+    uint64_t evictions; // Keys removed to stay within the limits of cache mode.
+    uint64_t expirations; // Keys removed once their time to live ran out.
+};
+
+/**
+ * A position within a walk over every key of a table. See `HT_iter_init`.
+ */
+struct HT_iter {
+    struct HT_ht * table;
+    int old; // Whether `index` is a bucket of the old array of buckets.
+    size_t index; // The next bucket to visit.
+    struct HT_node * next; // The next node to return.
+};
+
+/**
+ * The regions timed by builds compiled with `-DHT_PROFILE`. See `HT_profile`.
+ * The hashing and allocation regions are also part of the operation
+ * calling them.
+ */
+enum HT_prof_region {
+    HT_PROF_ADD,
+    HT_PROF_FIND,
+    HT_PROF_CHECK,
+    HT_PROF_REMOVE,
+    HT_PROF_CHANGE,
+    HT_PROF_HASH, // Every call of the table's hash function.
+    HT_PROF_ALLOC, // Taking and giving back nodes and their keys.
+    HT_PROF_REGIONS
+};
+
+/**
+ * The time spent in one profiled region, summed over every table.
+ */
+struct HT_profile {
+    uint64_t calls;
+    uint64_t cycles; // Time stamp counter ticks, or nanoseconds where there is none.
 };
 
 typedef struct HT_node HT_Node;
 typedef struct HT_ht HT_Ht;
+typedef struct HT_iter HT_Iter;
+typedef struct HT_stats HT_Stats;
+typedef struct HT_intern HT_Intern;
+typedef struct HT_profile HT_Profile;
+
+/**
+ * A function called by `HT_scan` on each node it visits, along with the
+ * data given to `HT_scan`.
+ */
+typedef void (*HT_Scan_fn)(HT_Node* node, void* data);
 
 void HT_add(HT_Ht* h_table, char* key, int value);
 int HT_check(HT_Ht* h_table, char* key);
 void HT_print(HT_Ht*);
 int HT_find(HT_Ht* h_table, char* key);
-void HT_remove(HT_Ht* h_table, char* key);
+int HT_remove(HT_Ht* h_table, char* key);
 void HT_change(HT_Ht*, char* key, int value);
 void HT_destroy(HT_Ht* h_table);
-unsigned int HT_hash(char* key, int size);
-HT_Ht* HT_create(unsigned int size);
+int HT_get(HT_Ht* h_table, char* key, int* out);
+int* HT_get_ptr(HT_Ht* h_table, char* key);
+int HT_upsert(HT_Ht* h_table, char* key, int value);
+size_t HT_find_batch(HT_Ht* h_table, char** keys, int* values, size_t n);
+size_t HT_check_batch(HT_Ht* h_table, char** keys, int* results, size_t n);
+void HT_add_batch(HT_Ht* h_table, char** keys, int* values, size_t n);
+void HT_add_bytes(HT_Ht* h_table, const void* key, size_t len, int value);
+void HT_add_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int value);
+int HT_check_bytes(HT_Ht* h_table, const void* key, size_t len);
+int HT_find_bytes(HT_Ht* h_table, const void* key, size_t len);
+int HT_get_bytes(HT_Ht* h_table, const void* key, size_t len, int* out);
+int HT_remove_bytes(HT_Ht* h_table, const void* key, size_t len);
+int HT_get_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int* out);
+int* HT_get_ptr_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash);
+int HT_upsert_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash, int value);
+int HT_remove_hashed(HT_Ht* h_table, const void* key, size_t len, uint64_t hash);
+void HT_iter_init(HT_Ht* h_table, HT_Iter* iter);
+HT_Node* HT_iter_next(HT_Iter* iter);
+void HT_iter_release(HT_Iter* iter);
+uint64_t HT_scan(HT_Ht* h_table, uint64_t cursor, HT_Scan_fn fn, void* data);
+void HT_stats(HT_Ht* h_table, HT_Stats* out);
+int HT_profile(HT_Profile* out);
+void HT_profile_reset(void);
+void HT_set_limit(HT_Ht* h_table, size_t max_entries, size_t max_bytes);
+void HT_set_clock(HT_Ht* h_table, HT_Clock_fn clock);
+uint32_t HT_clock_seconds(void);
+int HT_upsert_ttl(HT_Ht* h_table, char* key, int value, uint32_t ttl);
+int HT_set_ttl(HT_Ht* h_table, char* key, uint32_t ttl);
+uint64_t HT_sweep(HT_Ht* h_table, uint64_t cursor);
+uint64_t HT_hash(char* key, size_t size);
+uint64_t HT_hash_key(char* key);
+uint64_t HT_hash_bytes(const void* key, size_t len, uint64_t seed);
+uint64_t HT_hash_kr(const void* key, size_t len, uint64_t seed);
+uint64_t HT_random_seed(void);
+HT_Ht* HT_create(size_t size);
+HT_Ht* HT_build(char** keys, int* values, size_t n);
+HT_Ht* HT_build_parallel(char** keys, int* values, size_t n, unsigned int threads);
+int HT_resize_parallel(HT_Ht* h_table, size_t size, unsigned int threads);
+void HT_set_shrink(HT_Ht* h_table, int enabled);
+int HT_use_huge_pages(HT_Ht* h_table, size_t page_size);
+int HT_use_interleave(HT_Ht* h_table);
+int HT_set_hash(HT_Ht* h_table, HT_Hash_fn hash_fn, uint64_t seed);
+int HT_use_arena(HT_Ht* h_table);
+int HT_compact(HT_Ht* h_table);
+void HT_use_index(HT_Ht* h_table);
+int HT_compact_step(HT_Ht* h_table, size_t buckets);
+int HT_borrow_keys(HT_Ht* h_table);
+int HT_use_intern(HT_Ht* h_table, HT_Intern* pool);
+HT_Intern* HT_intern_create(void);
+const char* HT_intern(HT_Intern* pool, char* key);
+void HT_intern_release(HT_Intern* pool, const char* key);
+size_t HT_intern_size(HT_Intern* pool);
+void HT_intern_destroy(HT_Intern* pool);
+
+// Arrays of buckets, shared with the parallel rehash of `parallel.c`.
+HT_Node** _HT_new_buckets(size_t size, size_t huge_pages, int interleave);
+void _HT_free_buckets(HT_Node** nodes, size_t size, size_t huge_pages);
+size_t _HT_page_size(size_t bytes, size_t huge_pages);
+
+// Expiry of nodes, shared with the range scans of `ordered_index.c`.
+int _HT_expired(HT_Ht* h_table, HT_Node* node);
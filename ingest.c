@@ -0,0 +1,335 @@
+/**
+ * @file ingest.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A streaming loader for sharded tables. Records are pushed in
+ * chunks and flow through two stages of workers: hashing workers hash
+ * each key once and sort the chunk's records by shard, and inserting
+ * workers, each owning a range of shards no other worker of the load
+ * writes to, add them to the table with the hashes already computed.
+ * They still take the shards' locks, so other threads may use the table
+ * during the load. Bounded queues separate the stages, so a fast
+ * producer waits instead of buffering without end.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "hash_table.h"
+#include "sharded_table.h"
+#include "ingest.h"
+
+/**
+ * @brief Initialize an empty queue.
+ *
+ * @param queue - The queue to initialize.
+ * @param capacity - The amount of items the queue holds before pushes block.
+ */
+void _HT_queue_init(HT_Queue* queue, size_t capacity) {
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->capacity = capacity ? capacity : 1;
+    queue->items = malloc(sizeof(void*) * queue->capacity);
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+}
+
+/**
+ * @brief Add an item at the back of a queue, waiting for room if it is full.
+ *
+ * @param queue - The queue to push to.
+ * @param item - The item to push.
+ */
+void _HT_queue_push(HT_Queue* queue, void* item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    queue->items[(queue->head + queue->count++) % queue->capacity] = item;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Take the item at the front of a queue, waiting for one if it is
+ * empty.
+ *
+ * @param queue - The queue to pop from.
+ * @return void* - The item, or NULL once the queue is closed and empty.
+ */
+void* _HT_queue_pop(HT_Queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->count && !queue->closed)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    void* item = NULL;
+    if (queue->count) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+/**
+ * @brief Close a queue once nothing more will be pushed to it, waking the
+ * workers waiting on it so they can drain it and stop.
+ *
+ * @param queue - The queue to close.
+ */
+void _HT_queue_close(HT_Queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Free the resources of an empty queue.
+ *
+ * @param queue - The queue to free.
+ */
+void _HT_queue_free(HT_Queue* queue) {
+    free(queue->items);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+/**
+ * @brief Find the shard of a key from its hash, as `HT_sharded_add` would.
+ *
+ * @param s_table - The table the key is for.
+ * @param hash - The hash of the key.
+ * @return size_t - The index of the key's shard.
+ */
+size_t _HT_ingest_shard(HT_Sharded* s_table, uint64_t hash) {
+    return s_table->shard_bits ? hash >> (64 - s_table->shard_bits) : 0;
+}
+
+/**
+ * @brief Free a chunk once all of its records have been inserted.
+ *
+ * @param chunk - The chunk to free.
+ */
+void _HT_ingest_free_chunk(HT_Ingest_chunk* chunk) {
+    free(chunk->blob);
+    free(chunk->offsets);
+    free(chunk->lens);
+    free(chunk->values);
+    free(chunk->hashes);
+    free(chunk->order);
+    free(chunk);
+}
+
+/**
+ * @brief Insert a batch of records. The records of each shard are in a
+ * single run, so every shard's lock is taken once per batch. The lock
+ * only contends with threads using the table outside of the load.
+ *
+ * @param ingest - The load the batch is part of.
+ * @param batch - The batch to insert, freed along the way.
+ */
+void _HT_ingest_insert(HT_Ingest* ingest, HT_Ingest_batch* batch) {
+    HT_Sharded* s_table = ingest->table;
+    HT_Ingest_chunk* chunk = batch->chunk;
+    size_t i = 0;
+    while (i < batch->n) {
+        size_t index = _HT_ingest_shard(s_table, chunk->hashes[batch->records[i]]);
+        HT_Shard* shard = &(s_table->shards[index]);
+        pthread_mutex_lock(&shard->lock);
+        for (; i < batch->n && _HT_ingest_shard(s_table, chunk->hashes[batch->records[i]]) == index; i++) {
+            size_t r = batch->records[i];
+            HT_add_hashed(shard->table, chunk->blob + chunk->offsets[r], chunk->lens[r],
+                          chunk->hashes[r], chunk->values[r]);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    atomic_fetch_add(&ingest->inserted, batch->n);
+    if (atomic_fetch_sub(&chunk->pending, 1) == 1)
+        _HT_ingest_free_chunk(chunk);
+    free(batch);
+}
+
+/**
+ * @brief Hash the keys of a chunk and hand its records to the inserting
+ * workers. A counting sort groups the records by shard, keeping the order
+ * of the chunk within each shard, so duplicates of a key are added in the
+ * order they were pushed.
+ *
+ * @param ingest - The load the chunk is part of.
+ * @param chunk - The chunk to hash.
+ */
+void _HT_ingest_hash(HT_Ingest* ingest, HT_Ingest_chunk* chunk) {
+    HT_Sharded* s_table = ingest->table;
+    size_t shards = (size_t) 1 << s_table->shard_bits;
+    unsigned int workers = ingest->insert_threads ? ingest->insert_threads : 1;
+    size_t* starts = calloc(shards + 1, sizeof(size_t));
+    for (size_t i = 0; i < chunk->n; i++) {
+        chunk->hashes[i] = HT_hash_bytes(chunk->blob + chunk->offsets[i], chunk->lens[i], s_table->seed);
+        starts[_HT_ingest_shard(s_table, chunk->hashes[i]) + 1]++;
+    }
+    for (size_t x = 0; x < shards; x++)
+        starts[x + 1] += starts[x];
+    // Worker `w` owns shards `w * shards / workers` up to the next worker's.
+    size_t* bounds = malloc(sizeof(size_t) * (workers + 1));
+    for (unsigned int w = 0; w <= workers; w++)
+        bounds[w] = starts[w * shards / workers];
+    for (size_t i = 0; i < chunk->n; i++)
+        chunk->order[starts[_HT_ingest_shard(s_table, chunk->hashes[i])]++] = i;
+    unsigned int batches = 0;
+    for (unsigned int w = 0; w < workers; w++)
+        batches += bounds[w] < bounds[w + 1];
+    // Set before any batch is handed out, since the last one frees the chunk.
+    atomic_init(&chunk->pending, batches);
+    for (unsigned int w = 0; w < workers; w++) {
+        if (bounds[w] == bounds[w + 1]) continue;
+        HT_Ingest_batch* batch = malloc(sizeof(HT_Ingest_batch));
+        batch->chunk = chunk;
+        batch->n = bounds[w + 1] - bounds[w];
+        batch->records = chunk->order + bounds[w];
+        if (ingest->insert_threads)
+            _HT_queue_push(&ingest->inserters[w].batches, batch);
+        else
+            _HT_ingest_insert(ingest, batch);
+    }
+    free(bounds);
+    free(starts);
+}
+
+/**
+ * @brief Main loop of a hashing worker.
+ */
+void* _HT_ingest_hasher(void* arg) {
+    HT_Ingest* ingest = arg;
+    HT_Ingest_chunk* chunk;
+    while ((chunk = _HT_queue_pop(&ingest->chunks)))
+        _HT_ingest_hash(ingest, chunk);
+    return NULL;
+}
+
+/**
+ * @brief Main loop of an inserting worker.
+ */
+void* _HT_ingest_inserter(void* arg) {
+    HT_Ingest_worker* worker = arg;
+    HT_Ingest_batch* batch;
+    while ((batch = _HT_queue_pop(&worker->batches)))
+        _HT_ingest_insert(worker->ingest, batch);
+    return NULL;
+}
+
+/**
+ * @brief Start loading records into a sharded table. The memory in
+ * flight is bounded: at most `queue_depth` chunks wait for the hashing
+ * workers, one more is held by each of them, and each inserting worker
+ * holds up to `queue_depth` batches, each pinning its chunk, plus the one
+ * it is inserting. Other threads may read and write the table during the
+ * load: the workers lock each shard they insert into, as `HT_sharded_add`
+ * does, and keys added from elsewhere meanwhile are kept.
+ *
+ * @param s_table - The table to load into.
+ * @param hash_threads - The amount of hashing workers.
+ * @param insert_threads - The amount of inserting workers, at most one
+ * per shard.
+ * @param queue_depth - The capacity of each queue between the stages.
+ * @return HT_Ingest* - The load, to push chunks to.
+ */
+HT_Ingest* HT_ingest_create(HT_Sharded* s_table, unsigned int hash_threads,
+                            unsigned int insert_threads, size_t queue_depth) {
+    HT_Ingest* ingest = malloc(sizeof(HT_Ingest));
+    size_t shards = (size_t) 1 << s_table->shard_bits;
+    if (insert_threads > shards) insert_threads = shards;
+    ingest->table = s_table;
+    atomic_init(&ingest->inserted, 0);
+    _HT_queue_init(&ingest->chunks, queue_depth);
+    ingest->inserters = malloc(sizeof(HT_Ingest_worker) * (insert_threads ? insert_threads : 1));
+    ingest->hashers = malloc(sizeof(pthread_t) * (hash_threads ? hash_threads : 1));
+    // Inserting workers start first, since the hashing workers partition
+    // the records over those that did. A worker that cannot be started
+    // leaves its share to the others.
+    ingest->insert_threads = 0;
+    while (ingest->insert_threads < insert_threads) {
+        HT_Ingest_worker* worker = &(ingest->inserters[ingest->insert_threads]);
+        worker->ingest = ingest;
+        _HT_queue_init(&worker->batches, queue_depth);
+        if (pthread_create(&worker->thread, NULL, _HT_ingest_inserter, worker)) {
+            _HT_queue_free(&worker->batches);
+            break;
+        }
+        ingest->insert_threads++;
+    }
+    ingest->hash_threads = 0;
+    while (ingest->hash_threads < hash_threads
+           && !pthread_create(&ingest->hashers[ingest->hash_threads], NULL, _HT_ingest_hasher, ingest))
+        ingest->hash_threads++;
+    return ingest;
+}
+
+/**
+ * @brief Push a chunk of records to be loaded. The keys are copied, so
+ * the caller may reuse its buffers as soon as this returns. Blocks while
+ * the hashing workers are behind.
+ *
+ * @param ingest - The load to push to.
+ * @param keys - The keys of the records.
+ * @param values - The value of each key.
+ * @param n - The amount of records.
+ */
+void HT_ingest_push(HT_Ingest* ingest, char** keys, int* values, size_t n) {
+    if (!n) return;
+    HT_Ingest_chunk* chunk = malloc(sizeof(HT_Ingest_chunk));
+    chunk->n = n;
+    chunk->offsets = malloc(sizeof(size_t) * n);
+    chunk->lens = malloc(sizeof(size_t) * n);
+    chunk->values = malloc(sizeof(int) * n);
+    chunk->hashes = malloc(sizeof(uint64_t) * n);
+    chunk->order = malloc(sizeof(size_t) * n);
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        chunk->lens[i] = strlen(keys[i]);
+        chunk->offsets[i] = bytes;
+        bytes += chunk->lens[i] + 1;
+    }
+    chunk->blob = malloc(bytes);
+    for (size_t i = 0; i < n; i++)
+        memcpy(chunk->blob + chunk->offsets[i], keys[i], chunk->lens[i] + 1);
+    memcpy(chunk->values, values, sizeof(int) * n);
+    if (ingest->hash_threads)
+        _HT_queue_push(&ingest->chunks, chunk);
+    else
+        _HT_ingest_hash(ingest, chunk);
+}
+
+/**
+ * @brief Wait for every pushed record to be inserted, then stop the
+ * workers and free the load. Records pushed by different hashing workers
+ * reach a shard in no particular order, so duplicates of a key pushed in
+ * different chunks may be added in any order.
+ *
+ * @param ingest - The load to finish.
+ * @return size_t - The amount of records inserted.
+ */
+size_t HT_ingest_finish(HT_Ingest* ingest) {
+    _HT_queue_close(&ingest->chunks);
+    for (unsigned int t = 0; t < ingest->hash_threads; t++)
+        pthread_join(ingest->hashers[t], NULL);
+    for (unsigned int t = 0; t < ingest->insert_threads; t++)
+        _HT_queue_close(&ingest->inserters[t].batches);
+    for (unsigned int t = 0; t < ingest->insert_threads; t++) {
+        pthread_join(ingest->inserters[t].thread, NULL);
+        _HT_queue_free(&ingest->inserters[t].batches);
+    }
+    _HT_queue_free(&ingest->chunks);
+    size_t inserted = atomic_load(&ingest->inserted);
+    free(ingest->hashers);
+    free(ingest->inserters);
+    free(ingest);
+    return inserted;
+}
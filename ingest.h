@@ -0,0 +1,91 @@
+/**
+ * @file ingest.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for a streaming loader filling a sharded
+ * table through pipelined hashing and insertion stages.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+struct HT_sharded;
+
+/**
+ * A bounded queue handing work from one stage to the next. Pushing to a
+ * full queue blocks, which caps the work in flight.
+ */
+struct HT_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void** items;
+    size_t capacity;
+    size_t head; // The oldest item.
+    size_t count;
+    int closed; // Set once no more items will be pushed.
+};
+
+/**
+ * A chunk of records copied out of the caller's buffers. Its keys are
+ * packed one after the other in `blob`.
+ */
+struct HT_ingest_chunk {
+    size_t n;
+    char* blob;
+    size_t* offsets; // Where each key starts in `blob`.
+    size_t* lens;
+    int* values;
+    uint64_t* hashes; // Set by the hashing stage.
+    size_t* order; // The records sorted by shard, set by the hashing stage.
+    // The batches of the chunk not inserted yet. The last one frees it.
+    _Atomic unsigned int pending;
+};
+
+/**
+ * The records of a chunk going to one inserting worker, grouped by shard.
+ */
+struct HT_ingest_batch {
+    struct HT_ingest_chunk * chunk;
+    size_t n;
+    size_t* records; // A slice of the chunk's `order`.
+};
+
+/**
+ * An inserting worker. It owns a contiguous range of shards, so no other
+ * worker of the load writes to them. Threads outside the load may, since
+ * every insert takes the shard's lock.
+ */
+struct HT_ingest_worker {
+    struct HT_ingest * ingest;
+    struct HT_queue batches; // From the hashing stage to this worker.
+    pthread_t thread;
+};
+
+struct HT_ingest {
+    struct HT_sharded * table;
+    struct HT_queue chunks; // From `HT_ingest_push` to the hashing stage.
+    // Started workers of each stage. A stage without any is run by the
+    // threads feeding it instead.
+    unsigned int hash_threads;
+    unsigned int insert_threads;
+    pthread_t* hashers;
+    struct HT_ingest_worker * inserters;
+    _Atomic size_t inserted;
+};
+
+typedef struct HT_queue HT_Queue;
+typedef struct HT_ingest_chunk HT_Ingest_chunk;
+typedef struct HT_ingest_batch HT_Ingest_batch;
+typedef struct HT_ingest_worker HT_Ingest_worker;
+typedef struct HT_ingest HT_Ingest;
+
+HT_Ingest* HT_ingest_create(struct HT_sharded * s_table, unsigned int hash_threads,
+                            unsigned int insert_threads, size_t queue_depth);
+void HT_ingest_push(HT_Ingest* ingest, char** keys, int* values, size_t n);
+size_t HT_ingest_finish(HT_Ingest* ingest);
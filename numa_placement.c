@@ -0,0 +1,145 @@
+/**
+ * @file numa_placement.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Placement of memory on the NUMA nodes of the machine. Memory
+ * policies are set with the raw system calls, so nothing beyond the C
+ * library is needed, and every function degrades to doing nothing on
+ * machines with a single node, on kernels without NUMA support, or in
+ * containers whose seccomp profile forbids the calls.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numa_placement.h"
+
+// Memory policies of set_mempolicy(2) and mbind(2). Their header,
+// <numaif.h>, is only installed along with libnuma.
+#define HT_MPOL_DEFAULT 0
+#define HT_MPOL_PREFERRED 1
+#define HT_MPOL_INTERLEAVE 3
+// Move the pages already in place to follow the new policy.
+#define HT_MPOL_MF_MOVE (1 << 1)
+
+// The amount of nodes, 0 until first counted.
+int _HT_numa_nodes = 0;
+
+/**
+ * @brief Count the NUMA nodes of the machine, as one past the highest
+ * node online, so that every node number is below it.
+ *
+ * @return int - The amount of nodes, 1 if the machine is not NUMA.
+ */
+int HT_numa_nodes(void) {
+    int nodes = __atomic_load_n(&_HT_numa_nodes, __ATOMIC_RELAXED);
+    if (nodes) return nodes;
+    nodes = 1;
+    // A list of ranges, such as "0-1" or "0,2-3".
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (file) {
+        int node;
+        while (fscanf(file, "%d", &node) == 1) {
+            if (node + 1 > nodes) nodes = node + 1;
+            if (fgetc(file) == EOF) break;
+        }
+        fclose(file);
+    }
+    if (nodes > HT_NUMA_MAX_NODES) nodes = HT_NUMA_MAX_NODES;
+    __atomic_store_n(&_HT_numa_nodes, nodes, __ATOMIC_RELAXED);
+    return nodes;
+}
+
+/**
+ * @brief Find the NUMA node the calling thread is running on. Threads
+ * may migrate at any time unless they are pinned, so this is a hint.
+ *
+ * @return int - The node of the thread, 0 if it cannot be found.
+ */
+int HT_numa_node(void) {
+#ifdef SYS_getcpu
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < HT_NUMA_MAX_NODES)
+        return node;
+#endif
+    return 0;
+}
+
+/**
+ * @brief Spread the pages of a mapping round-robin over every NUMA node,
+ * so that threads of every node share its bandwidth and none of them
+ * pays for remote accesses alone. Pages already in place are moved.
+ *
+ * @param addr - The start of the mapping, aligned to a page.
+ * @param len - The length of the mapping.
+ * @return int - 1 if the pages are interleaved, 0 if the machine has a
+ * single node or the policy cannot be set.
+ */
+int HT_numa_interleave(void* addr, size_t len) {
+    int nodes = HT_numa_nodes();
+    if (nodes <= 1) return 0;
+#ifdef SYS_mbind
+    unsigned long mask = nodes >= 64 ? ~0ul : (1ul << nodes) - 1;
+    return syscall(SYS_mbind, addr, len, HT_MPOL_INTERLEAVE, &mask,
+                   sizeof(mask) * 8 + 1, HT_MPOL_MF_MOVE) == 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Make the memory the calling thread touches first from now on
+ * come from the provided NUMA node whenever it has some free, or go back
+ * to allocating on the thread's own node.
+ *
+ * @param node - The node to prefer, or -1 for the default policy.
+ * @return int - 1 if the policy was set, 0 otherwise.
+ */
+int HT_numa_prefer(int node) {
+#ifdef SYS_set_mempolicy
+    if (node < 0)
+        return syscall(SYS_set_mempolicy, HT_MPOL_DEFAULT, NULL, 0) == 0;
+    if (node >= HT_numa_nodes()) return 0;
+    unsigned long mask = 1ul << node;
+    return syscall(SYS_set_mempolicy, HT_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1) == 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Save the memory policy of the calling thread, so that it can be
+ * put back after preferring a node for a while.
+ *
+ * @param policy - Set to the policy of the thread.
+ * @return int - 1 if the policy was saved, 0 if it cannot be read, which
+ * includes machines with more than `HT_NUMA_MAX_NODES` possible nodes.
+ */
+int HT_numa_save(HT_Numa_policy* policy) {
+#ifdef SYS_get_mempolicy
+    return syscall(SYS_get_mempolicy, &policy->mode, &policy->mask,
+                   sizeof(policy->mask) * 8 + 1, NULL, 0) == 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Put back a memory policy saved by `HT_numa_save` on the calling
+ * thread.
+ *
+ * @param policy - The saved policy.
+ * @return int - 1 if the policy was set, 0 otherwise.
+ */
+int HT_numa_restore(HT_Numa_policy* policy) {
+#ifdef SYS_set_mempolicy
+    return syscall(SYS_set_mempolicy, policy->mode, &policy->mask,
+                   sizeof(policy->mask) * 8 + 1) == 0;
+#else
+    return 0;
+#endif
+}
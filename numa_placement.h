@@ -0,0 +1,34 @@
+/**
+ * @file numa_placement.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for placing memory on the NUMA nodes of the
+ * machine, without depending on libnuma.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+
+// The most nodes a memory policy covers.
+#define HT_NUMA_MAX_NODES 64
+
+/**
+ * The memory policy of a thread, saved by `HT_numa_save` to be put back
+ * by `HT_numa_restore`.
+ */
+struct HT_numa_policy {
+    int mode; // Mode of set_mempolicy(2), along with its flags.
+    unsigned long mask; // The nodes of the policy.
+};
+
+typedef struct HT_numa_policy HT_Numa_policy;
+
+int HT_numa_nodes(void);
+int HT_numa_node(void);
+int HT_numa_interleave(void* addr, size_t len);
+int HT_numa_prefer(int node);
+int HT_numa_save(HT_Numa_policy* policy);
+int HT_numa_restore(HT_Numa_policy* policy);
@@ -0,0 +1,416 @@
+/**
+ * @file ordered_index.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief An ordered index over the nodes of a hash table, kept in sync
+ * as keys are added and removed, for range and prefix queries in
+ * O(log n + k). The index is a B+tree of pointers to the table's own
+ * nodes, so it stores no key, and values changed in place stay current.
+ * Point lookups never touch it.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "ordered_index.h"
+
+/**
+ * @brief Compare a key with the key of a node, byte by byte, shorter keys
+ * first when one is a prefix of the other.
+ *
+ * @param key - The key to compare.
+ * @param len - The length of the key.
+ * @param node - The node to compare against.
+ * @return int - Negative if the key sorts first, 0 if both are equal,
+ * positive if the node sorts first.
+ */
+int _HT_index_cmp(const void* key, size_t len, HT_Node* node) {
+    int c = memcmp(key, node->key, len < node->key_len ? len : node->key_len);
+    if (c) return c;
+    return (len > node->key_len) - (len < node->key_len);
+}
+
+/**
+ * @brief Allocate an empty node of the tree.
+ *
+ * @param leaf - Whether the node is a leaf.
+ * @return HT_Index_node* - The node.
+ */
+HT_Index_node* _HT_index_new(int leaf) {
+    HT_Index_node* node = malloc(sizeof(HT_Index_node));
+    node->parent = NULL;
+    node->leaf = leaf;
+    node->count = 0;
+    node->prev = NULL;
+    node->next = NULL;
+    return node;
+}
+
+/**
+ * @brief Find the child of an inner node to descend to: the last one
+ * whose smallest entry sorts before the key, or also those equal to it.
+ *
+ * @param inner - The inner node.
+ * @param key - The key to search for.
+ * @param len - The length of the key.
+ * @param upper - Whether children starting with the key itself qualify.
+ * @return unsigned int - The index of the child, 0 if none qualifies.
+ */
+unsigned int _HT_index_route(HT_Index_node* inner, const void* key, size_t len, int upper) {
+    unsigned int low = 0, high = inner->count;
+    while (high - low > 1) {
+        unsigned int mid = (low + high) / 2;
+        int c = _HT_index_cmp(key, len, inner->entries[mid]);
+        if (upper ? c >= 0 : c > 0) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Find the position of a key within a leaf: before the entries
+ * equal to it, or after them.
+ *
+ * @param leaf - The leaf.
+ * @param key - The key to search for.
+ * @param len - The length of the key.
+ * @param upper - Whether to go past the entries equal to the key.
+ * @return unsigned int - The position, `count` if every entry sorts first.
+ */
+unsigned int _HT_index_position(HT_Index_node* leaf, const void* key, size_t len, int upper) {
+    unsigned int low = 0, high = leaf->count;
+    while (low < high) {
+        unsigned int mid = (low + high) / 2;
+        int c = _HT_index_cmp(key, len, leaf->entries[mid]);
+        if (upper ? c >= 0 : c > 0) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Descend from the root to the leaf a key belongs to.
+ *
+ * @param index - The index to search.
+ * @param key - The key to search for.
+ * @param len - The length of the key.
+ * @param upper - See `_HT_index_route`.
+ * @return HT_Index_node* - The leaf.
+ */
+HT_Index_node* _HT_index_leaf(HT_Index* index, const void* key, size_t len, int upper) {
+    HT_Index_node* node = index->root;
+    while (!node->leaf)
+        node = node->children[_HT_index_route(node, key, len, upper)];
+    return node;
+}
+
+/**
+ * @brief Find the position of a child within its parent.
+ */
+unsigned int _HT_index_child(HT_Index_node* parent, HT_Index_node* child) {
+    unsigned int i = 0;
+    while (parent->children[i] != child)
+        i++;
+    return i;
+}
+
+/**
+ * @brief Update the entries routing to a node whose smallest entry has
+ * changed, up to the first ancestor it is not the first child of.
+ *
+ * @param node - The node whose smallest entry changed.
+ */
+void _HT_index_fix_low(HT_Index_node* node) {
+    while (node->parent && node->count) {
+        HT_Index_node* parent = node->parent;
+        unsigned int i = _HT_index_child(parent, node);
+        parent->entries[i] = node->entries[0];
+        if (i) break;
+        node = parent;
+    }
+}
+
+void _HT_index_put(HT_Index* index, HT_Index_node* node, unsigned int pos,
+                   HT_Node* entry, HT_Index_node* child);
+
+/**
+ * @brief Split a full node in two halves, adding the right half to the
+ * parent, which may split in turn. A split root gets a new root above it.
+ *
+ * @param index - The index owning the node.
+ * @param node - The node to split. It keeps the left half.
+ * @return HT_Index_node* - The right half.
+ */
+HT_Index_node* _HT_index_split(HT_Index* index, HT_Index_node* node) {
+    HT_Index_node* right = _HT_index_new(node->leaf);
+    unsigned int half = node->count / 2;
+    right->count = node->count - half;
+    memcpy(right->entries, node->entries + half, sizeof(HT_Node*) * right->count);
+    if (node->leaf) {
+        right->next = node->next;
+        if (right->next)
+            right->next->prev = right;
+        right->prev = node;
+        node->next = right;
+    } else {
+        memcpy(right->children, node->children + half, sizeof(HT_Index_node*) * right->count);
+        for (unsigned int i = 0; i < right->count; i++)
+            right->children[i]->parent = right;
+    }
+    node->count = half;
+    if (!node->parent) {
+        HT_Index_node* root = _HT_index_new(0);
+        root->count = 1;
+        root->entries[0] = node->entries[0];
+        root->children[0] = node;
+        node->parent = root;
+        index->root = root;
+    }
+    _HT_index_put(index, node->parent, _HT_index_child(node->parent, node) + 1, right->entries[0], right);
+    return right;
+}
+
+/**
+ * @brief Insert an entry, along with its child for inner nodes, at the
+ * provided position of a node, splitting the node first if it is full.
+ *
+ * @param index - The index owning the node.
+ * @param node - The node to insert into.
+ * @param pos - The position of the new entry.
+ * @param entry - The entry, or the smallest entry under the child.
+ * @param child - The new child, NULL for leaves.
+ */
+void _HT_index_put(HT_Index* index, HT_Index_node* node, unsigned int pos,
+                   HT_Node* entry, HT_Index_node* child) {
+    if (node->count == HT_INDEX_FANOUT) {
+        HT_Index_node* right = _HT_index_split(index, node);
+        if (pos > node->count) {
+            pos -= node->count;
+            node = right;
+        }
+    }
+    memmove(node->entries + pos + 1, node->entries + pos, sizeof(HT_Node*) * (node->count - pos));
+    node->entries[pos] = entry;
+    if (child) {
+        memmove(node->children + pos + 1, node->children + pos, sizeof(HT_Index_node*) * (node->count - pos));
+        node->children[pos] = child;
+        child->parent = node;
+    }
+    node->count++;
+    if (!pos)
+        _HT_index_fix_low(node);
+}
+
+/**
+ * @brief Remove the entry at the provided position of a node, along with
+ * its child for inner nodes. Nodes left empty are removed from their
+ * parent in turn. Nodes are not merged with their neighbours, so the tree
+ * stays as tall as it was at its largest, but never holds an empty node.
+ *
+ * @param node - The node to remove from.
+ * @param pos - The position of the entry.
+ */
+void _HT_index_take(HT_Index_node* node, unsigned int pos) {
+    node->count--;
+    memmove(node->entries + pos, node->entries + pos + 1, sizeof(HT_Node*) * (node->count - pos));
+    if (!node->leaf)
+        memmove(node->children + pos, node->children + pos + 1, sizeof(HT_Index_node*) * (node->count - pos));
+    if (node->count || !node->parent) {
+        if (!pos)
+            _HT_index_fix_low(node);
+        return;
+    }
+    if (node->leaf) {
+        if (node->prev)
+            node->prev->next = node->next;
+        if (node->next)
+            node->next->prev = node->prev;
+    }
+    HT_Index_node* parent = node->parent;
+    unsigned int i = _HT_index_child(parent, node);
+    free(node);
+    _HT_index_take(parent, i);
+}
+
+/**
+ * @brief Find a node among the entries of its key, which may have
+ * duplicates.
+ *
+ * @param index - The index to search.
+ * @param node - The node to find.
+ * @param pos - Set to the position of the node within its leaf.
+ * @return HT_Index_node* - The leaf holding the node, NULL if missing.
+ */
+HT_Index_node* _HT_index_find(HT_Index* index, HT_Node* node, unsigned int* pos) {
+    HT_Index_node* leaf = _HT_index_leaf(index, node->key, node->key_len, 0);
+    unsigned int i = _HT_index_position(leaf, node->key, node->key_len, 0);
+    while (leaf) {
+        for (; i < leaf->count; i++) {
+            if (leaf->entries[i] == node) {
+                *pos = i;
+                return leaf;
+            }
+            if (_HT_index_cmp(node->key, node->key_len, leaf->entries[i]))
+                return NULL;
+        }
+        leaf = leaf->next;
+        i = 0;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Initializer function for an ordered index. See `HT_use_index`.
+ *
+ * @return HT_Index* - The created index, empty.
+ */
+HT_Index* HT_index_create(void) {
+    HT_Index* index = malloc(sizeof(HT_Index));
+    index->root = _HT_index_new(1);
+    index->size = 0;
+    return index;
+}
+
+/**
+ * @brief Add a node of the table to the index, after the nodes of equal
+ * keys already there.
+ *
+ * @param index - The index to add to.
+ * @param node - The node to add.
+ */
+void HT_index_insert(HT_Index* index, HT_Node* node) {
+    HT_Index_node* leaf = _HT_index_leaf(index, node->key, node->key_len, 1);
+    _HT_index_put(index, leaf, _HT_index_position(leaf, node->key, node->key_len, 1), node, NULL);
+    index->size++;
+}
+
+/**
+ * @brief Remove a node of the table from the index, before it is released.
+ *
+ * @param index - The index to remove from.
+ * @param node - The node to remove.
+ */
+void HT_index_erase(HT_Index* index, HT_Node* node) {
+    unsigned int pos;
+    HT_Index_node* leaf = _HT_index_find(index, node, &pos);
+    if (!leaf) return;
+    _HT_index_take(leaf, pos);
+    index->size--;
+    // A root left with a single child is replaced by it.
+    while (!index->root->leaf && index->root->count == 1) {
+        HT_Index_node* root = index->root;
+        index->root = root->children[0];
+        index->root->parent = NULL;
+        free(root);
+    }
+}
+
+/**
+ * @brief Point the index to the new copy of a node that has been moved,
+ * before the old one is released.
+ *
+ * @param index - The index to update.
+ * @param old - The node that was moved.
+ * @param node - Its copy, holding the same key.
+ */
+void HT_index_replace(HT_Index* index, HT_Node* old, HT_Node* node) {
+    unsigned int pos;
+    HT_Index_node* leaf = _HT_index_find(index, old, &pos);
+    if (!leaf) return;
+    leaf->entries[pos] = node;
+    if (!pos)
+        _HT_index_fix_low(leaf);
+}
+
+/**
+ * @brief Free a node of the tree and everything under it.
+ */
+void _HT_index_free(HT_Index_node* node) {
+    if (!node->leaf) {
+        for (unsigned int i = 0; i < node->count; i++)
+            _HT_index_free(node->children[i]);
+    }
+    free(node);
+}
+
+/**
+ * @brief Destroy the provided index. The nodes it points to are left alone.
+ *
+ * @param index - The index to destroy.
+ */
+void HT_index_destroy(HT_Index* index) {
+    _HT_index_free(index->root);
+    free(index);
+}
+
+/**
+ * @brief Call a function on every key from `low` included to `high`
+ * excluded, in key order. Keys compare byte by byte, and a key sorts
+ * right after its prefixes. Expired keys of tables in cache mode are
+ * skipped. The function must not add or remove keys.
+ *
+ * @param h_table - The hash table to scan. It must have an ordered index,
+ * see `HT_use_index`.
+ * @param low - The first key of the range. May be NULL to start from the
+ * smallest key.
+ * @param low_len - The length of `low`.
+ * @param high - The end of the range. May be NULL to scan to the largest key.
+ * @param high_len - The length of `high`.
+ * @param fn - The function to call on each node.
+ * @param data - Passed to every call of `fn`.
+ * @return size_t - The amount of keys visited, 0 if the table has no index.
+ */
+size_t HT_scan_range(HT_Ht* h_table, const void* low, size_t low_len,
+                     const void* high, size_t high_len, HT_Scan_fn fn, void* data) {
+    if (!h_table->index) return 0;
+    if (!low) {
+        low = "";
+        low_len = 0;
+    }
+    HT_Index_node* leaf = _HT_index_leaf(h_table->index, low, low_len, 0);
+    unsigned int i = _HT_index_position(leaf, low, low_len, 0);
+    size_t visited = 0;
+    for (; leaf; leaf = leaf->next, i = 0) {
+        for (; i < leaf->count; i++) {
+            HT_Node* node = leaf->entries[i];
+            if (high && _HT_index_cmp(high, high_len, node) <= 0) return visited;
+            if (_HT_expired(h_table, node)) continue;
+            fn(node, data);
+            visited++;
+        }
+    }
+    return visited;
+}
+
+/**
+ * @brief Call a function on every key starting with the provided bytes,
+ * in key order. See `HT_scan_range`.
+ *
+ * @param h_table - The hash table to scan. It must have an ordered index,
+ * see `HT_use_index`.
+ * @param prefix - The bytes every visited key starts with.
+ * @param len - The length of the prefix.
+ * @param fn - The function to call on each node.
+ * @param data - Passed to every call of `fn`.
+ * @return size_t - The amount of keys visited, 0 if the table has no index.
+ */
+size_t HT_scan_prefix(HT_Ht* h_table, const void* prefix, size_t len, HT_Scan_fn fn, void* data) {
+    if (!h_table->index) return 0;
+    HT_Index_node* leaf = _HT_index_leaf(h_table->index, prefix, len, 0);
+    unsigned int i = _HT_index_position(leaf, prefix, len, 0);
+    size_t visited = 0;
+    for (; leaf; leaf = leaf->next, i = 0) {
+        for (; i < leaf->count; i++) {
+            HT_Node* node = leaf->entries[i];
+            if (node->key_len < len || memcmp(node->key, prefix, len)) return visited;
+            if (_HT_expired(h_table, node)) continue;
+            fn(node, data);
+            visited++;
+        }
+    }
+    return visited;
+}
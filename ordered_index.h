@@ -0,0 +1,55 @@
+/**
+ * @file ordered_index.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for an ordered index of the nodes of a hash
+ * table, answering range and prefix queries.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Entries of a leaf, and children of an inner node, of the index.
+#define HT_INDEX_FANOUT 32
+
+struct HT_node;
+struct HT_ht;
+
+/**
+ * A node of the B+tree. Leaves hold the table's nodes sorted by key
+ * bytes, and are chained in that order. Inner nodes hold their children
+ * along with the smallest entry under each, to route searches without
+ * copying any key.
+ */
+struct HT_index_node {
+    struct HT_index_node * parent;
+    int leaf;
+    unsigned int count; // Entries of a leaf, or children of an inner node.
+    struct HT_index_node * prev; // Leaves only.
+    struct HT_index_node * next; // Leaves only.
+    struct HT_node * entries[HT_INDEX_FANOUT];
+    struct HT_index_node * children[HT_INDEX_FANOUT]; // Inner nodes only.
+};
+
+struct HT_index {
+    struct HT_index_node * root;
+    size_t size;
+};
+
+typedef struct HT_index_node HT_Index_node;
+typedef struct HT_index HT_Index;
+
+HT_Index* HT_index_create(void);
+void HT_index_insert(HT_Index* index, struct HT_node * node);
+void HT_index_erase(HT_Index* index, struct HT_node * node);
+void HT_index_replace(HT_Index* index, struct HT_node * old, struct HT_node * node);
+void HT_index_destroy(HT_Index* index);
+size_t HT_scan_range(struct HT_ht * h_table, const void* low, size_t low_len,
+                     const void* high, size_t high_len,
+                     void (*fn)(struct HT_node * node, void* data), void* data);
+size_t HT_scan_prefix(struct HT_ht * h_table, const void* prefix, size_t len,
+                      void (*fn)(struct HT_node * node, void* data), void* data);
@@ -0,0 +1,430 @@
+/**
+ * @file parallel.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Multi-threaded bulk builds and rehashes of hash tables. Keys are
+ * radix-partitioned by the top bits of their bucket index, and each
+ * worker owns one range of buckets (and the bitmap words covering them),
+ * so the workers never write to the same memory and need no locks. Every
+ * phase hands each worker a fixed slice of the work, and the phases are
+ * separated by joining the workers.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "hash_table.h"
+#include "arena.h"
+
+/**
+ * The work of a single worker: the phase function to run, the job it is
+ * part of, and the index of the worker.
+ */
+struct HT_worker {
+    void (*fn)(void* job, unsigned int id);
+    void* job;
+    unsigned int id;
+    pthread_t thread;
+};
+
+/**
+ * A bulk build in progress. Per-worker arrays are indexed by
+ * `worker * parts + part`.
+ */
+struct HT_build_job {
+    HT_Ht* table;
+    char** keys;
+    int* values;
+    size_t n;
+    unsigned int threads;
+    unsigned int parts;
+    size_t part_buckets; // Buckets per partition, a multiple of 64.
+    uint64_t* hashes;
+    size_t* lens;
+    size_t* counts; // Keys of each worker in each partition, then their offsets.
+    size_t* key_bytes; // Bytes of long keys, then their offsets.
+    size_t* order; // Indices of the keys, grouped by partition.
+    size_t* part_start; // `parts + 1` offsets into `order` and the node block.
+    size_t* part_key_start;
+    HT_Node* block;
+    unsigned char* key_block;
+};
+
+/**
+ * A parallel rehash in progress. Source buckets are the buckets of
+ * `nodes`, followed by the buckets of `old_nodes` that have not been
+ * migrated yet.
+ */
+struct HT_rehash_job {
+    HT_Ht* table;
+    unsigned int threads;
+    unsigned int parts;
+    size_t part_buckets;
+    size_t sources;
+    HT_Node** new_nodes;
+    uint64_t* new_occupied;
+    size_t new_capacity;
+    size_t* counts;
+    HT_Node** moved; // The nodes, grouped by partition.
+    size_t* part_start;
+};
+
+typedef struct HT_worker HT_Worker;
+typedef struct HT_build_job HT_Build_job;
+typedef struct HT_rehash_job HT_Rehash_job;
+
+/**
+ * @brief Entry point of a worker thread.
+ */
+void* _HT_worker_main(void* arg) {
+    HT_Worker* worker = arg;
+    worker->fn(worker->job, worker->id);
+    return NULL;
+}
+
+/**
+ * @brief Run one phase of a job on every worker and wait for all of them.
+ * The calling thread acts as worker 0.
+ *
+ * @param threads - The amount of workers.
+ * @param fn - The phase to run, given the job and the worker's index.
+ * @param job - The job.
+ */
+void _HT_run_workers(unsigned int threads, void (*fn)(void* job, unsigned int id), void* job) {
+    HT_Worker* workers = malloc(sizeof(HT_Worker) * threads);
+    int* started = calloc(threads, sizeof(int));
+    for (unsigned int i = 1; i < threads; i++) {
+        workers[i].fn = fn;
+        workers[i].job = job;
+        workers[i].id = i;
+        started[i] = pthread_create(&workers[i].thread, NULL, _HT_worker_main, &workers[i]) == 0;
+    }
+    fn(job, 0);
+    for (unsigned int i = 1; i < threads; i++) {
+        if (started[i])
+            pthread_join(workers[i].thread, NULL);
+        else
+            fn(job, i); // No thread could be started for this share of the work.
+    }
+    free(started);
+    free(workers);
+}
+
+/**
+ * @brief Split `amount` items into `threads` slices.
+ *
+ * @param amount - The amount of items.
+ * @param threads - The amount of slices.
+ * @param id - The index of the slice.
+ * @param start - Set to the first item of the slice.
+ * @param end - Set to one past the last item of the slice.
+ */
+void _HT_slice(size_t amount, unsigned int threads, unsigned int id, size_t* start, size_t* end) {
+    *start = amount * id / threads;
+    *end = amount * (id + 1) / threads;
+}
+
+/**
+ * @brief Pick how the buckets are partitioned: one partition per worker,
+ * each a multiple of 64 buckets so that no two workers share a word of
+ * the occupancy bitmap.
+ *
+ * @param capacity - The amount of buckets.
+ * @param threads - The amount of workers.
+ * @param part_buckets - Set to the amount of buckets per partition.
+ * @return unsigned int - The amount of partitions, at most `threads`.
+ */
+unsigned int _HT_partition(size_t capacity, unsigned int threads, size_t* part_buckets) {
+    size_t size = (capacity + threads - 1) / threads;
+    size = (size + 63) & ~(size_t) 63;
+    *part_buckets = size;
+    return (capacity + size - 1) / size;
+}
+
+/**
+ * @brief Turn per-worker counts into offsets, partition by partition so
+ * each partition's items end up together and in worker order.
+ *
+ * @param counts - The counts, indexed by `worker * parts + part`.
+ * @param threads - The amount of workers.
+ * @param parts - The amount of partitions.
+ * @param part_start - Set to the first offset of each partition, plus the total.
+ */
+void _HT_offsets(size_t* counts, unsigned int threads, unsigned int parts, size_t* part_start) {
+    size_t offset = 0;
+    for (unsigned int p = 0; p < parts; p++) {
+        part_start[p] = offset;
+        for (unsigned int w = 0; w < threads; w++) {
+            size_t count = counts[w * parts + p];
+            counts[w * parts + p] = offset;
+            offset += count;
+        }
+    }
+    part_start[parts] = offset;
+}
+
+/**
+ * @brief Build phase 1: hash a slice of the keys and count them per partition.
+ */
+void _HT_build_hash(void* arg, unsigned int id) {
+    HT_Build_job* job = arg;
+    size_t start, end;
+    _HT_slice(job->n, job->threads, id, &start, &end);
+    size_t* counts = job->counts + (size_t) id * job->parts;
+    size_t* key_bytes = job->key_bytes + (size_t) id * job->parts;
+    uint64_t mask = job->table->capacity - 1;
+    for (size_t i = start; i < end; i++) {
+        job->lens[i] = strlen(job->keys[i]);
+        job->hashes[i] = job->table->hash_fn(job->keys[i], job->lens[i], job->table->seed);
+        size_t part = (job->hashes[i] & mask) / job->part_buckets;
+        counts[part]++;
+        if (job->lens[i] >= HT_INLINE_KEY)
+            key_bytes[part] += job->lens[i] + 1;
+    }
+}
+
+/**
+ * @brief Build phase 2: scatter a slice of the keys into their partitions,
+ * keeping their order.
+ */
+void _HT_build_scatter(void* arg, unsigned int id) {
+    HT_Build_job* job = arg;
+    size_t start, end;
+    _HT_slice(job->n, job->threads, id, &start, &end);
+    size_t* offsets = job->counts + (size_t) id * job->parts;
+    uint64_t mask = job->table->capacity - 1;
+    for (size_t i = start; i < end; i++)
+        job->order[offsets[(job->hashes[i] & mask) / job->part_buckets]++] = i;
+}
+
+/**
+ * @brief Build phase 3: sort the keys of one partition by bucket, fill
+ * their nodes in bucket order within the partition's share of the node
+ * block, and link the partition's buckets.
+ */
+void _HT_build_fill(void* arg, unsigned int id) {
+    HT_Build_job* job = arg;
+    if (id >= job->parts) return;
+    HT_Ht* h_table = job->table;
+    uint64_t mask = h_table->capacity - 1;
+    size_t first = id * job->part_buckets;
+    size_t last = first + job->part_buckets < h_table->capacity ? first + job->part_buckets : h_table->capacity;
+    size_t base = job->part_start[id];
+    size_t* starts = calloc(last - first + 1, sizeof(size_t));
+    for (size_t i = base; i < job->part_start[id + 1]; i++)
+        starts[(job->hashes[job->order[i]] & mask) - first + 1]++;
+    for (size_t x = 0; x < last - first; x++)
+        starts[x + 1] += starts[x];
+    unsigned char* key_block = job->key_block + job->part_key_start[id];
+    // Later keys are placed first within their bucket, as `HT_add`
+    // would have put them at the head of the chain.
+    for (size_t i = job->part_start[id + 1]; i-- > base;) {
+        size_t k = job->order[i];
+        HT_Node* node = &(job->block[base + starts[(job->hashes[k] & mask) - first]++]);
+        if (job->lens[k] < HT_INLINE_KEY) {
+            node->key = node->inline_key;
+        } else {
+            node->key = key_block;
+            key_block += job->lens[k] + 1;
+        }
+        memcpy(node->key, job->keys[k], job->lens[k] + 1);
+        node->hash = job->hashes[k];
+        node->key_len = job->lens[k];
+        node->value = job->values[k];
+        node->expires = 0;
+        node->referenced = 0;
+    }
+    // Every bucket's cursor now points at the start of the next bucket.
+    size_t start = 0;
+    for (size_t x = 0; x < last - first; start = starts[x++]) {
+        if (start == starts[x]) continue;
+        for (size_t i = base + start; i + 1 < base + starts[x]; i++)
+            job->block[i].next = &(job->block[i + 1]);
+        job->block[base + starts[x] - 1].next = NULL;
+        h_table->nodes[first + x] = &(job->block[base + start]);
+        h_table->occupied[(first + x) >> 6] |= 1ull << ((first + x) & 63);
+    }
+    free(starts);
+}
+
+/**
+ * @brief Build a hash table from many key-value pairs with several
+ * threads. The result is the same as `HT_build`: nodes are laid out in
+ * one block in bucket order and the table behaves as if every pair had
+ * been added with `HT_add` in order.
+ *
+ * @param keys - The keys to add.
+ * @param values - The value of each key.
+ * @param n - The amount of keys.
+ * @param threads - The amount of threads to use. 0 or 1 builds on the
+ * calling thread only.
+ * @return HT_Ht* - The built table.
+ */
+HT_Ht* HT_build_parallel(char** keys, int* values, size_t n, unsigned int threads) {
+    if (threads <= 1 || !n) return HT_build(keys, values, n);
+    HT_Build_job job;
+    job.table = HT_create(n); // One bucket per key, as `HT_build`.
+    HT_use_arena(job.table);
+    job.keys = keys;
+    job.values = values;
+    job.n = n;
+    job.threads = threads;
+    job.parts = _HT_partition(job.table->capacity, threads, &job.part_buckets);
+    job.hashes = malloc(sizeof(uint64_t) * n);
+    job.lens = malloc(sizeof(size_t) * n);
+    job.counts = calloc((size_t) threads * job.parts, sizeof(size_t));
+    job.key_bytes = calloc((size_t) threads * job.parts, sizeof(size_t));
+    job.order = malloc(sizeof(size_t) * n);
+    job.part_start = malloc(sizeof(size_t) * (job.parts + 1));
+    job.part_key_start = malloc(sizeof(size_t) * (job.parts + 1));
+
+    _HT_run_workers(threads, _HT_build_hash, &job);
+    _HT_offsets(job.counts, threads, job.parts, job.part_start);
+    _HT_offsets(job.key_bytes, threads, job.parts, job.part_key_start);
+    job.block = HT_arena_alloc(job.table->node_arena, sizeof(HT_Node) * n, _Alignof(HT_Node));
+    size_t key_bytes = job.part_key_start[job.parts];
+    job.key_block = key_bytes ? HT_arena_alloc(job.table->key_arena, key_bytes, 1) : NULL;
+    _HT_run_workers(threads, _HT_build_scatter, &job);
+    _HT_run_workers(threads, _HT_build_fill, &job);
+    job.table->size = n;
+    job.table->bytes = sizeof(HT_Node) * n + key_bytes;
+
+    free(job.hashes);
+    free(job.lens);
+    free(job.counts);
+    free(job.key_bytes);
+    free(job.order);
+    free(job.part_start);
+    free(job.part_key_start);
+    return job.table;
+}
+
+/**
+ * @brief Find the head of a source bucket of a rehash.
+ *
+ * @param job - The rehash.
+ * @param source - The index of the source bucket.
+ * @return HT_Node* - The first node of the bucket.
+ */
+HT_Node* _HT_rehash_source(HT_Rehash_job* job, size_t source) {
+    HT_Ht* h_table = job->table;
+    if (source < h_table->capacity)
+        return h_table->nodes[source];
+    return h_table->old_nodes[h_table->rehash_index + (source - h_table->capacity)];
+}
+
+/**
+ * @brief Rehash phase 1: count the nodes of a slice of the source buckets
+ * per partition of the new buckets. Nodes are only read.
+ */
+void _HT_rehash_count(void* arg, unsigned int id) {
+    HT_Rehash_job* job = arg;
+    size_t start, end;
+    _HT_slice(job->sources, job->threads, id, &start, &end);
+    size_t* counts = job->counts + (size_t) id * job->parts;
+    for (size_t s = start; s < end; s++) {
+        for (HT_Node* node = _HT_rehash_source(job, s); node; node = node->next)
+            counts[(node->hash & (job->new_capacity - 1)) / job->part_buckets]++;
+    }
+}
+
+/**
+ * @brief Rehash phase 2: collect the nodes of a slice of the source
+ * buckets into their partitions, in chain order. Nodes are only read.
+ */
+void _HT_rehash_collect(void* arg, unsigned int id) {
+    HT_Rehash_job* job = arg;
+    size_t start, end;
+    _HT_slice(job->sources, job->threads, id, &start, &end);
+    size_t* offsets = job->counts + (size_t) id * job->parts;
+    for (size_t s = start; s < end; s++) {
+        for (HT_Node* node = _HT_rehash_source(job, s); node; node = node->next)
+            job->moved[offsets[(node->hash & (job->new_capacity - 1)) / job->part_buckets]++] = node;
+    }
+}
+
+/**
+ * @brief Rehash phase 3: link the nodes of one partition into the new
+ * buckets it owns. Walking the nodes backwards while prepending keeps the
+ * nodes of each source chain in their relative order.
+ */
+void _HT_rehash_link(void* arg, unsigned int id) {
+    HT_Rehash_job* job = arg;
+    if (id >= job->parts) return;
+    for (size_t i = job->part_start[id + 1]; i-- > job->part_start[id];) {
+        HT_Node* node = job->moved[i];
+        size_t index = node->hash & (job->new_capacity - 1);
+        node->next = job->new_nodes[index];
+        job->new_nodes[index] = node;
+        job->new_occupied[index >> 6] |= 1ull << (index & 63);
+    }
+}
+
+/**
+ * @brief Resize the provided hash table at once with several threads,
+ * finishing any incremental rehash in progress. Each thread migrates the
+ * keys of its own range of new buckets, so a large table is rehashed in
+ * a fraction of the time and no later operation pays for migration. A
+ * compaction in progress is finished first, which invalidates pointers
+ * from `HT_get_ptr`, see `HT_compact_step`; other resizes keep them.
+ *
+ * @param h_table - The hash table to resize.
+ * @param size - The amount of keys to make room for. The table never
+ * gets fewer buckets than it has keys.
+ * @param threads - The amount of threads to use.
+ * @return int - 1 if the table was resized, 0 if rehashing is paused by
+ * an iterator or a scan, or if the new array of buckets cannot be
+ * allocated, in which case the table is left as it was.
+ */
+int HT_resize_parallel(HT_Ht* h_table, size_t size, unsigned int threads) {
+    if (h_table->paused) return 0;
+    // Relinking would move nodes a compaction has yet to copy out of the
+    // storage it frees, so a compaction in progress is finished first.
+    if (h_table->compacting)
+        HT_compact(h_table);
+    if (size < h_table->size) size = h_table->size;
+    size_t capacity = 1;
+    while (capacity < size && capacity < HT_MAX_CAPACITY)
+        capacity *= 2;
+    if (!threads) threads = 1;
+    HT_Node** new_nodes = _HT_new_buckets(capacity, h_table->huge_pages, h_table->interleave);
+    if (!new_nodes) return 0;
+    HT_Rehash_job job;
+    job.table = h_table;
+    job.threads = threads;
+    job.new_capacity = capacity;
+    job.parts = _HT_partition(capacity, threads, &job.part_buckets);
+    job.sources = h_table->capacity;
+    if (h_table->old_nodes)
+        job.sources += h_table->old_capacity - h_table->rehash_index;
+    job.new_nodes = new_nodes;
+    job.new_occupied = calloc((capacity + 63) / 64, sizeof(uint64_t));
+    job.counts = calloc((size_t) threads * job.parts, sizeof(size_t));
+    job.moved = malloc(sizeof(HT_Node*) * (h_table->size ? h_table->size : 1));
+    job.part_start = malloc(sizeof(size_t) * (job.parts + 1));
+
+    _HT_run_workers(threads, _HT_rehash_count, &job);
+    _HT_offsets(job.counts, threads, job.parts, job.part_start);
+    _HT_run_workers(threads, _HT_rehash_collect, &job);
+    _HT_run_workers(threads, _HT_rehash_link, &job);
+
+    _HT_free_buckets(h_table->nodes, h_table->capacity, h_table->huge_pages);
+    free(h_table->occupied);
+    _HT_free_buckets(h_table->old_nodes, h_table->old_capacity, h_table->huge_pages);
+    free(h_table->old_occupied);
+    h_table->nodes = job.new_nodes;
+    h_table->occupied = job.new_occupied;
+    h_table->capacity = capacity;
+    h_table->old_nodes = NULL;
+    h_table->old_occupied = NULL;
+    h_table->old_capacity = 0;
+    h_table->rehash_index = 0;
+    free(job.counts);
+    free(job.moved);
+    free(job.part_start);
+    return 1;
+}
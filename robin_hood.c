@@ -0,0 +1,312 @@
+/**
+ * @file robin_hood.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief An open-addressing implementation of hash tables in C. Entries
+ * live inline in one flat array of slots, along with their key unless it
+ * is too long, so most lookups and inserts never leave the array. Inserts use Robin Hood
+ * displacement, which keeps probe sequences short, and removals shift
+ * the following entries back instead of leaving tombstones.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "robin_hood.h"
+
+// The table grows once more than RH_MAX_LOAD / 10 of its slots are used.
+#define RH_MAX_LOAD 9
+// The largest power of two of slots whose array size_t can measure.
+#define RH_MAX_CAPACITY ((SIZE_MAX / 2 + 1) / sizeof(RH_Slot))
+
+/**
+ * @brief Compute the distance of a slot from the slot its key
+ * hashes to.
+ *
+ * @param r_table - The table containing the slot.
+ * @param index - The index of the slot. It must not be empty.
+ * @return size_t - The probe distance of the slot.
+ */
+size_t _RH_distance(RH_Ht* r_table, size_t index) {
+    size_t mask = r_table->capacity - 1;
+    return (index - (r_table->slots[index].hash & mask)) & mask;
+}
+
+/**
+ * @brief Find the key of an occupied slot.
+ *
+ * @param slot - The slot.
+ * @return char* - The key, inside the slot if it is short.
+ */
+char* _RH_key(RH_Slot* slot) {
+    if (slot->tag != RH_LONG_KEY) return slot->inline_key;
+    char* key;
+    memcpy(&key, slot->inline_key, sizeof(key));
+    return key;
+}
+
+/**
+ * @brief Determine whether a slot holds the provided key. Short keys are
+ * compared in the slot, and only long ones are followed out of the array.
+ *
+ * @param slot - The slot to compare. It must not be empty.
+ * @param key - The key to compare with.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key.
+ * @return int - 1 if the slot holds the key, 0 otherwise.
+ */
+int _RH_match(RH_Slot* slot, char* key, size_t len, uint64_t hash) {
+    if (slot->hash != hash) return 0;
+    if (len < RH_INLINE_KEY)
+        return slot->tag == len + 1 && !memcmp(slot->inline_key, key, len);
+    return slot->tag == RH_LONG_KEY && !strcmp(_RH_key(slot), key);
+}
+
+/**
+ * @brief Allocate an array of empty slots.
+ *
+ * @param capacity - The amount of slots to allocate.
+ * @return RH_Slot* - The array of slots.
+ */
+RH_Slot* _RH_new_slots(size_t capacity) {
+    RH_Slot* slots = malloc(sizeof(RH_Slot) * capacity);
+    for (size_t i = 0; i < capacity; i++)
+        slots[i].tag = 0;
+    return slots;
+}
+
+/**
+ * @brief Initializer function for the open-addressing hash table.
+ *
+ * @param size - The initial capacity of the table. It is rounded up
+ * to a power of two, at most `RH_MAX_CAPACITY`, and the table grows on
+ * its own as keys are added.
+ * @return RH_Ht* - The created table.
+ */
+RH_Ht* RH_create(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size && capacity < RH_MAX_CAPACITY)
+        capacity *= 2;
+    RH_Ht* r_table = malloc(sizeof(RH_Ht));
+    r_table->capacity = capacity;
+    r_table->size = 0;
+    r_table->slots = _RH_new_slots(capacity);
+    return r_table;
+}
+
+/**
+ * @brief Place an entry in the table using Robin Hood displacement:
+ * whenever the entry being placed is further from home than the entry
+ * occupying a slot, the two are swapped and the displaced entry keeps
+ * probing. The key must not already be present.
+ *
+ * @param r_table - The table to insert into.
+ * @param entry - The entry to place. Its key is owned by the table.
+ */
+void _RH_place(RH_Ht* r_table, RH_Slot entry) {
+    size_t mask = r_table->capacity - 1;
+    size_t index = entry.hash & mask;
+    size_t dist = 0;
+    while (r_table->slots[index].tag) {
+        size_t existing = _RH_distance(r_table, index);
+        if (existing < dist) {
+            RH_Slot displaced = r_table->slots[index];
+            r_table->slots[index] = entry;
+            entry = displaced;
+            dist = existing;
+        }
+        index = (index + 1) & mask;
+        dist++;
+    }
+    r_table->slots[index] = entry;
+}
+
+/**
+ * @brief Double the capacity of the table and re-place every entry.
+ * Stored hashes are reused so no key is hashed again.
+ *
+ * @param r_table - The table to grow.
+ */
+void _RH_grow(RH_Ht* r_table) {
+    RH_Slot* old_slots = r_table->slots;
+    size_t old_capacity = r_table->capacity;
+    r_table->capacity *= 2;
+    r_table->slots = _RH_new_slots(r_table->capacity);
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].tag)
+            _RH_place(r_table, old_slots[i]);
+    }
+    free(old_slots);
+}
+
+/**
+ * @brief Find the slot holding the provided key. The probe stops as
+ * soon as it reaches a slot closer to home than the probe itself,
+ * since Robin Hood ordering guarantees the key cannot be further on.
+ *
+ * @param r_table - The table to search.
+ * @param key - The key to search for.
+ * @param len - The length of the key.
+ * @param hash - The hash of the key.
+ * @return size_t - The index of the key's slot, or the capacity of the
+ * table if not found.
+ */
+size_t _RH_lookup(RH_Ht* r_table, char* key, size_t len, uint64_t hash) {
+    size_t mask = r_table->capacity - 1;
+    size_t index = hash & mask;
+    for (size_t dist = 0; r_table->slots[index].tag; dist++) {
+        if (_RH_distance(r_table, index) < dist)
+            break;
+        if (_RH_match(&(r_table->slots[index]), key, len, hash))
+            return index;
+        index = (index + 1) & mask;
+    }
+    return r_table->capacity;
+}
+
+/**
+ * @brief Find the slot holding the provided key. See `_RH_lookup`.
+ *
+ * @param r_table - The table to search.
+ * @param key - The key to search for.
+ * @return size_t - The index of the key's slot, or the capacity of the
+ * table if not found.
+ */
+size_t _RH_find_slot(RH_Ht* r_table, char* key) {
+    size_t len = strlen(key);
+    return _RH_lookup(r_table, key, len, HT_hash_bytes(key, len, 0));
+}
+
+/**
+ * @brief Add a key-value pair to the table. Unlike `HT_add`, adding
+ * a key that already exists replaces its value.
+ *
+ * @param r_table - The table to add to.
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void RH_add(RH_Ht* r_table, char* key, int value) {
+    size_t len = strlen(key);
+    uint64_t hash = HT_hash_bytes(key, len, 0);
+    size_t index = _RH_lookup(r_table, key, len, hash);
+    if (index < r_table->capacity) {
+        r_table->slots[index].value = value;
+        return;
+    }
+    // In 64 bits, so that the products never wrap.
+    if (((uint64_t) r_table->size + 1) * 10 > (uint64_t) r_table->capacity * RH_MAX_LOAD)
+        _RH_grow(r_table);
+    RH_Slot entry;
+    entry.hash = hash;
+    entry.value = value;
+    if (len < RH_INLINE_KEY) {
+        entry.tag = len + 1;
+        memcpy(entry.inline_key, key, len + 1);
+    } else {
+        entry.tag = RH_LONG_KEY;
+        char* copy = malloc(sizeof(char) * (len + 1));
+        memcpy(copy, key, len + 1);
+        memcpy(entry.inline_key, &copy, sizeof(copy));
+    }
+    _RH_place(r_table, entry);
+    r_table->size++;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists
+ * within the table.
+ *
+ * @param r_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int RH_check(RH_Ht* r_table, char* key) {
+    return _RH_find_slot(r_table, key) < r_table->capacity;
+}
+
+/**
+ * @brief Find the value of the provided key. NOTE: Assumes the key
+ * exists within the table. Use `RH_check` if unsure.
+ *
+ * @param r_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the provided key, or 0 if it is missing.
+ */
+int RH_find(RH_Ht* r_table, char* key) {
+    size_t index = _RH_find_slot(r_table, key);
+    return index < r_table->capacity ? r_table->slots[index].value : 0;
+}
+
+/**
+ * @brief Change the value of an existing key. Does nothing if the key
+ * is missing.
+ *
+ * @param r_table - The table to change.
+ * @param key - The key of the value to change.
+ * @param value - The new value.
+ */
+void RH_change(RH_Ht* r_table, char* key, int value) {
+    size_t index = _RH_find_slot(r_table, key);
+    if (index < r_table->capacity)
+        r_table->slots[index].value = value;
+}
+
+/**
+ * @brief Remove a key-value pair from the table. The entries following
+ * the removed one are shifted back by one slot until an empty slot or
+ * an entry already in its home slot is reached, so no tombstones are
+ * left behind. Does nothing if the key is missing.
+ *
+ * @param r_table - The table to remove from.
+ * @param key - The key of the key-value pair to be removed.
+ */
+void RH_remove(RH_Ht* r_table, char* key) {
+    size_t index = _RH_find_slot(r_table, key);
+    if (index == r_table->capacity) return;
+    size_t mask = r_table->capacity - 1;
+    if (r_table->slots[index].tag == RH_LONG_KEY)
+        free(_RH_key(&(r_table->slots[index])));
+    for (;;) {
+        size_t next = (index + 1) & mask;
+        if (!r_table->slots[next].tag || _RH_distance(r_table, next) == 0)
+            break;
+        r_table->slots[index] = r_table->slots[next];
+        index = next;
+    }
+    r_table->slots[index].tag = 0;
+    r_table->size--;
+}
+
+/**
+ * @brief Print the occupied slots of the table to STDOUT in a
+ * human-readable manner.
+ *
+ * @param r_table - The table to be printed out.
+ */
+void RH_print(RH_Ht* r_table) {
+    for (size_t i = 0; i < r_table->capacity; i++) {
+        if (r_table->slots[i].tag)
+            printf("=====SLOT %zu (+%zu)=====\n{\"%s\": %d}\n", i,
+                   _RH_distance(r_table, i), _RH_key(&(r_table->slots[i])),
+                   r_table->slots[i].value);
+    }
+}
+
+/**
+ * @brief Destroy the provided table and every key it owns.
+ *
+ * @param r_table - The table to destroy.
+ */
+void RH_destroy(RH_Ht* r_table) {
+    for (size_t i = 0; i < r_table->capacity; i++) {
+        if (r_table->slots[i].tag == RH_LONG_KEY)
+            free(_RH_key(&(r_table->slots[i])));
+    }
+    free(r_table->slots);
+    free(r_table);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file robin_hood.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for an open-addressing hash table using
+ * Robin Hood displacement and backward-shift deletion.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keys shorter than this many bytes are stored inside their slot. This
+// fills the slot up to 32 bytes, two per cache line.
+#define RH_INLINE_KEY 19
+// The tag of a slot whose key is stored outside of it.
+#define RH_LONG_KEY 255
+
+struct RH_slot {
+    uint64_t hash; // Full hash of the key. Also gives the slot's probe distance.
+    int value;
+    // 0 if the slot is empty, `RH_LONG_KEY` if its key is stored outside
+    // of it, or else one more than the length of the key inside it.
+    unsigned char tag;
+    // A short key and its null character, or else the address of the
+    // key, owned by the table. Slots move, so short keys are never
+    // pointed to.
+    char inline_key[RH_INLINE_KEY];
+};
+
+struct RH_ht {
+    size_t capacity; // Always a power of two.
+    size_t size;
+    struct RH_slot * slots;
+};
+
+typedef struct RH_slot RH_Slot;
+typedef struct RH_ht RH_Ht;
+
+RH_Ht* RH_create(size_t size);
+void RH_add(RH_Ht* r_table, char* key, int value);
+int RH_check(RH_Ht* r_table, char* key);
+int RH_find(RH_Ht* r_table, char* key);
+void RH_change(RH_Ht* r_table, char* key, int value);
+void RH_remove(RH_Ht* r_table, char* key);
+void RH_print(RH_Ht* r_table);
+void RH_destroy(RH_Ht* r_table);
@@ -0,0 +1,296 @@
+/**
+ * @file sharded_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A thread-safe front-end over several independent hash tables.
+ * Each key is routed to a shard by the top bits of its hash, and each
+ * shard is a plain `HT_Ht` behind its own lock, with its own capacity
+ * and resize schedule. Writers only contend within a shard, and each
+ * resize moves a fraction of the keys, without any change to `HT_Ht`.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "sharded_table.h"
+
+/**
+ * The shards destroyed by one thread of `HT_sharded_destroy`: every
+ * shard whose index is `id` modulo `threads`.
+ */
+struct HT_shard_work {
+    HT_Sharded* s_table;
+    unsigned int id;
+    unsigned int threads;
+    pthread_t thread;
+};
+
+typedef struct HT_shard_work HT_Shard_work;
+
+/**
+ * @brief Initializer function for the sharded hash table.
+ *
+ * @param size - The expected amount of keys, spread over the shards.
+ * Each shard grows on its own as keys are added.
+ * @param shards - The amount of shards, rounded up to a power of two.
+ * More shards mean less contention between threads and shorter resizes.
+ * @return HT_Sharded* - The created table.
+ */
+HT_Sharded* HT_sharded_create(size_t size, unsigned int shards) {
+    HT_Sharded* s_table = malloc(sizeof(HT_Sharded));
+    s_table->shard_bits = 0;
+    while (((uint64_t) 1 << s_table->shard_bits) < shards)
+        s_table->shard_bits++;
+    s_table->seed = 0;
+    size_t count = (size_t) 1 << s_table->shard_bits;
+    s_table->shards = aligned_alloc(_Alignof(HT_Shard), sizeof(HT_Shard) * count);
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_init(&s_table->shards[i].lock, NULL);
+        s_table->shards[i].table = HT_create((size + count - 1) / count);
+        HT_set_hash(s_table->shards[i].table, HT_hash_bytes, s_table->seed);
+    }
+    return s_table;
+}
+
+/**
+ * @brief Find the shard owning a key from the top bits of its hash.
+ * Shards pick buckets from the low bits of the same hash, so the keys of
+ * a shard still spread over all of its buckets, and the hash is handed
+ * to the shard's `_hashed` functions instead of being computed twice.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to route.
+ * @param len - Set to the length of the key.
+ * @param hash - Set to the hash of the key, valid for every shard.
+ * @return HT_Shard* - The shard owning the key.
+ */
+HT_Shard* _HT_shard(HT_Sharded* s_table, char* key, size_t* len, uint64_t* hash) {
+    *len = strlen(key);
+    *hash = HT_hash_bytes(key, *len, s_table->seed);
+    if (!s_table->shard_bits) return s_table->shards;
+    return &(s_table->shards[*hash >> (64 - s_table->shard_bits)]);
+}
+
+/**
+ * @brief Add a key-value pair to the table. See `HT_add`.
+ *
+ * @param s_table - The table to add to.
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void HT_sharded_add(HT_Sharded* s_table, char* key, int value) {
+    size_t len;
+    uint64_t hash;
+    HT_Shard* shard = _HT_shard(s_table, key, &len, &hash);
+    pthread_mutex_lock(&shard->lock);
+    HT_add_hashed(shard->table, key, len, hash, value);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief Determine whether or not the provided key exists
+ * within the table.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int HT_sharded_check(HT_Sharded* s_table, char* key) {
+    return HT_sharded_get(s_table, key, NULL);
+}
+
+/**
+ * @brief Find the value of the provided key. Unlike `HT_find`, missing
+ * keys are safe, since another thread may remove a key at any time.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the key, or 0 if it is missing.
+ */
+int HT_sharded_find(HT_Sharded* s_table, char* key) {
+    int value = 0;
+    HT_sharded_get(s_table, key, &value);
+    return value;
+}
+
+/**
+ * @brief Find the value of the provided key in a single lookup. See `HT_get`.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_sharded_get(HT_Sharded* s_table, char* key, int* out) {
+    size_t len;
+    uint64_t hash;
+    HT_Shard* shard = _HT_shard(s_table, key, &len, &hash);
+    // Lookups take the lock too: they advance rehashes and may update
+    // the shard's counters and cache marks.
+    pthread_mutex_lock(&shard->lock);
+    int found = HT_get_hashed(shard->table, key, len, hash, out);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+/**
+ * @brief Set the value of the provided key, adding the key if it does
+ * not exist yet. See `HT_upsert`.
+ *
+ * @param s_table - The table to change.
+ * @param key - The key to set.
+ * @param value - The value to set.
+ * @return int - 1 if the key was added, 0 if an existing value was replaced.
+ */
+int HT_sharded_upsert(HT_Sharded* s_table, char* key, int value) {
+    size_t len;
+    uint64_t hash;
+    HT_Shard* shard = _HT_shard(s_table, key, &len, &hash);
+    pthread_mutex_lock(&shard->lock);
+    int added = HT_upsert_hashed(shard->table, key, len, hash, value);
+    pthread_mutex_unlock(&shard->lock);
+    return added;
+}
+
+/**
+ * @brief Change the value of an existing key. Does nothing if the key
+ * is missing.
+ *
+ * @param s_table - The table to change.
+ * @param key - The key of the value to change.
+ * @param value - The new value.
+ */
+void HT_sharded_change(HT_Sharded* s_table, char* key, int value) {
+    size_t len;
+    uint64_t hash;
+    HT_Shard* shard = _HT_shard(s_table, key, &len, &hash);
+    pthread_mutex_lock(&shard->lock);
+    int* slot = HT_get_ptr_hashed(shard->table, key, len, hash);
+    if (slot)
+        *slot = value;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief Remove a key-value pair from the table.
+ *
+ * @param s_table - The table to remove from.
+ * @param key - The key of the key-value pair to be removed.
+ * @return int - 1 if the key was removed, 0 if it did not exist.
+ */
+int HT_sharded_remove(HT_Sharded* s_table, char* key) {
+    size_t len;
+    uint64_t hash;
+    HT_Shard* shard = _HT_shard(s_table, key, &len, &hash);
+    pthread_mutex_lock(&shard->lock);
+    int removed = HT_remove_hashed(shard->table, key, len, hash);
+    pthread_mutex_unlock(&shard->lock);
+    return removed;
+}
+
+/**
+ * @brief Count the keys of the table. Shards are counted one after the
+ * other, so the result is only exact while no other thread writes.
+ *
+ * @param s_table - The table to count.
+ * @return size_t - The amount of keys.
+ */
+size_t HT_sharded_size(HT_Sharded* s_table) {
+    size_t size = 0;
+    for (size_t i = 0; i < ((size_t) 1 << s_table->shard_bits); i++) {
+        pthread_mutex_lock(&s_table->shards[i].lock);
+        size += s_table->shards[i].table->size;
+        pthread_mutex_unlock(&s_table->shards[i].lock);
+    }
+    return size;
+}
+
+/**
+ * @brief Summarize the health of every shard at once. Counts and bytes
+ * are summed, the longest chain is the longest of any shard, and ratios
+ * are computed over the whole table. Each shard is locked only while it
+ * is summarized.
+ *
+ * @param s_table - The table to summarize.
+ * @param out - Set to the summary of the table.
+ */
+void HT_sharded_stats(HT_Sharded* s_table, HT_Stats* out) {
+    memset(out, 0, sizeof(HT_Stats));
+    double probes = 0;
+    for (size_t i = 0; i < ((size_t) 1 << s_table->shard_bits); i++) {
+        HT_Stats shard;
+        pthread_mutex_lock(&s_table->shards[i].lock);
+        HT_stats(s_table->shards[i].table, &shard);
+        pthread_mutex_unlock(&s_table->shards[i].lock);
+        out->size += shard.size;
+        out->buckets += shard.buckets;
+        for (int c = 0; c < HT_STATS_CHAINS; c++)
+            out->chains[c] += shard.chains[c];
+        if (shard.max_chain > out->max_chain)
+            out->max_chain = shard.max_chain;
+        probes += shard.mean_probes * shard.size;
+        out->rehashing |= shard.rehashing;
+        out->node_bytes += shard.node_bytes;
+        out->key_bytes += shard.key_bytes;
+        out->bucket_bytes += shard.bucket_bytes;
+        out->hits += shard.hits;
+        out->misses += shard.misses;
+        out->resizes += shard.resizes;
+        out->evictions += shard.evictions;
+        out->expirations += shard.expirations;
+    }
+    out->load_factor = (double) out->size / out->buckets;
+    out->empty_ratio = (double) out->chains[0] / out->buckets;
+    out->mean_probes = out->size ? probes / out->size : 0;
+}
+
+/**
+ * @brief Destroy the shards handed to one thread of `HT_sharded_destroy`.
+ */
+void* _HT_destroy_shards(void* arg) {
+    HT_Shard_work* work = arg;
+    HT_Sharded* s_table = work->s_table;
+    for (size_t i = work->id; i < ((size_t) 1 << s_table->shard_bits); i += work->threads) {
+        HT_destroy(s_table->shards[i].table);
+        pthread_mutex_destroy(&s_table->shards[i].lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Destroy the provided table. Freeing every node of a large table
+ * takes a while, so the shards may be destroyed by several threads at
+ * once. No other thread may use the table anymore.
+ *
+ * @param s_table - The table to destroy.
+ * @param threads - The amount of threads to use, including the calling one.
+ */
+void HT_sharded_destroy(HT_Sharded* s_table, unsigned int threads) {
+    size_t count = (size_t) 1 << s_table->shard_bits;
+    if (threads < 1) threads = 1;
+    if (threads > count) threads = count;
+    HT_Shard_work* work = malloc(sizeof(HT_Shard_work) * threads);
+    for (unsigned int t = 0; t < threads; t++) {
+        work[t].s_table = s_table;
+        work[t].id = t;
+        work[t].threads = threads;
+    }
+    int* started = calloc(threads, sizeof(int));
+    for (unsigned int t = 1; t < threads; t++)
+        started[t] = pthread_create(&work[t].thread, NULL, _HT_destroy_shards, &work[t]) == 0;
+    _HT_destroy_shards(&work[0]);
+    for (unsigned int t = 1; t < threads; t++) {
+        if (started[t])
+            pthread_join(work[t].thread, NULL);
+        else
+            _HT_destroy_shards(&work[t]); // No thread could be started for these shards.
+    }
+    free(started);
+    free(work);
+    free(s_table->shards);
+    free(s_table);
+}
@@ -0,0 +1,49 @@
+/**
+ * @file sharded_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for a thread-safe front-end spreading keys
+ * over independent hash tables, each behind its own lock.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+struct HT_ht;
+struct HT_stats;
+
+/**
+ * A shard owns the keys whose hash starts with its index. Shards are
+ * aligned to a cache line so that locking one never slows down its
+ * neighbours.
+ */
+struct HT_shard {
+    _Alignas(64) pthread_mutex_t lock;
+    struct HT_ht * table; // Guarded by `lock`.
+};
+
+struct HT_sharded {
+    unsigned int shard_bits; // There are 2^shard_bits shards.
+    uint64_t seed; // Seed of `HT_hash_bytes`, shared by every shard.
+    struct HT_shard * shards;
+};
+
+typedef struct HT_shard HT_Shard;
+typedef struct HT_sharded HT_Sharded;
+
+HT_Sharded* HT_sharded_create(size_t size, unsigned int shards);
+void HT_sharded_add(HT_Sharded* s_table, char* key, int value);
+int HT_sharded_check(HT_Sharded* s_table, char* key);
+int HT_sharded_find(HT_Sharded* s_table, char* key);
+int HT_sharded_get(HT_Sharded* s_table, char* key, int* out);
+int HT_sharded_upsert(HT_Sharded* s_table, char* key, int value);
+void HT_sharded_change(HT_Sharded* s_table, char* key, int value);
+int HT_sharded_remove(HT_Sharded* s_table, char* key);
+size_t HT_sharded_size(HT_Sharded* s_table);
+void HT_sharded_stats(HT_Sharded* s_table, struct HT_stats * out);
+void HT_sharded_destroy(HT_Sharded* s_table, unsigned int threads);
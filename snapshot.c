@@ -0,0 +1,277 @@
+/**
+ * @file snapshot.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Pointer-free snapshots of hash tables. A snapshot stores the
+ * table as compressed rows: an array of bucket starts, the entries of
+ * every bucket one after another, and the key bytes. Since every section
+ * is addressed by offset, a saved snapshot is served by mapping the file
+ * and reading it in place, with no deserialization, and processes mapping
+ * the same file share one copy of it in the page cache.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hash_table.h"
+#include "snapshot.h"
+
+/**
+ * @brief Round an offset up to a multiple of 8.
+ */
+uint64_t _HT_snapshot_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * @brief Pad a section with zeros up to a multiple of 8 bytes.
+ *
+ * @param file - The file to write to.
+ * @param size - The amount of bytes written in the section so far.
+ * @return int - 1 if the padding was written, 0 otherwise.
+ */
+int _HT_snapshot_pad(FILE* file, uint64_t size) {
+    static const unsigned char padding[8] = {0};
+    size_t pad = _HT_snapshot_align(size) - size;
+    return fwrite(padding, 1, pad, file) == pad;
+}
+
+/**
+ * @brief Write a section of the snapshot.
+ *
+ * @param file - The file to write to.
+ * @param data - The bytes of the section.
+ * @param size - The amount of bytes.
+ * @return int - 1 if every byte was written, 0 otherwise.
+ */
+int _HT_snapshot_write(FILE* file, const void* data, size_t size) {
+    return fwrite(data, 1, size, file) == size && _HT_snapshot_pad(file, size);
+}
+
+/**
+ * @brief Save a snapshot of the provided hash table to a file, to be
+ * served later by `HT_open_mmap`. Entries are grouped by bucket with a
+ * counting sort, keeping the order of each chain, so duplicate keys
+ * resolve to the same value as in the table. The snapshot is written
+ * next to `path` and renamed over it, so processes that mapped a previous
+ * snapshot keep reading a complete file.
+ *
+ * @param h_table - The hash table to save. Tables using another hash
+ * function than `HT_hash_bytes` have their keys hashed again.
+ * @param path - The path of the snapshot.
+ * @return int - 1 if the snapshot was saved, 0 otherwise.
+ */
+int HT_save(HT_Ht* h_table, const char* path) {
+    uint64_t capacity = 1;
+    while (capacity < h_table->size)
+        capacity *= 2;
+    uint64_t* starts = calloc(capacity + 1, sizeof(uint64_t));
+    HT_Snapshot_entry* entries = malloc(sizeof(HT_Snapshot_entry) * (h_table->size ? h_table->size : 1));
+    HT_Node** nodes = malloc(sizeof(HT_Node*) * (h_table->size ? h_table->size : 1));
+    uint64_t key_bytes = 0, count = 0;
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    for (HT_Node* node = HT_iter_next(&iter); node; node = HT_iter_next(&iter)) {
+        uint64_t hash = node->hash;
+        if (h_table->hash_fn != HT_hash_bytes)
+            hash = HT_hash_bytes(node->key, node->key_len, h_table->seed);
+        entries[count].hash = hash;
+        entries[count].key_len = node->key_len;
+        entries[count].value = node->value;
+        nodes[count++] = node;
+        starts[(hash & (capacity - 1)) + 1]++;
+        key_bytes += node->key_len;
+    }
+    for (uint64_t i = 0; i < capacity; i++)
+        starts[i + 1] += starts[i];
+    // Scatter the entries into their buckets, reusing the count of
+    // each bucket as its insertion cursor.
+    uint64_t* cursors = malloc(sizeof(uint64_t) * capacity);
+    memcpy(cursors, starts, sizeof(uint64_t) * capacity);
+    HT_Snapshot_entry* sorted = malloc(sizeof(HT_Snapshot_entry) * (count ? count : 1));
+    HT_Node** sorted_nodes = malloc(sizeof(HT_Node*) * (count ? count : 1));
+    uint64_t key_offset = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t at = cursors[entries[i].hash & (capacity - 1)]++;
+        sorted[at] = entries[i];
+        sorted_nodes[at] = nodes[i];
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        sorted[i].key_offset = key_offset;
+        key_offset += sorted[i].key_len;
+    }
+
+    HT_Snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HT_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = HT_SNAPSHOT_VERSION;
+    header.byte_order = HT_SNAPSHOT_BYTE_ORDER;
+    header.seed = h_table->seed;
+    header.capacity = capacity;
+    header.size = count;
+    header.starts_offset = _HT_snapshot_align(sizeof(header));
+    header.entries_offset = header.starts_offset + _HT_snapshot_align(sizeof(uint64_t) * (capacity + 1));
+    header.keys_offset = header.entries_offset + _HT_snapshot_align(sizeof(HT_Snapshot_entry) * count);
+    header.file_size = header.keys_offset + _HT_snapshot_align(key_bytes);
+
+    size_t path_len = strlen(path);
+    char* temp_path = malloc(path_len + 5);
+    memcpy(temp_path, path, path_len);
+    memcpy(temp_path + path_len, ".tmp", 5);
+    FILE* file = fopen(temp_path, "wb");
+    int saved = file != NULL;
+    if (file) {
+        saved = _HT_snapshot_write(file, &header, sizeof(header))
+            && _HT_snapshot_write(file, starts, sizeof(uint64_t) * (capacity + 1))
+            && _HT_snapshot_write(file, sorted, sizeof(HT_Snapshot_entry) * count);
+        for (uint64_t i = 0; saved && i < count; i++)
+            saved = fwrite(sorted_nodes[i]->key, 1, sorted[i].key_len, file) == sorted[i].key_len;
+        saved = saved && _HT_snapshot_pad(file, key_bytes);
+        saved = (fclose(file) == 0) && saved;
+        saved = saved && rename(temp_path, path) == 0;
+        if (!saved)
+            remove(temp_path);
+    }
+    HT_iter_release(&iter);
+    free(temp_path);
+    free(starts);
+    free(cursors);
+    free(entries);
+    free(sorted);
+    free(nodes);
+    free(sorted_nodes);
+    return saved;
+}
+
+/**
+ * @brief Map a snapshot saved by `HT_save` and serve it read-only. The
+ * header and the bounds of every section are checked, so a truncated or
+ * foreign file is rejected instead of read out of bounds.
+ *
+ * @param path - The path of the snapshot.
+ * @return HT_Map* - The mapped snapshot, or NULL if the file cannot be
+ * mapped or is not a valid snapshot.
+ */
+HT_Map* HT_open_mmap(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(HT_Snapshot_header)) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = st.st_size;
+    void* base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file alive.
+    if (base == MAP_FAILED) return NULL;
+    const HT_Snapshot_header* header = base;
+    // Every offset is bounded by the file before anything is added to it,
+    // and sections are compared by their room left in the file, so no
+    // crafted header can wrap the checks around.
+    int valid = !memcmp(header->magic, HT_SNAPSHOT_MAGIC, sizeof(header->magic))
+        && header->version == HT_SNAPSHOT_VERSION
+        && header->byte_order == HT_SNAPSHOT_BYTE_ORDER
+        && header->file_size == length
+        && header->capacity && !(header->capacity & (header->capacity - 1))
+        && header->starts_offset >= sizeof(HT_Snapshot_header)
+        && header->starts_offset <= length
+        && header->starts_offset % _Alignof(uint64_t) == 0
+        && header->capacity < (length - header->starts_offset) / sizeof(uint64_t)
+        && header->entries_offset >= header->starts_offset
+        && header->entries_offset <= length
+        && header->entries_offset % _Alignof(HT_Snapshot_entry) == 0
+        && header->entries_offset - header->starts_offset >= sizeof(uint64_t) * (header->capacity + 1)
+        && header->size <= (length - header->entries_offset) / sizeof(HT_Snapshot_entry)
+        && header->keys_offset >= header->entries_offset
+        && header->keys_offset <= length
+        && header->keys_offset - header->entries_offset >= sizeof(HT_Snapshot_entry) * header->size;
+    if (valid) {
+        const uint64_t* starts = (const uint64_t*) ((const char*) base + header->starts_offset);
+        valid = starts[0] == 0 && starts[header->capacity] == header->size;
+    }
+    if (!valid) {
+        munmap(base, length);
+        return NULL;
+    }
+    HT_Map* map = malloc(sizeof(HT_Map));
+    map->base = base;
+    map->length = length;
+    map->header = header;
+    map->starts = (const uint64_t*) ((const char*) base + header->starts_offset);
+    map->entries = (const HT_Snapshot_entry*) ((const char*) base + header->entries_offset);
+    map->keys = (const unsigned char*) base + header->keys_offset;
+    map->key_bytes = length - header->keys_offset;
+    return map;
+}
+
+/**
+ * @brief Find the value of the provided binary key within a mapped
+ * snapshot. Only the key's bucket is read from the file.
+ *
+ * @param map - The snapshot to search.
+ * @param key - The bytes of the key.
+ * @param len - The length of the key.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_map_get_bytes(HT_Map* map, const void* key, size_t len, int* out) {
+    uint64_t hash = HT_hash_bytes(key, len, map->header->seed);
+    uint64_t bucket = hash & (map->header->capacity - 1);
+    uint64_t end = map->starts[bucket + 1];
+    // Bounds are checked as entries are read, so a corrupted file can
+    // give wrong answers but never make a lookup read outside the file.
+    if (end > map->header->size) end = map->header->size;
+    for (uint64_t i = map->starts[bucket]; i < end; i++) {
+        const HT_Snapshot_entry* entry = &(map->entries[i]);
+        if (entry->hash == hash && entry->key_len == len && entry->key_offset <= map->key_bytes
+            && len <= map->key_bytes - entry->key_offset
+            && !memcmp(map->keys + entry->key_offset, key, len)) {
+            if (out) *out = entry->value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists within a
+ * mapped snapshot.
+ *
+ * @param map - The snapshot to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int HT_map_check(HT_Map* map, char* key) {
+    return HT_map_get_bytes(map, key, strlen(key), NULL);
+}
+
+/**
+ * @brief Find the value of the provided key within a mapped snapshot.
+ *
+ * @param map - The snapshot to search.
+ * @param key - The key to search for.
+ * @return int - The value of the key, or 0 if it is missing.
+ */
+int HT_map_find(HT_Map* map, char* key) {
+    int value = 0;
+    HT_map_get_bytes(map, key, strlen(key), &value);
+    return value;
+}
+
+/**
+ * @brief Unmap a snapshot opened with `HT_open_mmap`.
+ *
+ * @param map - The snapshot to close.
+ */
+void HT_map_close(HT_Map* map) {
+    munmap(map->base, map->length);
+    free(map);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file snapshot.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for pointer-free snapshots of hash tables,
+ * written once and served read-only straight from a memory-mapped file.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HT_SNAPSHOT_MAGIC "HTSNAP\0\0"
+#define HT_SNAPSHOT_VERSION 1
+// Written in the byte order of the machine saving the snapshot, so a
+// snapshot from a machine of the other byte order is rejected.
+#define HT_SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/**
+ * The start of a snapshot file. Every section is addressed by its offset
+ * from the start of the file, so the image can be mapped anywhere.
+ */
+struct HT_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t seed; // Seed of `HT_hash_bytes` used for every stored hash.
+    uint64_t capacity; // Amount of buckets, a power of two.
+    uint64_t size; // Amount of entries.
+    // Offsets of the sections: `capacity + 1` bucket starts, then `size`
+    // entries sorted by bucket, then the key bytes.
+    uint64_t starts_offset;
+    uint64_t entries_offset;
+    uint64_t keys_offset;
+};
+
+struct HT_snapshot_entry {
+    uint64_t hash;
+    uint64_t key_offset; // From the start of the key bytes.
+    uint32_t key_len;
+    int32_t value;
+};
+
+struct HT_map {
+    void* base; // The mapped file.
+    size_t length;
+    const struct HT_snapshot_header * header;
+    const uint64_t * starts; // Bucket `i` holds entries `starts[i]` to `starts[i + 1]`.
+    const struct HT_snapshot_entry * entries;
+    const unsigned char * keys;
+    size_t key_bytes; // Length of the key section, including padding.
+};
+
+struct HT_ht;
+
+typedef struct HT_snapshot_header HT_Snapshot_header;
+typedef struct HT_snapshot_entry HT_Snapshot_entry;
+typedef struct HT_map HT_Map;
+
+int HT_save(struct HT_ht * h_table, const char* path);
+HT_Map* HT_open_mmap(const char* path);
+int HT_map_check(HT_Map* map, char* key);
+int HT_map_find(HT_Map* map, char* key);
+int HT_map_get_bytes(HT_Map* map, const void* key, size_t len, int* out);
+void HT_map_close(HT_Map* map);
@@ -0,0 +1,337 @@
+/**
+ * @file swiss_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief A Swiss-table style implementation of hash tables in C. Every
+ * slot has a one-byte control tag holding 7 bits of its key's hash, and
+ * tags are probed a whole group at a time with a single SIMD comparison,
+ * so keys are only read for slots whose tag already matches.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "swiss_table.h"
+
+#if defined(ST_FORCE_SCALAR)
+#define ST_SCALAR
+#elif defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#else
+#define ST_SCALAR
+#endif
+
+// Control tag of a slot that has never been used. Stops probing.
+#define ST_EMPTY 0x80
+// Control tag of a slot whose key was removed. Probing continues past it.
+#define ST_DELETED 0xFE
+// The table is rehashed once more than ST_MAX_LOAD / 8 of its slots are used.
+#define ST_MAX_LOAD 7
+
+// A mask with one bit per slot of a group, set for the slots that matched.
+typedef uint32_t ST_Mask;
+
+/**
+ * @brief Compare every control tag of a group against the provided tag.
+ *
+ * @param group - The first control tag of the group.
+ * @param tag - The tag to look for.
+ * @return ST_Mask - The slots of the group whose tag is equal to `tag`.
+ */
+ST_Mask _ST_match(const uint8_t* group, uint8_t tag) {
+#if defined(ST_SCALAR)
+    ST_Mask mask = 0;
+    for (int i = 0; i < ST_GROUP_WIDTH; i++)
+        mask |= (ST_Mask) (group[i] == tag) << i;
+    return mask;
+#elif defined(__AVX2__)
+    __m256i ctrl = _mm256_loadu_si256((const __m256i*) group);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(tag)));
+#elif defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+#else
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t eq = vceqq_u8(vld1q_u8(group), vdupq_n_u8(tag));
+    uint8x16_t masked = vandq_u8(eq, vld1q_u8(bits));
+    return vaddv_u8(vget_low_u8(masked)) | ((ST_Mask) vaddv_u8(vget_high_u8(masked)) << 8);
+#endif
+}
+
+/**
+ * @brief Find the slots of a group that are free, whether they are
+ * empty or deleted. Both markers have their high bit set, while the
+ * tag of a full slot never does.
+ *
+ * @param group - The first control tag of the group.
+ * @return ST_Mask - The free slots of the group.
+ */
+ST_Mask _ST_match_free(const uint8_t* group) {
+#if defined(ST_SCALAR)
+    ST_Mask mask = 0;
+    for (int i = 0; i < ST_GROUP_WIDTH; i++)
+        mask |= (ST_Mask) (group[i] >> 7) << i;
+    return mask;
+#elif defined(__AVX2__)
+    return _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*) group));
+#elif defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t high = vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(group)), vdupq_n_s8(0));
+    uint8x16_t masked = vandq_u8(high, vld1q_u8(bits));
+    return vaddv_u8(vget_low_u8(masked)) | ((ST_Mask) vaddv_u8(vget_high_u8(masked)) << 8);
+#endif
+}
+
+/**
+ * @brief Name the instruction set the group comparisons were compiled for.
+ *
+ * @return const char* - "avx2", "sse2", "neon" or "scalar".
+ */
+const char* ST_simd_name(void) {
+#if defined(ST_SCALAR)
+    return "scalar";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "neon";
+#endif
+}
+
+/**
+ * @brief Extract the control tag of a hash. The remaining bits pick
+ * the group probing starts from.
+ *
+ * @param hash - The full hash of a key.
+ * @return uint8_t - The tag, between 0 and 127.
+ */
+uint8_t _ST_tag(uint64_t hash) {
+    return hash & 0x7F;
+}
+
+/**
+ * @brief Allocate the control tags and slots of a table. Every
+ * slot starts empty.
+ *
+ * @param s_table - The table to allocate for.
+ * @param capacity - The amount of slots to allocate.
+ */
+void _ST_alloc(ST_Ht* s_table, size_t capacity) {
+    s_table->capacity = capacity;
+    s_table->size = 0;
+    s_table->deleted = 0;
+    s_table->ctrl = malloc(capacity);
+    memset(s_table->ctrl, ST_EMPTY, capacity);
+    s_table->slots = malloc(sizeof(ST_Slot) * capacity);
+}
+
+/**
+ * @brief Initializer function for the Swiss table.
+ *
+ * @param size - The initial capacity of the table. It is rounded up
+ * to a power-of-two amount of groups, and the table grows on its own
+ * as keys are added.
+ * @return ST_Ht* - The created table.
+ */
+ST_Ht* ST_create(size_t size) {
+    size_t capacity = ST_GROUP_WIDTH;
+    while (capacity < size)
+        capacity *= 2;
+    ST_Ht* s_table = malloc(sizeof(ST_Ht));
+    _ST_alloc(s_table, capacity);
+    return s_table;
+}
+
+/**
+ * @brief Find the first free slot along the probe sequence of a hash.
+ * Groups are visited in triangular order, which reaches every group
+ * once since the amount of groups is a power of two.
+ *
+ * @param s_table - The table to search.
+ * @param hash - The full hash of the key to place.
+ * @return size_t - The index of the free slot.
+ */
+size_t _ST_find_free(ST_Ht* s_table, uint64_t hash) {
+    size_t group_mask = s_table->capacity / ST_GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t probe = 1;; probe++) {
+        ST_Mask free_slots = _ST_match_free(s_table->ctrl + group * ST_GROUP_WIDTH);
+        if (free_slots)
+            return group * ST_GROUP_WIDTH + __builtin_ctz(free_slots);
+        group = (group + probe) & group_mask;
+    }
+}
+
+/**
+ * @brief Rebuild the table with the provided capacity, dropping every
+ * tombstone. Stored hashes are reused so no key is hashed again.
+ *
+ * @param s_table - The table to rebuild.
+ * @param capacity - The new amount of slots.
+ */
+void _ST_rehash(ST_Ht* s_table, size_t capacity) {
+    uint8_t* old_ctrl = s_table->ctrl;
+    ST_Slot* old_slots = s_table->slots;
+    size_t old_capacity = s_table->capacity;
+    size_t size = s_table->size;
+    _ST_alloc(s_table, capacity);
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] & 0x80) continue;
+        size_t index = _ST_find_free(s_table, old_slots[i].hash);
+        s_table->ctrl[index] = old_ctrl[i];
+        s_table->slots[index] = old_slots[i];
+    }
+    s_table->size = size;
+    free(old_ctrl);
+    free(old_slots);
+}
+
+/**
+ * @brief Find the slot holding the provided key. Each group is filtered
+ * by comparing its tags against the key's tag in one instruction; the
+ * search ends at the first group that still has an empty slot.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @param hash - The full hash of the key.
+ * @return long - The index of the key's slot, or -1 if not found.
+ */
+long _ST_lookup(ST_Ht* s_table, char* key, uint64_t hash) {
+    size_t group_mask = s_table->capacity / ST_GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & group_mask;
+    uint8_t tag = _ST_tag(hash);
+    for (size_t probe = 1; probe <= group_mask + 1; probe++) {
+        const uint8_t* ctrl = s_table->ctrl + group * ST_GROUP_WIDTH;
+        for (ST_Mask match = _ST_match(ctrl, tag); match; match &= match - 1) {
+            size_t index = group * ST_GROUP_WIDTH + __builtin_ctz(match);
+            ST_Slot* slot = &(s_table->slots[index]);
+            if (slot->hash == hash && !strcmp(slot->key, key))
+                return index;
+        }
+        if (_ST_match(ctrl, ST_EMPTY))
+            return -1;
+        group = (group + probe) & group_mask;
+    }
+    return -1;
+}
+
+/**
+ * @brief Add a key-value pair to the table. Adding a key that already
+ * exists replaces its value.
+ *
+ * @param s_table - The table to add to.
+ * @param key - The key to be added.
+ * @param value - The value to be added.
+ */
+void ST_add(ST_Ht* s_table, char* key, int value) {
+    uint64_t hash = HT_hash_key(key);
+    long found = _ST_lookup(s_table, key, hash);
+    if (found >= 0) {
+        s_table->slots[found].value = value;
+        return;
+    }
+    if ((s_table->size + s_table->deleted + 1) * 8 > s_table->capacity * ST_MAX_LOAD) {
+        // Only grow if live keys fill the table; otherwise clearing
+        // the tombstones is enough.
+        size_t capacity = s_table->capacity;
+        if ((s_table->size + 1) * 16 > capacity * ST_MAX_LOAD)
+            capacity *= 2;
+        _ST_rehash(s_table, capacity);
+    }
+    size_t index = _ST_find_free(s_table, hash);
+    if (s_table->ctrl[index] == ST_DELETED)
+        s_table->deleted--;
+    size_t len = strlen(key);
+    s_table->ctrl[index] = _ST_tag(hash);
+    s_table->slots[index].hash = hash;
+    s_table->slots[index].key = malloc(sizeof(char) * (len + 1));
+    memcpy(s_table->slots[index].key, key, len + 1);
+    s_table->slots[index].value = value;
+    s_table->size++;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists
+ * within the table.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int ST_check(ST_Ht* s_table, char* key) {
+    return _ST_lookup(s_table, key, HT_hash_key(key)) >= 0;
+}
+
+/**
+ * @brief Find the value of the provided key. NOTE: Assumes the key
+ * exists within the table. Use `ST_check` if unsure.
+ *
+ * @param s_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the provided key, or 0 if it is missing.
+ */
+int ST_find(ST_Ht* s_table, char* key) {
+    long index = _ST_lookup(s_table, key, HT_hash_key(key));
+    return index >= 0 ? s_table->slots[index].value : 0;
+}
+
+/**
+ * @brief Change the value of an existing key. Does nothing if the key
+ * is missing.
+ *
+ * @param s_table - The table to change.
+ * @param key - The key of the value to change.
+ * @param value - The new value.
+ */
+void ST_change(ST_Ht* s_table, char* key, int value) {
+    long index = _ST_lookup(s_table, key, HT_hash_key(key));
+    if (index >= 0)
+        s_table->slots[index].value = value;
+}
+
+/**
+ * @brief Remove a key-value pair from the table. The slot becomes empty
+ * again if its group still has an empty slot, since no probe could have
+ * gone past that group; otherwise it is marked as deleted. Does nothing
+ * if the key is missing.
+ *
+ * @param s_table - The table to remove from.
+ * @param key - The key of the key-value pair to be removed.
+ */
+void ST_remove(ST_Ht* s_table, char* key) {
+    long index = _ST_lookup(s_table, key, HT_hash_key(key));
+    if (index < 0) return;
+    const uint8_t* group = s_table->ctrl + (index / ST_GROUP_WIDTH) * ST_GROUP_WIDTH;
+    free(s_table->slots[index].key);
+    if (_ST_match(group, ST_EMPTY)) {
+        s_table->ctrl[index] = ST_EMPTY;
+    } else {
+        s_table->ctrl[index] = ST_DELETED;
+        s_table->deleted++;
+    }
+    s_table->size--;
+}
+
+/**
+ * @brief Destroy the provided table and every key it owns.
+ *
+ * @param s_table - The table to destroy.
+ */
+void ST_destroy(ST_Ht* s_table) {
+    for (size_t i = 0; i < s_table->capacity; i++) {
+        if (!(s_table->ctrl[i] & 0x80))
+            free(s_table->slots[i].key);
+    }
+    free(s_table->ctrl);
+    free(s_table->slots);
+    free(s_table);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file swiss_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for an open-addressing hash table that
+ * probes groups of one-byte control tags with SIMD instructions.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The amount of control tags compared by a single instruction. Picked at
+// compile time from the instruction sets the compiler targets.
+#if defined(__AVX2__) && !defined(ST_FORCE_SCALAR)
+#define ST_GROUP_WIDTH 32
+#else
+#define ST_GROUP_WIDTH 16
+#endif
+
+struct ST_slot {
+    uint64_t hash; // Full hash of the key, so growing never rehashes a key.
+    char* key;
+    int value;
+};
+
+struct ST_ht {
+    size_t capacity; // A power-of-two multiple of ST_GROUP_WIDTH.
+    size_t size;
+    size_t deleted; // Amount of tombstones left by removals.
+    // One control tag per slot: the low 7 bits of the key's hash for a
+    // full slot, or one of the empty/deleted markers.
+    uint8_t * ctrl;
+    struct ST_slot * slots;
+};
+
+typedef struct ST_slot ST_Slot;
+typedef struct ST_ht ST_Ht;
+
+ST_Ht* ST_create(size_t size);
+void ST_add(ST_Ht* s_table, char* key, int value);
+int ST_check(ST_Ht* s_table, char* key);
+int ST_find(ST_Ht* s_table, char* key);
+void ST_change(ST_Ht* s_table, char* key, int value);
+void ST_remove(ST_Ht* s_table, char* key);
+void ST_destroy(ST_Ht* s_table);
+const char* ST_simd_name(void);
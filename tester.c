@@ -9,15 +9,50 @@
  * 
  */
 #include "./hash_table.h"
+#include "./robin_hood.h"
+#include "./arena.h"
+#include "./swiss_table.h"
+#include "./concurrent_table.h"
+#include "./generic_table.h"
+#include "./snapshot.h"
+#include "./frozen_table.h"
+#include "./cuckoo_table.h"
+#include "./sharded_table.h"
+#include "./versioned_table.h"
+#include "./ingest.h"
+#include "./ordered_index.h"
+#include "./numa_placement.h"
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
 
 /* The maximum data value. */
 #define MAX_VALUE 100
 
+/* A 16-byte payload stored inline in the generic tables. */
+struct gt_payload {
+    uint64_t id;
+    double score;
+};
+
+/**
+ * @brief Send every key to the last slot of the table, so that keys form
+ * a single run wrapping around to the first slots, and removals must
+ * shift the whole run across the end.
+ */
+static uint64_t _gt_last_slot_hash(int key) {
+    (void) key;
+    return UINT64_MAX;
+}
+
+GT_DECLARE(GT_u64, uint64_t, struct gt_payload)
+GT_DEFINE(GT_u64, uint64_t, struct gt_payload, GT_hash_int, GT_equal)
+GT_DECLARE(GT_int, int, int)
+GT_DEFINE(GT_int, int, int, _gt_last_slot_hash, GT_equal)
+
 // ================
 // HELPER FUNCTIONS
 // ================
@@ -227,18 +262,51 @@ int test_hash(void) {
         }
     }
     // Changing one letter should dramatically alter
-    // the output, resulting in a different index.
+    // the output, resulting in a different hash.
     for (int i = 0; i < ATTEMPTS; i++) {
-        int index1 = HT_hash(keys[i], HASH_SIZE);
+        uint64_t hash1 = HT_hash_key(keys[i]);
         char* key = keys[i];
         key[10]++;
-        int index2 = HT_hash(keys[i], HASH_SIZE);
-        // Changing a letter should produce different indices.
-        CU_ASSERT(index1 != index2);
+        uint64_t hash2 = HT_hash_key(keys[i]);
+        // Changing a letter should produce different hashes.
+        CU_ASSERT(hash1 != hash2);
+        // Both halves of the hash should change, not only the low bits.
+        CU_ASSERT((hash1 >> 32) != (hash2 >> 32));
     }
     _destroy_keys(keys, ATTEMPTS);
 }
 
+/**
+ * @brief Testing the pluggable hash functions. Seeds must change the
+ * produced hashes, and a table must keep working with any hash function,
+ * even one that sends every key to the same bucket.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_hash_seed(void) {
+    const int AMOUNT_KEYS = 50;
+    const int KEY_SIZE = 30;
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_hash_bytes(keys[i], KEY_SIZE, 1) != HT_hash_bytes(keys[i], KEY_SIZE, 2));
+        CU_ASSERT(HT_hash_bytes(keys[i], KEY_SIZE, 0) == HT_hash_key(keys[i]));
+    }
+    HT_Ht* h_table = HT_create(10);
+    CU_ASSERT(h_table->capacity == 16); // Rounded up to a power of two.
+    CU_ASSERT(HT_set_hash(h_table, HT_hash_kr, HT_random_seed()));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    // The hash function cannot change once keys are stored.
+    CU_ASSERT(!HT_set_hash(h_table, NULL, 0));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == i);
+    }
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
 /**
  * @brief Adds and removes from a random hash
  * table.
@@ -311,6 +379,669 @@ int test_remove(void) {
     _destroy_random_ht(ht_rand);
 }
 
+/**
+ * @brief A hash function sending every key to the same bucket, used
+ * to build a single long chain.
+ */
+uint64_t _constant_hash(const void* key, size_t len, uint64_t seed) {
+    return 0;
+}
+
+/* The amount of calls to `_counting_hash`. */
+static atomic_int hash_calls;
+
+/**
+ * @brief The default hash function, counting its calls.
+ */
+static uint64_t _counting_hash(const void* key, size_t len, uint64_t seed) {
+    atomic_fetch_add(&hash_calls, 1);
+    return HT_hash_bytes(key, len, seed);
+}
+
+/* The time given by `_fake_clock`, moved forward by the tests. */
+uint32_t fake_time = 1;
+
+/**
+ * @brief A clock under the control of the tests, for times to live.
+ */
+uint32_t _fake_clock(void) {
+    return fake_time;
+}
+
+/**
+ * @brief Testing removals from a single chain. Removing the head of a
+ * bucket must keep the rest of the bucket, and removing a key that does
+ * not exist must be safe and report that nothing was removed.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_remove_chain(void) {
+    const int AMOUNT_KEYS = 20;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(4);
+    HT_set_hash(h_table, _constant_hash, 0);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    // The newest key is the head of the only bucket.
+    CU_ASSERT(HT_remove(h_table, keys[AMOUNT_KEYS - 1]));
+    CU_ASSERT(!HT_remove(h_table, keys[AMOUNT_KEYS - 1]));
+    for (int i = 0; i < AMOUNT_KEYS - 1; i++) {
+        CU_ASSERT(HT_check(h_table, keys[i]));
+    }
+    // Remove the rest from the middle of the chain outwards.
+    for (int i = AMOUNT_KEYS / 2; i < AMOUNT_KEYS - 1; i++) {
+        CU_ASSERT(HT_remove(h_table, keys[i]));
+    }
+    for (int i = 0; i < AMOUNT_KEYS / 2; i++) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == i);
+        CU_ASSERT(HT_remove(h_table, keys[i]));
+    }
+    CU_ASSERT(h_table->size == 0);
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * @brief Testing a degenerate table holding every key in one chain.
+ * Lookups, removals and teardown must walk the chain in a loop, since a
+ * call frame per node would overflow the stack.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_long_chain(void) {
+    const int AMOUNT_KEYS = 200000;
+    HT_Ht* h_table = HT_create(1);
+    HT_set_hash(h_table, _constant_hash, 0);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add_bytes(h_table, &i, sizeof(i), i);
+    }
+    int first = 0, last = AMOUNT_KEYS - 1, missing = AMOUNT_KEYS;
+    // The oldest key sits at the far end of the chain.
+    CU_ASSERT(HT_check_bytes(h_table, &first, sizeof(first)));
+    CU_ASSERT(HT_find_bytes(h_table, &first, sizeof(first)) == 0);
+    CU_ASSERT(!HT_check_bytes(h_table, &missing, sizeof(missing)));
+    CU_ASSERT(HT_remove_bytes(h_table, &first, sizeof(first)));
+    CU_ASSERT(HT_remove_bytes(h_table, &last, sizeof(last)));
+    CU_ASSERT(h_table->size == AMOUNT_KEYS - 2);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing the hashes and lengths cached in nodes. Every node must
+ * hold the full hash and the length of its key, keys are hashed once when
+ * added and never again by rehashes, and keys sharing a hash or a length
+ * must still be told apart by their bytes.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_node_cache(void) {
+    const int AMOUNT_KEYS = 1000;
+    const uint64_t SEED = 42;
+    char key[64];
+    HT_Ht* h_table = HT_create(4);
+    HT_set_hash(h_table, _counting_hash, SEED);
+    atomic_store(&hash_calls, 0);
+    // Lengths run past `HT_INLINE_KEY`, so some keys live outside their node.
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        int len = snprintf(key, sizeof(key), "%0*d", 1 + i % 40, i);
+        HT_add(h_table, key, len);
+    }
+    // Growing the table many times over rehashed every key without it.
+    CU_ASSERT(h_table->capacity >= AMOUNT_KEYS);
+    CU_ASSERT(atomic_load(&hash_calls) == AMOUNT_KEYS);
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    int nodes = 0;
+    for (HT_Node* node; (node = HT_iter_next(&iter));) {
+        CU_ASSERT(node->key_len == strlen((char*) node->key) && (int) node->key_len == node->value);
+        CU_ASSERT(node->hash == HT_hash_bytes(node->key, node->key_len, SEED));
+        nodes++;
+    }
+    HT_iter_release(&iter);
+    CU_ASSERT(nodes == AMOUNT_KEYS);
+    atomic_store(&hash_calls, 0);
+    CU_ASSERT(HT_resize_parallel(h_table, 4 * h_table->capacity, 2));
+    CU_ASSERT(atomic_load(&hash_calls) == 0);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        int len = snprintf(key, sizeof(key), "%0*d", 1 + i % 40, i);
+        CU_ASSERT(HT_find(h_table, key) == len);
+    }
+    CU_ASSERT(atomic_load(&hash_calls) == AMOUNT_KEYS);
+    HT_destroy(h_table);
+
+    // Colliding keys of the same length differ only by their bytes, and
+    // keys that are prefixes of each other only by their length.
+    h_table = HT_create(1);
+    HT_set_hash(h_table, _constant_hash, 0);
+    HT_add(h_table, "abcd", 1);
+    HT_add(h_table, "abce", 2);
+    HT_add(h_table, "abc", 3);
+    HT_add_bytes(h_table, "abc", 4, 4); // The null character included.
+    CU_ASSERT(HT_find(h_table, "abcd") == 1 && HT_find(h_table, "abce") == 2);
+    CU_ASSERT(HT_find(h_table, "abc") == 3 && HT_find_bytes(h_table, "abc", 4) == 4);
+    CU_ASSERT(!HT_check(h_table, "abcf") && !HT_check(h_table, "ab"));
+    CU_ASSERT(HT_remove(h_table, "abce") && HT_find(h_table, "abcd") == 1);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing the summary of a table. The chain-length histogram must
+ * account for every bucket and every key, and a degenerate table must
+ * show up as one long chain.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_stats(void) {
+    const int AMOUNT_KEYS = 1000;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    HT_check(h_table, keys[0]);
+    HT_Stats stats;
+    HT_stats(h_table, &stats);
+    CU_ASSERT(stats.size == AMOUNT_KEYS);
+    size_t buckets = 0, counted = 0;
+    for (int i = 0; i < HT_STATS_CHAINS; i++) {
+        buckets += stats.chains[i];
+        counted += i * stats.chains[i];
+    }
+    CU_ASSERT(buckets == stats.buckets);
+    CU_ASSERT(stats.max_chain >= HT_STATS_CHAINS || counted == AMOUNT_KEYS);
+    CU_ASSERT(stats.load_factor == (double) AMOUNT_KEYS / stats.buckets);
+    CU_ASSERT(stats.empty_ratio == (double) stats.chains[0] / stats.buckets);
+    CU_ASSERT(stats.mean_probes >= 1 && stats.mean_probes < 2);
+    CU_ASSERT(stats.node_bytes == AMOUNT_KEYS * sizeof(HT_Node));
+    CU_ASSERT(stats.key_bytes == AMOUNT_KEYS * (KEY_SIZE + 1));
+    CU_ASSERT(stats.bucket_bytes >= stats.buckets * sizeof(HT_Node*));
+#ifdef HT_STATS_COUNTERS
+    CU_ASSERT(stats.hits == 1 && stats.misses == 0 && stats.resizes > 0);
+#else
+    CU_ASSERT(stats.hits == 0 && stats.misses == 0 && stats.resizes == 0);
+#endif
+    HT_destroy(h_table);
+
+    const int CHAIN = 20;
+    h_table = HT_create(4);
+    HT_set_hash(h_table, _constant_hash, 0);
+    for (int i = 0; i < CHAIN; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    HT_stats(h_table, &stats);
+    CU_ASSERT(stats.max_chain == CHAIN);
+    CU_ASSERT(stats.chains[HT_STATS_CHAINS - 1] == 1);
+    CU_ASSERT(stats.mean_probes == (CHAIN + 1) / 2.0);
+    CU_ASSERT(stats.empty_ratio == (double) (stats.buckets - 1) / stats.buckets);
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * @brief Testing the single-lookup access functions. `HT_get` and
+ * `HT_get_ptr` must report missing keys instead of crashing, and
+ * `HT_upsert` must add missing keys and replace existing values.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_get_upsert(void) {
+    const int AMOUNT_KEYS = 50;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(8);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_upsert(h_table, keys[i], i));
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!HT_upsert(h_table, keys[i], i + 1));
+    }
+    CU_ASSERT(h_table->size == AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        int value = -1;
+        CU_ASSERT(HT_get(h_table, keys[i], &value));
+        CU_ASSERT(value == i + 1);
+        int* slot = HT_get_ptr(h_table, keys[i]);
+        CU_ASSERT(slot && *slot == i + 1);
+        *slot = i * 3;
+        CU_ASSERT(HT_find(h_table, keys[i]) == i * 3);
+        CU_ASSERT(!HT_get(h_table, nonexistent_keys[i], &value));
+        CU_ASSERT(value == i + 1); // Left untouched.
+        CU_ASSERT(HT_get_ptr(h_table, nonexistent_keys[i]) == NULL);
+        CU_ASSERT(!HT_remove(h_table, nonexistent_keys[i]));
+    }
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    free(keys);
+    free(nonexistent_keys);
+}
+
+/**
+ * @brief Testing cache mode. Keys must expire lazily on lookup and through
+ * sweeps, limits on entries and bytes must hold through inserts, the
+ * eviction hand must spare recently read keys, and nothing may be evicted
+ * while an iterator walks the table.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_cache(void) {
+    const int AMOUNT_KEYS = 200;
+    const int KEY_SIZE = 10;
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    HT_Ht* h_table = HT_create(4);
+    HT_set_clock(h_table, _fake_clock);
+    fake_time = 100;
+    CU_ASSERT(HT_upsert_ttl(h_table, keys[0], 1, 10));
+    CU_ASSERT(HT_upsert_ttl(h_table, keys[1], 2, 0));
+    CU_ASSERT(!HT_upsert_ttl(h_table, keys[1], 3, 0));
+    fake_time = 109;
+    CU_ASSERT(HT_check(h_table, keys[0]) && HT_find(h_table, keys[1]) == 3);
+    fake_time = 110;
+    CU_ASSERT(!HT_check(h_table, keys[0]) && HT_find(h_table, keys[0]) == 0);
+    CU_ASSERT(h_table->size == 1);
+    CU_ASSERT(HT_set_ttl(h_table, keys[1], 5));
+    CU_ASSERT(!HT_set_ttl(h_table, keys[0], 5));
+    fake_time = 115;
+    int value;
+    CU_ASSERT(!HT_get(h_table, keys[1], &value) && h_table->size == 0);
+    // Deadlines past the end of the clock stop at its last second.
+    fake_time = UINT32_MAX - 5;
+    CU_ASSERT(HT_upsert_ttl(h_table, keys[0], 1, 10));
+    CU_ASSERT(HT_upsert_ttl(h_table, keys[1], 2, 10));
+    CU_ASSERT(HT_set_ttl(h_table, keys[1], UINT32_MAX));
+    fake_time = UINT32_MAX - 1;
+    CU_ASSERT(HT_check(h_table, keys[0]) && HT_check(h_table, keys[1]));
+    fake_time = UINT32_MAX;
+    CU_ASSERT(!HT_check(h_table, keys[0]) && !HT_check(h_table, keys[1]));
+    fake_time = 115;
+
+    // Keys that are never read again expire through sweeps.
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_upsert_ttl(h_table, keys[i], i, i % 2 ? 0 : 5);
+    }
+    fake_time = 120;
+    uint64_t cursor = 0;
+    do {
+        cursor = HT_sweep(h_table, cursor);
+    } while (cursor);
+    CU_ASSERT(h_table->size == AMOUNT_KEYS / 2);
+    for (int i = 1; i < AMOUNT_KEYS; i += 2) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == i);
+    }
+    HT_set_limit(h_table, AMOUNT_KEYS / 4, 0);
+    CU_ASSERT(h_table->size == AMOUNT_KEYS / 4);
+    HT_destroy(h_table);
+
+    // Keys read since the hand last passed are evicted last.
+    const int LIMIT = AMOUNT_KEYS / 2;
+    h_table = HT_create(4);
+    HT_set_limit(h_table, LIMIT, 0);
+    for (int i = 0; i < LIMIT; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    for (int i = 0; i < LIMIT; i += 2) {
+        CU_ASSERT(HT_check(h_table, keys[i]));
+    }
+    for (int i = LIMIT; i < LIMIT + LIMIT / 2; i++) {
+        HT_add(h_table, keys[i], i);
+        CU_ASSERT(h_table->size == LIMIT && HT_check(h_table, keys[i]));
+    }
+    for (int i = 0; i < LIMIT; i += 2) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == i);
+    }
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    HT_add(h_table, keys[AMOUNT_KEYS - 1], 0);
+    CU_ASSERT(h_table->size == LIMIT + 1);
+    HT_iter_release(&iter);
+    HT_add(h_table, keys[AMOUNT_KEYS - 2], 0);
+    CU_ASSERT(h_table->size == LIMIT);
+    HT_destroy(h_table);
+
+    const size_t MAX_BYTES = 10 * sizeof(HT_Node);
+    h_table = HT_create(4);
+    HT_set_limit(h_table, 0, MAX_BYTES);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+        CU_ASSERT(h_table->bytes <= MAX_BYTES);
+    }
+    CU_ASSERT(h_table->size == 10 && h_table->bytes == MAX_BYTES);
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * @brief Testing binary keys of explicit length. Keys containing null
+ * bytes and keys that are prefixes of each other must stay distinct,
+ * and only keys too long to fit in their node may be stored outside it.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_binary_keys(void) {
+    const int AMOUNT_KEYS = 500;
+    const size_t KEY_SIZE = 40;
+    for (int arena = 0; arena < 2; arena++) {
+        HT_Ht* h_table = HT_create(4);
+        if (arena) HT_use_arena(h_table);
+        unsigned char key[40] = {0};
+        // Every prefix of the same null-filled buffer is a different key.
+        for (size_t len = 0; len < KEY_SIZE; len++) {
+            HT_add_bytes(h_table, key, len, (int) len);
+        }
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            int id = i + 1;
+            memset(key, 0, sizeof(key));
+            memcpy(key + 4, &id, sizeof(id));
+            HT_add_bytes(h_table, key, 16, i + 1000);
+        }
+        CU_ASSERT(h_table->size == KEY_SIZE + AMOUNT_KEYS);
+        memset(key, 0, sizeof(key));
+        for (size_t len = 0; len < KEY_SIZE; len++) {
+            CU_ASSERT(HT_find_bytes(h_table, key, len) == (int) len);
+        }
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            int id = i + 1;
+            memset(key, 0, sizeof(key));
+            memcpy(key + 4, &id, sizeof(id));
+            CU_ASSERT(HT_check_bytes(h_table, key, 16));
+            CU_ASSERT(!HT_check_bytes(h_table, key, 17 + i % 4));
+            int value = -1;
+            CU_ASSERT(HT_get_bytes(h_table, key, 16, &value) && value == i + 1000);
+        }
+        for (int x = 0; x < h_table->capacity; x++) {
+            for (HT_Node* node = h_table->nodes[x]; node; node = node->next) {
+                CU_ASSERT((node->key == node->inline_key) == (node->key_len < HT_INLINE_KEY));
+            }
+        }
+        // Removed nodes are reused by keys of the other kind under an arena.
+        memset(key, 0, sizeof(key));
+        for (size_t len = 0; len < KEY_SIZE; len++) {
+            CU_ASSERT(HT_remove_bytes(h_table, key, len));
+            CU_ASSERT(!HT_check_bytes(h_table, key, len));
+        }
+        CU_ASSERT(!HT_remove_bytes(h_table, key, 1));
+        for (size_t len = 0; len < KEY_SIZE; len++) {
+            memset(key, 'a' + len % 26, sizeof(key));
+            HT_add_bytes(h_table, key, KEY_SIZE - 1 - len, (int) len);
+        }
+        for (size_t len = 0; len < KEY_SIZE; len++) {
+            memset(key, 'a' + len % 26, sizeof(key));
+            CU_ASSERT(HT_find_bytes(h_table, key, KEY_SIZE - 1 - len) == (int) len);
+        }
+        // Text keys share storage with binary keys of the same bytes.
+        CU_ASSERT(HT_check(h_table, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+        HT_destroy(h_table);
+    }
+}
+
+/**
+ * @brief Check that the occupancy bitmap of a table matches its buckets.
+ * 
+ * @param h_table - The table to check.
+ * @return int - 1 if every bit matches, 0 otherwise.
+ */
+int _bitmap_matches(HT_Ht* h_table) {
+    for (unsigned int x = 0; x < h_table->capacity; x++) {
+        if (!!(h_table->occupied[x >> 6] & (1ull << (x & 63))) != !!h_table->nodes[x])
+            return 0;
+    }
+    for (unsigned int x = 0; h_table->old_nodes && x < h_table->old_capacity; x++) {
+        if (!!(h_table->old_occupied[x >> 6] & (1ull << (x & 63))) != !!h_table->old_nodes[x])
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Count a visit of a scanned node, indexed by its value.
+ */
+void _count_visit(HT_Node* node, void* data) {
+    ((int*) data)[node->value]++;
+}
+
+/**
+ * @brief Testing iterators and scans. An iterator must return every key
+ * once, even when keys are removed along the way, and a scan must visit
+ * every key that exists for its whole duration while the table grows
+ * and shrinks between calls.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_iter_scan(void) {
+    const int AMOUNT_KEYS = 4000;
+    const int INITIAL_KEYS = 1000;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(1);
+    HT_set_shrink(h_table, 1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* seen = calloc(AMOUNT_KEYS, sizeof(int));
+    for (int i = 0; i < INITIAL_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    CU_ASSERT(_bitmap_matches(h_table));
+
+    // Walk the table, removing every other key as it is returned.
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    for (HT_Node* node = HT_iter_next(&iter); node; node = HT_iter_next(&iter)) {
+        seen[node->value]++;
+        if (node->value % 2)
+            HT_remove(h_table, keys[node->value]);
+    }
+    HT_iter_release(&iter);
+    for (int i = 0; i < INITIAL_KEYS; i++) {
+        CU_ASSERT(seen[i] == 1);
+        CU_ASSERT(HT_check(h_table, keys[i]) == !(i % 2));
+    }
+    CU_ASSERT(_bitmap_matches(h_table));
+
+    // Scan the even keys while the table grows with new keys, and then
+    // shrinks as they are removed again.
+    memset(seen, 0, sizeof(int) * AMOUNT_KEYS);
+    uint64_t cursor = 0;
+    int added = INITIAL_KEYS, removed = INITIAL_KEYS;
+    unsigned int max_capacity = h_table->capacity, shrunk = 0;
+    do {
+        cursor = HT_scan(h_table, cursor, _count_visit, seen);
+        for (int i = 0; i < 4 && added < AMOUNT_KEYS; i++, added++)
+            HT_add(h_table, keys[added], added);
+        for (int i = 0; added == AMOUNT_KEYS && i < 8 && removed < AMOUNT_KEYS; i++, removed++)
+            HT_remove(h_table, keys[removed]);
+        if (h_table->capacity > max_capacity) max_capacity = h_table->capacity;
+        if (h_table->capacity < max_capacity) shrunk = 1;
+    } while (cursor);
+    CU_ASSERT(max_capacity > 1024 && shrunk);
+    for (int i = 0; i < INITIAL_KEYS; i += 2) {
+        CU_ASSERT(seen[i] >= 1);
+    }
+    CU_ASSERT(_bitmap_matches(h_table));
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+    free(seen);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing snapshots. A saved table mapped back from disk must
+ * answer like the table itself, duplicate keys included, and files that
+ * are missing or not snapshots must be rejected.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+/**
+ * @brief Overwrite one 64-bit field of a saved file, to check that a
+ * corrupted header is rejected.
+ * 
+ * @param path - The file to corrupt.
+ * @param offset - The offset of the field.
+ * @param value - The value to write.
+ * @return uint64_t - The value the field held, to restore it.
+ */
+static uint64_t _corrupt_field(const char* path, long offset, uint64_t value) {
+    uint64_t old = 0;
+    FILE* file = fopen(path, "r+b");
+    fseek(file, offset, SEEK_SET);
+    if (fread(&old, sizeof(old), 1, file) != 1) old = 0;
+    fseek(file, offset, SEEK_SET);
+    fwrite(&value, sizeof(value), 1, file);
+    fclose(file);
+    return old;
+}
+
+int test_snapshot(void) {
+    const int AMOUNT_KEYS = 1000;
+    const int KEY_SIZE = 30;
+    const char* PATH = "./tmp/snapshot.bin";
+    HT_Ht* h_table = HT_create(1);
+    HT_set_hash(h_table, NULL, HT_random_seed());
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], values[i]);
+    }
+    // The newest copy of a duplicate key wins, in the table and the snapshot.
+    HT_add(h_table, keys[0], MAX_VALUE + 1);
+    unsigned char binary[8] = {1, 0, 2, 0, 3, 0, 0, 4};
+    HT_add_bytes(h_table, binary, sizeof(binary), -5);
+    CU_ASSERT(HT_save(h_table, PATH));
+
+    HT_Map* map = HT_open_mmap(PATH);
+    CU_ASSERT_FATAL(map != NULL);
+    CU_ASSERT(map->header->size == h_table->size);
+    CU_ASSERT(HT_map_find(map, keys[0]) == MAX_VALUE + 1);
+    for (int i = 1; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_map_check(map, keys[i]));
+        CU_ASSERT(HT_map_find(map, keys[i]) == HT_find(h_table, keys[i]));
+    }
+    int value = 0;
+    CU_ASSERT(HT_map_get_bytes(map, binary, sizeof(binary), &value) && value == -5);
+    CU_ASSERT(!HT_map_get_bytes(map, binary, sizeof(binary) - 1, NULL));
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!HT_map_check(map, nonexistent_keys[i]));
+    }
+    HT_map_close(map);
+
+    // Offsets and counts wrapping the bounds checks around are rejected.
+    _corrupt_field(PATH, offsetof(HT_Snapshot_header, starts_offset), UINT64_MAX - 7);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+    HT_save(h_table, PATH);
+    _corrupt_field(PATH, offsetof(HT_Snapshot_header, capacity), (uint64_t) 1 << 61);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+    HT_save(h_table, PATH);
+    _corrupt_field(PATH, offsetof(HT_Snapshot_header, size), UINT64_MAX / sizeof(HT_Snapshot_entry) + 2);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+    HT_save(h_table, PATH);
+    _corrupt_field(PATH, offsetof(HT_Snapshot_header, keys_offset), UINT64_MAX);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+
+    // An empty table saves to a valid, empty snapshot.
+    HT_Ht* empty = HT_create(1);
+    CU_ASSERT(HT_save(empty, PATH));
+    map = HT_open_mmap(PATH);
+    CU_ASSERT_FATAL(map != NULL);
+    CU_ASSERT(!HT_map_check(map, keys[0]));
+    HT_map_close(map);
+    HT_destroy(empty);
+
+    FILE* file = fopen(PATH, "wb");
+    fputs("not a snapshot of a table, just some text", file);
+    fclose(file);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+    remove(PATH);
+    CU_ASSERT(HT_open_mmap(PATH) == NULL);
+
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(nonexistent_keys);
+    free(keys);
+    free(values);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing frozen tables. Every key of the source table must be
+ * found with its newest value, missing keys must be rejected, the index
+ * must stay within a few bits per key, and a saved table mapped back
+ * from disk must answer the same.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_frozen(void) {
+    const int AMOUNT_KEYS = 20000;
+    const int KEY_SIZE = 20;
+    const char* PATH = "./tmp/frozen.bin";
+    HT_Ht* h_table = HT_create(1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    HT_add(h_table, keys[0], -1);
+    FT_Ht* f_table = HT_freeze(h_table);
+    CU_ASSERT_FATAL(f_table != NULL);
+    CU_ASSERT(f_table->header->size == AMOUNT_KEYS);
+    const FT_Header* header = f_table->header;
+    double bits = (16.0 * header->buckets + 32.0 * (header->slots - header->size)) / header->size;
+    CU_ASSERT(bits < 5);
+    CU_ASSERT(FT_find(f_table, keys[0]) == -1);
+    for (int i = 1; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(FT_find(f_table, keys[i]) == i);
+    }
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!FT_check(f_table, nonexistent_keys[i]));
+    }
+    CU_ASSERT(FT_save(f_table, PATH));
+    FT_destroy(f_table);
+
+    f_table = FT_open_mmap(PATH);
+    CU_ASSERT_FATAL(f_table != NULL);
+    for (int i = 1; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(FT_find(f_table, keys[i]) == i);
+        CU_ASSERT(!FT_check(f_table, nonexistent_keys[i]));
+    }
+    FT_destroy(f_table);
+    // Offsets wrapping the bounds checks around are rejected.
+    const long FIELDS[] = { offsetof(FT_Header, pilots_offset), offsetof(FT_Header, remap_offset),
+                            offsetof(FT_Header, entries_offset) };
+    for (int f = 0; f < 3; f++) {
+        uint64_t old = _corrupt_field(PATH, FIELDS[f], UINT64_MAX - 7);
+        CU_ASSERT(FT_open_mmap(PATH) == NULL);
+        _corrupt_field(PATH, FIELDS[f], old);
+    }
+    f_table = FT_open_mmap(PATH);
+    CU_ASSERT(f_table != NULL);
+    FT_destroy(f_table);
+    remove(PATH);
+    CU_ASSERT(FT_open_mmap(PATH) == NULL);
+
+    // Small and empty tables freeze too.
+    HT_Ht* small = HT_create(1);
+    f_table = HT_freeze(small);
+    CU_ASSERT_FATAL(f_table != NULL);
+    CU_ASSERT(!FT_check(f_table, keys[0]));
+    FT_destroy(f_table);
+    HT_add(small, keys[0], 7);
+    f_table = HT_freeze(small);
+    CU_ASSERT_FATAL(f_table != NULL);
+    CU_ASSERT(FT_find(f_table, keys[0]) == 7 && !FT_check(f_table, keys[1]));
+    FT_destroy(f_table);
+    HT_destroy(small);
+
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(nonexistent_keys);
+    free(keys);
+    HT_destroy(h_table);
+}
+
 /**
  * @brief Testing the value of the change function. Attempts to change
  * the values of provided keys, then checks whether the keys were successfully changed
@@ -333,6 +1064,1437 @@ int test_change(void) {
     free(new_values);
 }
 
+/**
+ * @brief Testing the automatic resizing of the hash table. Keys are added
+ * well past the initial capacity and must remain reachable while the
+ * incremental rehash is in progress. Once most keys are removed, a
+ * shrinkable table must give its buckets back.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_resize(void) {
+    const int AMOUNT_KEYS = 1000;
+    const int KEY_SIZE = 30;
+    struct rand_ht* ht_rand = _random_ht(2, AMOUNT_KEYS, KEY_SIZE);
+    HT_Ht* h_table = ht_rand->h_table;
+    CU_ASSERT(h_table->size == AMOUNT_KEYS);
+    CU_ASSERT(h_table->capacity >= AMOUNT_KEYS / 2);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, ht_rand->keys[i]) == ht_rand->values[i]);
+    }
+    HT_set_shrink(h_table, 1);
+    unsigned int grown_capacity = h_table->capacity;
+    for (int i = 0; i < AMOUNT_KEYS - 10; i++) {
+        HT_remove(h_table, ht_rand->keys[i]);
+    }
+    CU_ASSERT(h_table->size == 10);
+    CU_ASSERT(h_table->capacity < grown_capacity);
+    CU_ASSERT(h_table->capacity >= 2);
+    for (int i = AMOUNT_KEYS - 10; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, ht_rand->keys[i]) == ht_rand->values[i]);
+    }
+    _destroy_random_ht(ht_rand);
+}
+
+/**
+ * @brief Testing the batched operations. Keys are added in one batch
+ * into a small table, so the batch spans several rehashes, then found
+ * and checked in batches mixing present and missing keys.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_batch(void) {
+    const int AMOUNT_KEYS = 300;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(2);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    HT_add_batch(h_table, keys, values, AMOUNT_KEYS);
+    CU_ASSERT(h_table->size == AMOUNT_KEYS);
+    // Interleave the stored keys with keys that do not exist.
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    char** mixed = malloc(sizeof(char*) * AMOUNT_KEYS * 2);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        mixed[2 * i] = keys[i];
+        mixed[2 * i + 1] = nonexistent_keys[i];
+    }
+    int* found = malloc(sizeof(int) * AMOUNT_KEYS * 2);
+    int* results = malloc(sizeof(int) * AMOUNT_KEYS * 2);
+    for (int i = 0; i < AMOUNT_KEYS * 2; i++)
+        found[i] = -1;
+    CU_ASSERT(HT_find_batch(h_table, mixed, found, AMOUNT_KEYS * 2) == AMOUNT_KEYS);
+    CU_ASSERT(HT_check_batch(h_table, mixed, results, AMOUNT_KEYS * 2) == AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(found[2 * i] == values[i]);
+        CU_ASSERT(found[2 * i + 1] == -1);
+        CU_ASSERT(results[2 * i] == 1);
+        CU_ASSERT(results[2 * i + 1] == 0);
+    }
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    free(keys);
+    free(nonexistent_keys);
+    free(mixed);
+    free(found);
+    free(results);
+    free(values);
+}
+
+/**
+ * @brief Testing bulk builds. A built table must hold the same keys and
+ * values as one filled with `HT_add`, duplicates included, each chain
+ * must be laid out contiguously, and the table must stay usable.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_build(void) {
+    const int AMOUNT_KEYS = 3000;
+    const int SHORT_KEY = 10;
+    const int LONG_KEY = 40;
+    char** short_keys = _random_keys(AMOUNT_KEYS / 2, SHORT_KEY);
+    char** long_keys = _random_keys(AMOUNT_KEYS / 2, LONG_KEY);
+    char** keys = malloc(sizeof(char*) * AMOUNT_KEYS);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    for (int i = 0; i < AMOUNT_KEYS / 2; i++) {
+        keys[2 * i] = short_keys[i];
+        keys[2 * i + 1] = long_keys[i];
+    }
+    keys[AMOUNT_KEYS - 1] = keys[0]; // A duplicate key, added last.
+    HT_Ht* built = HT_build(keys, values, AMOUNT_KEYS);
+    HT_Ht* added = HT_create(1);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(added, keys[i], values[i]);
+    }
+    CU_ASSERT(built->size == AMOUNT_KEYS);
+    CU_ASSERT(built->capacity >= AMOUNT_KEYS && !built->old_nodes);
+    CU_ASSERT(_bitmap_matches(built));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(built, keys[i]) == HT_find(added, keys[i]));
+    }
+    for (unsigned int x = 0; x < built->capacity; x++) {
+        for (HT_Node* node = built->nodes[x]; node && node->next; node = node->next) {
+            CU_ASSERT(node->next == node + 1);
+        }
+    }
+    CU_ASSERT(HT_remove(built, keys[1]));
+    HT_add(built, keys[1], -1);
+    CU_ASSERT(HT_find(built, keys[1]) == -1);
+
+    HT_Ht* empty = HT_build(NULL, NULL, 0);
+    CU_ASSERT(empty->size == 0 && !HT_check(empty, keys[0]));
+    HT_add(empty, keys[0], 1);
+    CU_ASSERT(HT_find(empty, keys[0]) == 1);
+    HT_destroy(empty);
+    HT_destroy(built);
+    HT_destroy(added);
+    _destroy_keys(short_keys, AMOUNT_KEYS / 2);
+    _destroy_keys(long_keys, AMOUNT_KEYS / 2);
+    free(short_keys);
+    free(long_keys);
+    free(keys);
+    free(values);
+}
+
+/**
+ * @brief Testing parallel builds and rehashes. A parallel build must lay
+ * out every chain exactly as `HT_build` does, and a parallel resize must
+ * finish any ongoing rehash and keep every key, duplicates included.
+ *
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_parallel(void) {
+    const int AMOUNT_KEYS = 5000;
+    const int KEY_SIZE = 30;
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    free(keys[AMOUNT_KEYS - 1]);
+    keys[AMOUNT_KEYS - 1] = keys[7]; // A duplicate key, added last.
+    HT_Ht* built = HT_build(keys, values, AMOUNT_KEYS);
+    const unsigned int THREADS[] = {2, 3, 4, 64};
+    for (int t = 0; t < 4; t++) {
+        HT_Ht* parallel = HT_build_parallel(keys, values, AMOUNT_KEYS, THREADS[t]);
+        CU_ASSERT(parallel->size == built->size && parallel->capacity == built->capacity);
+        CU_ASSERT(_bitmap_matches(parallel));
+        for (unsigned int x = 0; x < built->capacity; x++) {
+            HT_Node* node = built->nodes[x];
+            HT_Node* other = parallel->nodes[x];
+            for (; node && other; node = node->next, other = other->next) {
+                CU_ASSERT(node->value == other->value && !strcmp(node->key, other->key));
+                CU_ASSERT(!other->next || other->next == other + 1);
+            }
+            CU_ASSERT(!node && !other);
+        }
+        HT_destroy(parallel);
+    }
+
+    HT_Ht* h_table = HT_create(1);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], values[i]);
+    }
+    CU_ASSERT(HT_resize_parallel(h_table, 4 * AMOUNT_KEYS, 3));
+    CU_ASSERT(h_table->capacity >= 4 * AMOUNT_KEYS && !h_table->old_nodes);
+    CU_ASSERT(_bitmap_matches(h_table));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == HT_find(built, keys[i]));
+    }
+    // Asking for fewer buckets than keys keeps one bucket per key.
+    CU_ASSERT(HT_resize_parallel(h_table, 1, 4));
+    CU_ASSERT(h_table->capacity >= h_table->size && h_table->capacity < 2 * h_table->size);
+    CU_ASSERT(_bitmap_matches(h_table));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == HT_find(built, keys[i]));
+    }
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    CU_ASSERT(!HT_resize_parallel(h_table, 8 * AMOUNT_KEYS, 2));
+    HT_iter_release(&iter);
+    HT_destroy(h_table);
+    HT_destroy(built);
+    _destroy_keys(keys, AMOUNT_KEYS - 1);
+    free(keys);
+    free(values);
+}
+
+/**
+ * @brief Testing a hash table backed by arenas. Removed nodes must be
+ * reused by later keys that fit in them instead of growing the arenas,
+ * and every key must stay reachable through the rehashes.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_arena(void) {
+    const int AMOUNT_KEYS = 300;
+    const int KEY_SIZE = 30;
+    HT_Ht* h_table = HT_create(4);
+    CU_ASSERT(HT_use_arena(h_table));
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    char** new_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    CU_ASSERT(!HT_use_arena(h_table)); // The table is not empty anymore.
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, keys[i]) == i);
+        HT_remove(h_table, keys[i]);
+    }
+    size_t used_nodes = h_table->node_arena->used;
+    size_t used_keys = h_table->key_arena->used;
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, new_keys[i], i);
+    }
+    CU_ASSERT(h_table->node_arena->used == used_nodes);
+    CU_ASSERT(h_table->key_arena->used == used_keys);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(h_table, new_keys[i]) == i);
+    }
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    _destroy_keys(new_keys, AMOUNT_KEYS);
+    free(keys);
+    free(new_keys);
+}
+
+/**
+ * @brief Testing tables that do not copy their keys. A borrowing table
+ * must point at the caller's keys, and tables sharing an intern pool
+ * must point at a single copy of each key, freed along with its last user.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_intern(void) {
+    const int AMOUNT_KEYS = 300;
+    const int KEY_SIZE = 40;
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    HT_Ht* borrowed = HT_create(4);
+    CU_ASSERT(HT_borrow_keys(borrowed));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(borrowed, keys[i], i);
+    }
+    HT_add(borrowed, "short", -1); // Short keys are still inlined.
+    HT_Iter iter;
+    HT_iter_init(borrowed, &iter);
+    for (HT_Node* node; (node = HT_iter_next(&iter));) {
+        if (node->value >= 0)
+            CU_ASSERT(node->key == (unsigned char*) keys[node->value]);
+        else
+            CU_ASSERT(node->key == node->inline_key);
+    }
+    HT_iter_release(&iter);
+    HT_Stats stats;
+    HT_stats(borrowed, &stats);
+    CU_ASSERT(stats.key_bytes == 0);
+    CU_ASSERT(borrowed->bytes == sizeof(HT_Node) * (AMOUNT_KEYS + 1));
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        CU_ASSERT(HT_remove(borrowed, keys[i]));
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_check(borrowed, keys[i]) == i % 2);
+    }
+    HT_destroy(borrowed);
+
+    HT_Intern* pool = HT_intern_create();
+    HT_Ht* first = HT_create(4);
+    HT_Ht* second = HT_create(4);
+    CU_ASSERT(HT_use_intern(first, pool));
+    CU_ASSERT(!HT_borrow_keys(first));
+    CU_ASSERT(HT_use_arena(second) && HT_use_intern(second, pool));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(first, keys[i], i);
+        HT_add(second, keys[i], -i);
+    }
+    HT_add(first, "short", 0);
+    CU_ASSERT(HT_intern_size(pool) == AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        const char* shared = HT_intern(pool, keys[i]);
+        CU_ASSERT(shared != keys[i] && !strcmp(shared, keys[i]));
+        CU_ASSERT(HT_intern(pool, keys[i]) == shared);
+        HT_intern_release(pool, shared);
+        HT_intern_release(pool, shared);
+        CU_ASSERT(HT_find(first, keys[i]) == i);
+        CU_ASSERT(HT_find(second, keys[i]) == -i);
+    }
+    // Removed keys stay interned while the other table holds them.
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_remove(first, keys[i]);
+    }
+    CU_ASSERT(HT_intern_size(pool) == AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        HT_remove(second, keys[i]);
+    }
+    CU_ASSERT(HT_intern_size(pool) == AMOUNT_KEYS / 2);
+    // Nodes reused from the arena take a fresh reference.
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        HT_add(second, keys[i], i);
+    }
+    CU_ASSERT(HT_intern_size(pool) == AMOUNT_KEYS);
+    HT_destroy(first);
+    HT_destroy(second);
+    CU_ASSERT(HT_intern_size(pool) == 0);
+    HT_intern_destroy(pool);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * @brief Count the links of a table's chains that do not point to the
+ * node laid out right after the current one.
+ */
+size_t _chain_gaps(HT_Ht* h_table) {
+    size_t gaps = 0;
+    for (unsigned int x = 0; x < h_table->capacity; x++) {
+        for (HT_Node* node = h_table->nodes[x]; node && node->next; node = node->next) {
+            gaps += node->next != node + 1;
+        }
+    }
+    return gaps;
+}
+
+/**
+ * @brief Testing compaction after heavy churn. The buckets must shrink to
+ * fit, the chains must be laid out in order, and every key must survive,
+ * whether the table is compacted at once or step by step while it keeps
+ * being changed. Value pointers outlive rehashes but not compactions.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_compact(void) {
+    const int AMOUNT_KEYS = 2000;
+    const int KEY_SIZE = 30;
+    char** keys = malloc(sizeof(char*) * AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        keys[i] = malloc(KEY_SIZE + 1);
+        // Every third key fits inside its node.
+        snprintf(keys[i], KEY_SIZE + 1, i % 3 ? "compacted-key-number-%d" : "short-%d", i);
+    }
+    HT_Ht* h_table = HT_create(4);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(h_table, keys[i], i);
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        if (i % 4) HT_remove(h_table, keys[i]);
+    }
+    CU_ASSERT(h_table->capacity == 2048);
+    // Rehashes keep nodes in place, compactions move them.
+    int* slot = HT_get_ptr(h_table, keys[0]);
+    CU_ASSERT(HT_resize_parallel(h_table, 4096, 2) && HT_get_ptr(h_table, keys[0]) == slot);
+    *slot = -1;
+    CU_ASSERT(HT_find(h_table, keys[0]) == -1);
+    *slot = 0;
+    CU_ASSERT(HT_compact(h_table));
+    int* moved = HT_get_ptr(h_table, keys[0]);
+    CU_ASSERT(moved && moved != slot && *moved == 0);
+    *moved = -2;
+    CU_ASSERT(HT_find(h_table, keys[0]) == -2);
+    *moved = 0;
+    CU_ASSERT(h_table->capacity == 512 && !h_table->old_nodes && !h_table->compacting);
+    CU_ASSERT(h_table->node_arena && h_table->bytes > 0);
+    size_t slabs = 0;
+    for (HT_Slab* slab = h_table->node_arena->slabs; slab; slab = slab->next) {
+        slabs++;
+    }
+    CU_ASSERT(_chain_gaps(h_table) < slabs);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_check(h_table, keys[i]) == !(i % 4));
+        if (!(i % 4)) CU_ASSERT(HT_find(h_table, keys[i]) == i);
+    }
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    CU_ASSERT(!HT_compact(h_table) && !HT_compact_step(h_table, 1));
+    HT_iter_release(&iter);
+
+    // Step by step, with keys added and removed between the steps.
+    for (int i = 0; i < AMOUNT_KEYS; i += 4) {
+        HT_remove(h_table, keys[i]);
+        HT_add(h_table, keys[i + 1], i + 1);
+    }
+    int steps = 0;
+    for (int i = 0; HT_compact_step(h_table, 16); i += 4, steps++) {
+        HT_add(h_table, keys[i + 2], i + 2);
+        HT_remove(h_table, keys[i + 1]);
+    }
+    CU_ASSERT(steps > 1 && !h_table->old_node_arena);
+    for (int i = 0; i < AMOUNT_KEYS; i += 4) {
+        int added = i / 4 < steps;
+        CU_ASSERT(HT_check(h_table, keys[i]) == 0);
+        CU_ASSERT(HT_check(h_table, keys[i + 1]) == !added);
+        CU_ASSERT(HT_check(h_table, keys[i + 2]) == added);
+    }
+
+    // Destroying a table in the middle of a compaction off the heap.
+    HT_Ht* other = HT_create(4);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(other, keys[i], i);
+    }
+    CU_ASSERT(HT_compact_step(other, 1));
+    while (other->compacting != 2) HT_compact_step(other, 1);
+    HT_compact_step(other, 16);
+    HT_remove(other, keys[0]);
+    HT_add(other, keys[0], -1);
+    CU_ASSERT(HT_find(other, keys[0]) == -1 && HT_find(other, keys[AMOUNT_KEYS - 1]) == AMOUNT_KEYS - 1);
+    HT_destroy(other);
+
+    // Interned keys keep their references through a compaction.
+    HT_Intern* pool = HT_intern_create();
+    other = HT_create(4);
+    HT_use_intern(other, pool);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(other, keys[i], i);
+    }
+    size_t interned = HT_intern_size(pool);
+    HT_compact(other);
+    CU_ASSERT(HT_intern_size(pool) == interned && HT_find(other, keys[1]) == 1);
+    HT_destroy(other);
+    CU_ASSERT(HT_intern_size(pool) == 0);
+    HT_intern_destroy(pool);
+
+    HT_destroy(h_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * The state of an ordered scan of the index test: the last key visited,
+ * and whether every key came after the previous one.
+ */
+struct ix_scan {
+    HT_Node* last;
+    int ordered;
+    size_t sum;
+};
+
+/**
+ * @brief Called on each key of an ordered scan by the index test.
+ */
+void _ix_visit(HT_Node* node, void* data) {
+    struct ix_scan* scan = data;
+    if (scan->last) {
+        size_t len = scan->last->key_len < node->key_len ? scan->last->key_len : node->key_len;
+        int c = memcmp(scan->last->key, node->key, len);
+        if (c > 0 || (!c && scan->last->key_len > node->key_len)) scan->ordered = 0;
+    }
+    scan->last = node;
+    scan->sum += node->value;
+}
+
+/**
+ * @brief Count the keys of a table starting with a prefix by walking
+ * every key, as the index test's reference.
+ */
+size_t _ix_count_prefix(HT_Ht* h_table, char* prefix) {
+    size_t count = 0, len = strlen(prefix);
+    HT_Iter iter;
+    HT_iter_init(h_table, &iter);
+    for (HT_Node* node; (node = HT_iter_next(&iter));) {
+        count += node->key_len >= len && !memcmp(node->key, prefix, len);
+    }
+    HT_iter_release(&iter);
+    return count;
+}
+
+/**
+ * @brief Testing the ordered index. Prefix and range scans must visit
+ * exactly the matching keys, in order, through additions, removals,
+ * changes and a compaction.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_index(void) {
+    const int USERS = 60;
+    const int ITEMS = 50;
+    char key[64];
+    HT_Ht* h_table = HT_create(4);
+    CU_ASSERT(HT_scan_prefix(h_table, "user:", 5, _ix_visit, NULL) == 0);
+    // Half of the keys are indexed as the index is created.
+    for (int u = 0; u < USERS / 2; u++) {
+        for (int i = 0; i < ITEMS; i++) {
+            snprintf(key, sizeof(key), "user:%d:item:%d", u, i);
+            HT_add(h_table, key, i);
+        }
+    }
+    HT_use_index(h_table);
+    for (int u = USERS / 2; u < USERS; u++) {
+        for (int i = 0; i < ITEMS; i++) {
+            snprintf(key, sizeof(key), "user:%d:item:%d", u, i);
+            HT_add(h_table, key, i);
+        }
+    }
+    HT_add(h_table, "user:12", -1); // A prefix of the keys of user 12 itself.
+    CU_ASSERT(h_table->index->size == h_table->size);
+    struct ix_scan scan = { NULL, 1, 0 };
+    CU_ASSERT(HT_scan_prefix(h_table, "user:12:", 8, _ix_visit, &scan) == ITEMS);
+    CU_ASSERT(scan.ordered && scan.sum == ITEMS * (ITEMS - 1) / 2);
+    scan = (struct ix_scan) { NULL, 1, 0 };
+    CU_ASSERT(HT_scan_prefix(h_table, "user:1", 6, _ix_visit, &scan) == _ix_count_prefix(h_table, "user:1"));
+    CU_ASSERT(scan.ordered);
+    scan = (struct ix_scan) { NULL, 1, 0 };
+    CU_ASSERT(HT_scan_range(h_table, NULL, 0, NULL, 0, _ix_visit, &scan) == h_table->size);
+    CU_ASSERT(scan.ordered);
+    // From "user:12" included to "user:13" excluded.
+    CU_ASSERT(HT_scan_range(h_table, "user:12", 7, "user:13", 7, _ix_visit, &scan) == ITEMS + 1);
+
+    // Removals, including whole users, and changes.
+    for (int u = 0; u < USERS; u++) {
+        for (int i = 0; i < ITEMS; i++) {
+            snprintf(key, sizeof(key), "user:%d:item:%d", u, i);
+            if (u % 3 == 0 || i % 2) HT_remove(h_table, key);
+            else HT_change(h_table, key, 1);
+        }
+    }
+    CU_ASSERT(h_table->index->size == h_table->size);
+    scan = (struct ix_scan) { NULL, 1, 0 };
+    CU_ASSERT(HT_scan_prefix(h_table, "user:12:", 8, _ix_visit, &scan) == 0);
+    CU_ASSERT(HT_scan_prefix(h_table, "user:13:", 8, _ix_visit, &scan) == ITEMS / 2);
+    CU_ASSERT(scan.sum == ITEMS / 2);
+    HT_compact(h_table);
+    scan = (struct ix_scan) { NULL, 1, 0 };
+    CU_ASSERT(HT_scan_range(h_table, NULL, 0, NULL, 0, _ix_visit, &scan) == h_table->size);
+    CU_ASSERT(scan.ordered);
+    CU_ASSERT(HT_scan_prefix(h_table, "user:2", 6, _ix_visit, &scan) == _ix_count_prefix(h_table, "user:2"));
+    for (int u = 0; u < USERS; u++) {
+        for (int i = 0; i < ITEMS; i++) {
+            snprintf(key, sizeof(key), "user:%d:item:%d", u, i);
+            HT_remove(h_table, key);
+        }
+    }
+    HT_remove(h_table, "user:12");
+    CU_ASSERT(h_table->size == 0 && h_table->index->size == 0 && h_table->index->root->leaf);
+    CU_ASSERT(HT_scan_range(h_table, NULL, 0, NULL, 0, _ix_visit, &scan) == 0);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing tables whose arrays of buckets are large enough to be
+ * mapped on huge pages, through growth, a parallel resize and shrinking,
+ * and the reduction of hashes to more buckets than 32 bits can count.
+ * Reserved huge pages are rarely configured, so the fallback to
+ * transparent huge pages is what usually runs.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_huge_pages(void) {
+    const size_t BUCKETS = HT_HUGE_PAGE / sizeof(HT_Node*);
+    const int KEYS = 2000;
+    char key[32];
+    HT_Ht* h_table = HT_create(BUCKETS / 2);
+    CU_ASSERT(HT_use_huge_pages(h_table, 3 << 20) == 0);
+    CU_ASSERT(HT_use_huge_pages(h_table, 4096) == 0);
+    CU_ASSERT(HT_use_huge_pages(h_table, HT_HUGE_PAGE) == 1);
+    HT_set_shrink(h_table, 1);
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "huge:%d", i);
+        HT_add(h_table, key, i);
+    }
+    CU_ASSERT(HT_use_huge_pages(h_table, 0) == 0);
+    CU_ASSERT(HT_resize_parallel(h_table, 2 * BUCKETS, 2) == 1);
+    CU_ASSERT(h_table->capacity == 2 * BUCKETS);
+    // An array too large to be mapped leaves the table as it was.
+    CU_ASSERT(HT_resize_parallel(h_table, (size_t) 1 << 60, 2) == 0);
+    // Capacities stop doubling before they overflow.
+    CU_ASSERT(HT_resize_parallel(h_table, SIZE_MAX, 2) == 0);
+    CU_ASSERT(h_table->capacity == 2 * BUCKETS && !h_table->old_nodes);
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "huge:%d", i);
+        CU_ASSERT(HT_find(h_table, key) == i);
+    }
+    // Removals shrink the table back through arrays mapped and unmapped
+    // incrementally.
+    for (int i = 0; i < KEYS; i += 2) {
+        snprintf(key, sizeof(key), "huge:%d", i);
+        CU_ASSERT(HT_remove(h_table, key) == 1);
+    }
+    HT_compact(h_table);
+    CU_ASSERT(h_table->capacity == BUCKETS / 2);
+    for (int i = 1; i < KEYS; i += 2) {
+        snprintf(key, sizeof(key), "huge:%d", i);
+        CU_ASSERT(HT_find(h_table, key) == i);
+    }
+    HT_destroy(h_table);
+
+    // 1 GB pages only back arrays that nearly fill them.
+    CU_ASSERT(_HT_page_size(HT_HUGE_PAGE, HT_HUGE_PAGE_1G) == HT_HUGE_PAGE);
+    CU_ASSERT(_HT_page_size(HT_HUGE_PAGE_1G / 2, HT_HUGE_PAGE_1G) == HT_HUGE_PAGE);
+    CU_ASSERT(_HT_page_size(HT_HUGE_PAGE_1G - HT_HUGE_PAGE, HT_HUGE_PAGE_1G) == HT_HUGE_PAGE_1G);
+    CU_ASSERT(_HT_page_size(4 * HT_HUGE_PAGE_1G, HT_HUGE_PAGE_1G) == HT_HUGE_PAGE_1G);
+    CU_ASSERT(_HT_page_size(4 * HT_HUGE_PAGE_1G, 0) == HT_HUGE_PAGE);
+
+    uint64_t buckets = (uint64_t) 1 << 40;
+    CU_ASSERT(HT_hash("huge", buckets) == HT_hash_key("huge") % buckets);
+    CU_ASSERT(sizeof(h_table->capacity) == sizeof(size_t) && sizeof(h_table->size) == sizeof(size_t));
+}
+
+/**
+ * @brief Testing the profiled regions: every operation is counted once,
+ * and hashing and allocation along with it, in builds compiled with
+ * `-DHT_PROFILE`. Other builds report nothing.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_profile(void) {
+    const int KEYS = 100;
+    char key[32];
+    HT_Profile profile[HT_PROF_REGIONS];
+    HT_Ht* h_table = HT_create(4);
+    HT_profile_reset();
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "profiled:%d", i);
+        HT_add(h_table, key, i);
+    }
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "profiled:%d", i);
+        HT_change(h_table, key, HT_find(h_table, key) + 1);
+        HT_check(h_table, key);
+    }
+    for (int i = 0; i < KEYS; i += 2) {
+        snprintf(key, sizeof(key), "profiled:%d", i);
+        HT_remove(h_table, key);
+    }
+    HT_remove(h_table, "missing");
+    if (HT_profile(profile)) {
+        CU_ASSERT(profile[HT_PROF_ADD].calls == KEYS);
+        CU_ASSERT(profile[HT_PROF_FIND].calls == KEYS);
+        CU_ASSERT(profile[HT_PROF_CHECK].calls == KEYS);
+        CU_ASSERT(profile[HT_PROF_CHANGE].calls == KEYS);
+        CU_ASSERT(profile[HT_PROF_REMOVE].calls == KEYS / 2 + 1);
+        CU_ASSERT(profile[HT_PROF_HASH].calls == 4 * KEYS + KEYS / 2 + 1);
+        CU_ASSERT(profile[HT_PROF_ALLOC].calls == KEYS + KEYS / 2);
+        CU_ASSERT(profile[HT_PROF_ADD].cycles >= profile[HT_PROF_ALLOC].cycles / 2);
+        HT_profile_reset();
+        HT_profile(profile);
+    }
+    for (int x = 0; x < HT_PROF_REGIONS; x++)
+        CU_ASSERT(profile[x].calls == 0 && profile[x].cycles == 0);
+    HT_destroy(h_table);
+}
+
+/**
+ * @brief Testing adding to and finding from the open-addressing table.
+ * The table starts with a single slot, so it must grow and displace
+ * entries along the way. Also checks that missing keys are not found.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_rh_add_find(void) {
+    const int AMOUNT_KEYS = 500;
+    const int KEY_SIZE = 30;
+    RH_Ht* r_table = RH_create(1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        RH_add(r_table, keys[i], values[i]);
+    }
+    CU_ASSERT(r_table->size == AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(RH_check(r_table, keys[i]));
+        CU_ASSERT(RH_find(r_table, keys[i]) == values[i]);
+    }
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!RH_check(r_table, nonexistent_keys[i]));
+    }
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(nonexistent_keys);
+    free(keys);
+    free(values);
+    RH_destroy(r_table);
+}
+
+/**
+ * @brief Testing the change and remove functions of the open-addressing
+ * table. Half of the keys are removed, which shifts their neighbours
+ * back; the other half must still be found with their changed values.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_rh_change_remove(void) {
+    const int AMOUNT_KEYS = 200;
+    const int KEY_SIZE = 30;
+    RH_Ht* r_table = RH_create(16);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        RH_add(r_table, keys[i], i);
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        RH_change(r_table, keys[i], i * 2);
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        RH_remove(r_table, keys[i]);
+        CU_ASSERT(!RH_check(r_table, keys[i]));
+    }
+    CU_ASSERT(r_table->size == AMOUNT_KEYS / 2);
+    for (int i = 1; i < AMOUNT_KEYS; i += 2) {
+        CU_ASSERT(RH_find(r_table, keys[i]) == i * 2);
+    }
+    // The table should still be usable after values
+    // have been removed.
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        RH_add(r_table, keys[i], i);
+        CU_ASSERT(RH_find(r_table, keys[i]) == i);
+    }
+    // Short keys live in their slot, longer ones outside of it. Keys on
+    // both sides of the limit, and prefixes of each other, stay distinct.
+    char key[RH_INLINE_KEY + 2];
+    for (int len = 1; len <= RH_INLINE_KEY + 1; len++) {
+        memset(key, 'k', len);
+        key[len] = '\0';
+        RH_add(r_table, key, -len);
+    }
+    CU_ASSERT(sizeof(RH_Slot) == 32);
+    CU_ASSERT(r_table->size == AMOUNT_KEYS + RH_INLINE_KEY + 1);
+    for (int len = 1; len <= RH_INLINE_KEY + 1; len++) {
+        memset(key, 'k', len);
+        key[len] = '\0';
+        CU_ASSERT(RH_find(r_table, key) == -len);
+        size_t found = 0;
+        for (size_t i = 0; i < r_table->capacity; i++) {
+            RH_Slot* slot = &(r_table->slots[i]);
+            if (!slot->tag || slot->value != -len) continue;
+            found++;
+            CU_ASSERT(slot->hash == HT_hash_key(key));
+            if (len < RH_INLINE_KEY)
+                CU_ASSERT(slot->tag == len + 1 && !strcmp(slot->inline_key, key));
+            else
+                CU_ASSERT(slot->tag == RH_LONG_KEY);
+        }
+        CU_ASSERT(found == 1);
+    }
+    memset(key, 'k', RH_INLINE_KEY);
+    key[RH_INLINE_KEY] = '\0';
+    RH_remove(r_table, key);
+    key[RH_INLINE_KEY - 1] = '\0';
+    RH_remove(r_table, key);
+    CU_ASSERT(!RH_check(r_table, key) && r_table->size == AMOUNT_KEYS + RH_INLINE_KEY - 1);
+    key[RH_INLINE_KEY - 2] = '\0';
+    CU_ASSERT(RH_find(r_table, key) == -(RH_INLINE_KEY - 2));
+    CU_ASSERT(sizeof(r_table->capacity) == sizeof(size_t) && sizeof(r_table->size) == sizeof(size_t));
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+    RH_destroy(r_table);
+}
+
+/**
+ * @brief Testing the cuckoo table. Every key must be found in one of its
+ * two buckets or the stash, growth must keep the table densely loaded,
+ * and removed keys must leave the others reachable.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_ck_add_find_remove(void) {
+    const int AMOUNT_KEYS = 20000;
+    const int KEY_SIZE = 20;
+    CK_Ht* c_table = CK_create(1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CK_add(c_table, keys[i], i);
+    }
+    CU_ASSERT(c_table->size == AMOUNT_KEYS);
+    // Eviction paths let the table fill most of its slots before it grows.
+    CU_ASSERT((unsigned long) c_table->size * 100 >= (unsigned long) c_table->capacity * CK_SLOTS * 40);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(CK_check(c_table, keys[i]));
+        CU_ASSERT(CK_find(c_table, keys[i]) == i);
+    }
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!CK_check(c_table, nonexistent_keys[i]));
+    }
+    CK_add(c_table, keys[0], -1); // Adding an existing key replaces its value.
+    CU_ASSERT(c_table->size == AMOUNT_KEYS && CK_find(c_table, keys[0]) == -1);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CK_change(c_table, keys[i], i * 2);
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        CK_remove(c_table, keys[i]);
+        CU_ASSERT(!CK_check(c_table, keys[i]));
+    }
+    CU_ASSERT(c_table->size == AMOUNT_KEYS / 2);
+    for (int i = 1; i < AMOUNT_KEYS; i += 2) {
+        CU_ASSERT(CK_find(c_table, keys[i]) == i * 2);
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i += 2) {
+        CK_add(c_table, keys[i], i);
+        CU_ASSERT(CK_find(c_table, keys[i]) == i);
+    }
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(nonexistent_keys);
+    free(keys);
+    CK_destroy(c_table);
+}
+
+/**
+ * @brief Testing adding to and finding from the Swiss table with the
+ * group comparisons it was compiled for. Growth must keep every key
+ * reachable, and missing keys must not be found.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_st_add_find(void) {
+    const int AMOUNT_KEYS = 1000;
+    const int KEY_SIZE = 30;
+    ST_Ht* s_table = ST_create(1);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    int* values = _random_values(AMOUNT_KEYS, MAX_VALUE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        ST_add(s_table, keys[i], values[i]);
+    }
+    CU_ASSERT(s_table->size == AMOUNT_KEYS);
+    CU_ASSERT(s_table->capacity % ST_GROUP_WIDTH == 0);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(ST_check(s_table, keys[i]));
+        CU_ASSERT(ST_find(s_table, keys[i]) == values[i]);
+    }
+    char** nonexistent_keys = _random_keys_ex(keys, AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(!ST_check(s_table, nonexistent_keys[i]));
+    }
+    _destroy_keys(nonexistent_keys, AMOUNT_KEYS);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(nonexistent_keys);
+    free(keys);
+    free(values);
+    ST_destroy(s_table);
+}
+
+/**
+ * @brief Testing the change and remove functions of the Swiss table.
+ * Keys are removed and added repeatedly so that tombstones build up
+ * and must be cleared without losing any key.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_st_change_remove(void) {
+    const int AMOUNT_KEYS = 200;
+    const int KEY_SIZE = 30;
+    ST_Ht* s_table = ST_create(64);
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        ST_add(s_table, keys[i], i);
+        ST_change(s_table, keys[i], i * 2);
+    }
+    for (int round = 0; round < 10; round++) {
+        for (int i = round % 2; i < AMOUNT_KEYS; i += 2) {
+            ST_remove(s_table, keys[i]);
+            CU_ASSERT(!ST_check(s_table, keys[i]));
+        }
+        CU_ASSERT(s_table->size == AMOUNT_KEYS / 2);
+        for (int i = round % 2; i < AMOUNT_KEYS; i += 2) {
+            ST_add(s_table, keys[i], i * 2);
+        }
+    }
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(ST_find(s_table, keys[i]) == i * 2);
+    }
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+    ST_destroy(s_table);
+}
+
+/**
+ * @brief Testing a macro-generated table with integer keys and inline
+ * struct values. Removing every other key must keep the others reachable.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_generic(void) {
+    const uint64_t AMOUNT_KEYS = 5000;
+    GT_u64_Ht* g_table = GT_u64_create(1);
+    for (uint64_t i = 0; i < AMOUNT_KEYS; i++) {
+        struct gt_payload payload = {i * 7, i / 2.0};
+        GT_u64_add(g_table, i << 32, payload);
+    }
+    CU_ASSERT(g_table->size == AMOUNT_KEYS);
+    struct gt_payload payload;
+    for (uint64_t i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(GT_u64_get(g_table, i << 32, &payload));
+        CU_ASSERT(payload.id == i * 7 && payload.score == i / 2.0);
+        CU_ASSERT(!GT_u64_check(g_table, (i << 32) + 1));
+    }
+    GT_u64_get_ptr(g_table, 0)->id = 99;
+    CU_ASSERT(GT_u64_get(g_table, 0, &payload) && payload.id == 99);
+    for (uint64_t i = 0; i < AMOUNT_KEYS; i += 2) {
+        CU_ASSERT(GT_u64_remove(g_table, i << 32));
+    }
+    CU_ASSERT(!GT_u64_remove(g_table, 0));
+    CU_ASSERT(g_table->size == AMOUNT_KEYS / 2);
+    for (uint64_t i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(GT_u64_check(g_table, i << 32) == (i % 2));
+    }
+    GT_u64_destroy(g_table);
+
+    // A single run of colliding keys wrapping around the end of the slots.
+    GT_int_Ht* c_table = GT_int_create(4);
+    for (int i = 0; i < 6; i++) {
+        GT_int_add(c_table, i, i * 10);
+    }
+    GT_int_add(c_table, 3, 33);
+    CU_ASSERT(c_table->size == 6 && c_table->capacity == 8);
+    CU_ASSERT(c_table->slots[7].key == 0 && c_table->slots[0].key == 1);
+    CU_ASSERT(GT_int_remove(c_table, 0) && GT_int_remove(c_table, 4));
+    int value;
+    for (int i = 0; i < 6; i++) {
+        CU_ASSERT(GT_int_get(c_table, i, &value) == (i != 0 && i != 4));
+    }
+    CU_ASSERT(GT_int_get(c_table, 3, &value) && value == 33);
+    CU_ASSERT(GT_int_get(c_table, 5, &value) && value == 50);
+    // Removing the key in the last slot pulled the run back across the end.
+    CU_ASSERT(c_table->used[7] && c_table->slots[7].key == 1);
+    GT_int_destroy(c_table);
+}
+
+/**
+ * The work given to each thread of the concurrent table test.
+ */
+struct ct_work {
+    CT_Ht* c_table;
+    char** keys;
+    int num_keys;
+    int failures; // Set by readers for every stable key they did not find.
+    _Atomic int* stop;
+};
+
+/**
+ * @brief Writer thread of the concurrent table test. Adds its own keys,
+ * then removes every other one.
+ */
+void* _ct_writer(void* arg) {
+    struct ct_work* work = arg;
+    for (int i = 0; i < work->num_keys; i++) {
+        CT_add(work->c_table, work->keys[i], i);
+    }
+    for (int i = 0; i < work->num_keys; i += 2) {
+        CT_remove(work->c_table, work->keys[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reader thread of the concurrent table test. Keeps looking up
+ * keys that are never removed while the writers force resizes.
+ */
+void* _ct_reader(void* arg) {
+    struct ct_work* work = arg;
+    while (!atomic_load(work->stop)) {
+        for (int i = 0; i < work->num_keys; i++) {
+            if (CT_find(work->c_table, work->keys[i]) != i)
+                work->failures++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Testing the concurrent table with several writers and lock-free
+ * readers running at once. Readers must never miss a key that exists,
+ * even while its stripe is being resized.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_concurrent(void) {
+    const int WRITERS = 4;
+    const int READERS = 2;
+    const int AMOUNT_KEYS = 2000;
+    const int STABLE_KEYS = 200;
+    const int KEY_SIZE = 30;
+    CT_Ht* c_table = CT_create(16, 8);
+    _Atomic int stop = 0;
+    char** stable_keys = _random_keys(STABLE_KEYS, KEY_SIZE);
+    for (int i = 0; i < STABLE_KEYS; i++) {
+        CT_add(c_table, stable_keys[i], i);
+    }
+    pthread_t threads[WRITERS + READERS];
+    struct ct_work work[WRITERS + READERS];
+    for (int t = 0; t < WRITERS + READERS; t++) {
+        work[t].c_table = c_table;
+        work[t].failures = 0;
+        work[t].stop = &stop;
+        if (t < WRITERS) {
+            work[t].keys = _random_keys_ex(stable_keys, AMOUNT_KEYS, KEY_SIZE);
+            work[t].num_keys = AMOUNT_KEYS;
+        } else {
+            work[t].keys = stable_keys;
+            work[t].num_keys = STABLE_KEYS;
+        }
+    }
+    for (int t = 0; t < WRITERS + READERS; t++) {
+        pthread_create(&threads[t], NULL, t < WRITERS ? _ct_writer : _ct_reader, &work[t]);
+    }
+    for (int t = 0; t < WRITERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    atomic_store(&stop, 1);
+    for (int t = WRITERS; t < WRITERS + READERS; t++) {
+        pthread_join(threads[t], NULL);
+        CU_ASSERT(work[t].failures == 0);
+    }
+    CU_ASSERT(CT_size(c_table) == STABLE_KEYS + WRITERS * AMOUNT_KEYS / 2);
+    for (int t = 0; t < WRITERS; t++) {
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            CU_ASSERT(CT_check(c_table, work[t].keys[i]) == i % 2);
+        }
+        _destroy_keys(work[t].keys, AMOUNT_KEYS);
+        free(work[t].keys);
+    }
+    CT_destroy(c_table);
+    _destroy_keys(stable_keys, STABLE_KEYS);
+    free(stable_keys);
+}
+
+/**
+ * The work given to each writer of the sharded table test.
+ */
+struct sh_work {
+    HT_Sharded* s_table;
+    char** keys;
+    int num_keys;
+};
+
+/**
+ * @brief Writer thread of the sharded table test. Adds its own keys,
+ * then removes every other one.
+ */
+void* _sh_writer(void* arg) {
+    struct sh_work* work = arg;
+    for (int i = 0; i < work->num_keys; i++) {
+        HT_sharded_add(work->s_table, work->keys[i], i);
+    }
+    for (int i = 0; i < work->num_keys; i += 2) {
+        HT_sharded_remove(work->s_table, work->keys[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Testing the sharded table with several writers at once. Every
+ * key must end up in its shard, and the aggregated summary must add up
+ * the summaries of the shards.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_sharded(void) {
+    const int WRITERS = 4;
+    const int AMOUNT_KEYS = 2000;
+    const int KEY_SIZE = 30;
+    HT_Sharded* s_table = HT_sharded_create(16, 8);
+    CU_ASSERT(s_table->shard_bits == 3);
+    pthread_t threads[WRITERS];
+    struct sh_work work[WRITERS];
+    for (int t = 0; t < WRITERS; t++) {
+        work[t].s_table = s_table;
+        work[t].keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+        work[t].num_keys = AMOUNT_KEYS;
+        pthread_create(&threads[t], NULL, _sh_writer, &work[t]);
+    }
+    for (int t = 0; t < WRITERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    CU_ASSERT(HT_sharded_size(s_table) == WRITERS * AMOUNT_KEYS / 2);
+    for (int t = 0; t < WRITERS; t++) {
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            CU_ASSERT(HT_sharded_check(s_table, work[t].keys[i]) == i % 2);
+            CU_ASSERT(HT_sharded_find(s_table, work[t].keys[i]) == (i % 2 ? i : 0));
+        }
+    }
+    HT_sharded_change(s_table, work[0].keys[1], -1);
+    CU_ASSERT(!HT_sharded_upsert(s_table, work[0].keys[3], -3));
+    CU_ASSERT(HT_sharded_upsert(s_table, work[0].keys[0], -5));
+    int value = 0;
+    CU_ASSERT(HT_sharded_get(s_table, work[0].keys[1], &value) && value == -1);
+    CU_ASSERT(HT_sharded_find(s_table, work[0].keys[3]) == -3);
+    CU_ASSERT(HT_sharded_find(s_table, work[0].keys[0]) == -5);
+    // Shards are handed the hash that routed the key, which must be the
+    // one their own lookups compute.
+    for (int i = 0; i < 4; i++) {
+        if (i == 2) continue; // Removed by its writer.
+        char* key = work[0].keys[i];
+        uint64_t hash = HT_hash_bytes(key, strlen(key), s_table->seed);
+        HT_Ht* shard = s_table->shards[hash >> 61].table;
+        CU_ASSERT(HT_check(shard, key));
+        CU_ASSERT(HT_get_hashed(shard, key, strlen(key), hash, NULL));
+    }
+    CU_ASSERT(HT_sharded_remove(s_table, work[0].keys[0]));
+    CU_ASSERT(!HT_sharded_check(s_table, work[0].keys[0]));
+    CU_ASSERT(HT_sharded_upsert(s_table, work[0].keys[0], -5));
+
+    HT_Stats stats;
+    HT_sharded_stats(s_table, &stats);
+    size_t buckets = 0, size = 0;
+    for (int i = 0; i < 8; i++) {
+        buckets += s_table->shards[i].table->capacity;
+        size += s_table->shards[i].table->size;
+        CU_ASSERT(s_table->shards[i].table->size > 0);
+    }
+    CU_ASSERT(stats.size == size && size == WRITERS * AMOUNT_KEYS / 2 + 1);
+    CU_ASSERT(stats.rehashing || stats.buckets == buckets);
+    CU_ASSERT(stats.load_factor == (double) stats.size / stats.buckets);
+    CU_ASSERT(stats.mean_probes >= 1 && stats.mean_probes < 2);
+    HT_sharded_destroy(s_table, 3);
+    for (int t = 0; t < WRITERS; t++) {
+        _destroy_keys(work[t].keys, AMOUNT_KEYS);
+        free(work[t].keys);
+    }
+}
+
+/**
+ * The work given to each reader of the versioned table test.
+ */
+struct vt_work {
+    HT_Versioned* v_table;
+    char** keys;
+    int num_keys;
+    atomic_int* done;
+    int failures;
+};
+
+/**
+ * @brief Copier thread of the versioned table test. Copies the current
+ * version and destroys the copy until the writer is done, taking and
+ * dropping references to interned keys while the writer frees the
+ * versions it replaces.
+ */
+void* _vt_copier(void* arg) {
+    struct vt_work* work = arg;
+    while (!atomic_load(work->done)) {
+        HT_Ht* copy = HT_versioned_copy(work->v_table);
+        if (copy->size != (size_t) work->num_keys)
+            work->failures++;
+        HT_destroy(copy);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reader thread of the versioned table test. Reads every key until
+ * the writer is done. Version `g` maps key `i` to `g * num_keys + i`, so
+ * any version read is consistent, and versions never go backwards.
+ */
+void* _vt_reader(void* arg) {
+    struct vt_work* work = arg;
+    uint64_t last = 0;
+    while (!atomic_load(work->done)) {
+        for (int i = 0; i < work->num_keys; i++) {
+            int value = -1;
+            if (!HT_versioned_get(work->v_table, work->keys[i], &value)
+                || value % work->num_keys != i) {
+                work->failures++;
+            }
+        }
+        HT_Ht* current = HT_versioned_pin(work->v_table);
+        uint64_t version = HT_versioned_version(work->v_table);
+        // The pinned version stays whole while newer ones are published.
+        int first = HT_find(current, work->keys[0]);
+        for (int i = 1; i < work->num_keys; i++) {
+            if (HT_find(current, work->keys[i]) / work->num_keys != first / work->num_keys)
+                work->failures++;
+        }
+        HT_versioned_unpin();
+        if (version < last) work->failures++;
+        last = version;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Testing versioned tables with readers running while new versions
+ * are published. Readers must always find every key of a single version,
+ * and replaced versions must be reclaimed.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_versioned(void) {
+    const int READERS = 3;
+    const int VERSIONS = 20;
+    const int AMOUNT_KEYS = 500;
+    const int KEY_SIZE = 20;
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    HT_Ht* initial = HT_create(AMOUNT_KEYS);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(initial, keys[i], i);
+    }
+    HT_Versioned* v_table = HT_versioned_create(initial);
+    CU_ASSERT(v_table && HT_versioned_version(v_table) == 1);
+
+    atomic_int done;
+    atomic_init(&done, 0);
+    pthread_t threads[READERS];
+    struct vt_work work[READERS];
+    for (int t = 0; t < READERS; t++) {
+        work[t] = (struct vt_work) { v_table, keys, AMOUNT_KEYS, &done, 0 };
+        pthread_create(&threads[t], NULL, _vt_reader, &work[t]);
+    }
+    for (int g = 1; g <= VERSIONS; g++) {
+        HT_Ht* next = HT_versioned_copy(v_table);
+        CU_ASSERT(next->size == AMOUNT_KEYS && !next->paused);
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            HT_change(next, keys[i], g * AMOUNT_KEYS + i);
+        }
+        CU_ASSERT(HT_versioned_publish(v_table, next));
+    }
+    atomic_store(&done, 1);
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+        CU_ASSERT(work[t].failures == 0);
+    }
+    CU_ASSERT(HT_versioned_version(v_table) == VERSIONS + 1);
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_versioned_find(v_table, keys[i]) == VERSIONS * AMOUNT_KEYS + i);
+    }
+    CU_ASSERT(!HT_versioned_check(v_table, "missing"));
+    CU_ASSERT(HT_versioned_find(v_table, "missing") == 0);
+
+    // Cache tables write on lookups, so they cannot be published.
+    HT_Ht* cache = HT_create(1);
+    HT_set_limit(cache, 10, 0);
+    CU_ASSERT(!HT_versioned_publish(v_table, cache));
+    CU_ASSERT(HT_versioned_version(v_table) == VERSIONS + 1);
+    HT_destroy(cache);
+
+    // A version published mid-rehash keeps the capacity it was growing
+    // to, even with fewer keys than it had when it started to grow.
+    HT_Ht* growing = HT_create(256);
+    int added = 0;
+    while (!growing->old_nodes) {
+        HT_add(growing, keys[added], added);
+        added++;
+    }
+    for (int i = 0; i < 20; i++) {
+        HT_remove(growing, keys[i]);
+    }
+    size_t capacity = growing->capacity;
+    CU_ASSERT(growing->old_nodes && growing->size == (size_t) added - 20);
+    CU_ASSERT(HT_versioned_publish(v_table, growing));
+    CU_ASSERT(!growing->old_nodes && growing->capacity == capacity);
+
+    HT_versioned_destroy(v_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+
+    // Interned versions are freed by the writer replacing them, while
+    // other threads copy the current version into the same pool.
+    const int LONG_KEY_SIZE = 2 * HT_INLINE_KEY;
+    keys = _random_keys(AMOUNT_KEYS, LONG_KEY_SIZE);
+    HT_Intern* pool = HT_intern_create();
+    HT_Ht* interned = HT_create(AMOUNT_KEYS);
+    CU_ASSERT(HT_use_intern(interned, pool));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(interned, keys[i], i);
+    }
+    v_table = HT_versioned_create(interned);
+    atomic_store(&done, 0);
+    for (int t = 0; t < READERS; t++) {
+        work[t] = (struct vt_work) { v_table, keys, AMOUNT_KEYS, &done, 0 };
+        pthread_create(&threads[t], NULL, _vt_reader, &work[t]);
+    }
+    pthread_t copier;
+    struct vt_work copier_work = { v_table, keys, AMOUNT_KEYS, &done, 0 };
+    pthread_create(&copier, NULL, _vt_copier, &copier_work);
+    for (int g = 1; g <= VERSIONS; g++) {
+        HT_Ht* next = HT_versioned_copy(v_table);
+        CU_ASSERT(next->intern == pool);
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            HT_change(next, keys[i], g * AMOUNT_KEYS + i);
+        }
+        CU_ASSERT(HT_versioned_publish(v_table, next));
+    }
+    atomic_store(&done, 1);
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+        CU_ASSERT(work[t].failures == 0);
+    }
+    pthread_join(copier, NULL);
+    CU_ASSERT(copier_work.failures == 0);
+    CU_ASSERT(HT_intern_size(pool) == (size_t) AMOUNT_KEYS);
+    HT_versioned_destroy(v_table);
+    CU_ASSERT(HT_intern_size(pool) == 0);
+    HT_intern_destroy(pool);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+
+    HT_Versioned* empty = HT_versioned_create(NULL);
+    CU_ASSERT(!HT_versioned_check(empty, "missing"));
+    HT_versioned_destroy(empty);
+}
+
+/**
+ * @brief Testing NUMA placement: interleaved arrays of buckets through
+ * growth, and versioned tables replicated per node, read by several
+ * threads while new versions are published. Machines with a single node
+ * still get the requested replicas, each reader reading the same one.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_numa(void) {
+    const int READERS = 3;
+    const int VERSIONS = 10;
+    const int REPLICAS = 2;
+    const int AMOUNT_KEYS = 400;
+    const int KEY_SIZE = 20;
+    int nodes = HT_numa_nodes();
+    CU_ASSERT(nodes >= 1 && nodes <= HT_NUMA_MAX_NODES);
+    CU_ASSERT(HT_numa_node() >= 0 && HT_numa_node() < nodes);
+    CU_ASSERT(HT_numa_prefer(nodes) == 0);
+    HT_numa_prefer(-1);
+
+    char** keys = _random_keys(AMOUNT_KEYS, KEY_SIZE);
+    HT_Ht* interleaved = HT_create(HT_HUGE_PAGE / sizeof(HT_Node*));
+    CU_ASSERT(HT_use_interleave(interleaved) == (nodes > 1));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        HT_add(interleaved, keys[i], i);
+    }
+    CU_ASSERT(HT_resize_parallel(interleaved, 2 * interleaved->capacity, 2));
+    for (int i = 0; i < AMOUNT_KEYS; i++) {
+        CU_ASSERT(HT_find(interleaved, keys[i]) == i);
+    }
+
+    HT_Versioned* v_table = HT_versioned_create(interleaved);
+    // Placing replicas keeps the memory policy of the calling thread.
+    HT_Numa_policy before, after;
+    HT_numa_prefer(0);
+    int saved = HT_numa_save(&before);
+    CU_ASSERT(HT_versioned_replicate(v_table, REPLICAS) == 1);
+    if (saved) {
+        CU_ASSERT(HT_numa_save(&after));
+        CU_ASSERT(after.mode == before.mode && after.mask == before.mask);
+        CU_ASSERT(HT_numa_restore(&before));
+    }
+    HT_numa_prefer(-1);
+    CU_ASSERT(HT_versioned_replicate(v_table, REPLICAS) == 0);
+    CU_ASSERT(v_table->replicas == REPLICAS);
+    HT_Ht* replica = HT_versioned_pin(v_table);
+    CU_ASSERT(replica != interleaved && replica->node_arena && replica->interleave);
+    CU_ASSERT(replica->size == AMOUNT_KEYS && HT_find(replica, keys[7]) == 7);
+    HT_versioned_unpin();
+
+    atomic_int done;
+    atomic_init(&done, 0);
+    pthread_t threads[READERS];
+    struct vt_work work[READERS];
+    for (int t = 0; t < READERS; t++) {
+        work[t] = (struct vt_work) { v_table, keys, AMOUNT_KEYS, &done, 0 };
+        pthread_create(&threads[t], NULL, _vt_reader, &work[t]);
+    }
+    for (int g = 1; g <= VERSIONS; g++) {
+        HT_Ht* next = HT_versioned_copy(v_table);
+        // Copies are made from the version, not from a replica.
+        CU_ASSERT(!next->node_arena && next->interleave);
+        for (int i = 0; i < AMOUNT_KEYS; i++) {
+            HT_change(next, keys[i], g * AMOUNT_KEYS + i);
+        }
+        CU_ASSERT(HT_versioned_publish(v_table, next));
+    }
+    atomic_store(&done, 1);
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+        CU_ASSERT(work[t].failures == 0);
+    }
+    for (int r = 0; r < REPLICAS; r++) {
+        HT_Ht* local = atomic_load(&v_table->local[r]);
+        CU_ASSERT(HT_find(local, keys[0]) == VERSIONS * AMOUNT_KEYS);
+        CU_ASSERT(HT_find(local, keys[AMOUNT_KEYS - 1]) == (VERSIONS + 1) * AMOUNT_KEYS - 1);
+    }
+    CU_ASSERT(HT_versioned_find(v_table, keys[3]) == VERSIONS * AMOUNT_KEYS + 3);
+    HT_versioned_destroy(v_table);
+    _destroy_keys(keys, AMOUNT_KEYS);
+    free(keys);
+}
+
+/**
+ * @brief Testing the streaming loader. Every record pushed must end up in
+ * its shard once the load is finished, even though the pushed buffers are
+ * freed right away, keys set by other threads during the load must be
+ * kept, and a loader whose stages have no workers must run them on the
+ * pushing thread.
+ * 
+ * @return int - 0 if fail, 1 if success.
+ */
+int test_ingest(void) {
+    const int CHUNKS = 12;
+    const int CHUNK_SIZE = 400;
+    const int KEY_SIZE = 30;
+    HT_Sharded* s_table = HT_sharded_create(64, 8);
+    HT_Ingest* ingest = HT_ingest_create(s_table, 2, 3, 2);
+    CU_ASSERT(ingest->hash_threads == 2 && ingest->insert_threads == 3);
+    char** all_keys = malloc(sizeof(char*) * CHUNKS * CHUNK_SIZE);
+    int* values = malloc(sizeof(int) * CHUNK_SIZE);
+    for (int c = 0; c < CHUNKS; c++) {
+        char** keys = _random_keys(CHUNK_SIZE, KEY_SIZE);
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            values[i] = c * CHUNK_SIZE + i;
+            all_keys[c * CHUNK_SIZE + i] = strdup(keys[i]);
+        }
+        HT_ingest_push(ingest, keys, values, CHUNK_SIZE);
+        _destroy_keys(keys, CHUNK_SIZE);
+        free(keys);
+        // The table stays usable while the workers insert.
+        HT_sharded_upsert(s_table, "ingest:outside", c);
+    }
+    CU_ASSERT(HT_ingest_finish(ingest) == CHUNKS * CHUNK_SIZE);
+    CU_ASSERT(HT_sharded_size(s_table) == CHUNKS * CHUNK_SIZE + 1);
+    CU_ASSERT(HT_sharded_remove(s_table, "ingest:outside"));
+    for (int i = 0; i < CHUNKS * CHUNK_SIZE; i++) {
+        int value = -1;
+        CU_ASSERT(HT_sharded_get(s_table, all_keys[i], &value));
+        // Random keys may repeat, in which case either value may win.
+        CU_ASSERT(value == i || !strcmp(all_keys[value], all_keys[i]));
+    }
+
+    ingest = HT_ingest_create(s_table, 0, 0, 1);
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        values[i] = -i;
+    }
+    HT_ingest_push(ingest, all_keys, values, CHUNK_SIZE);
+    HT_ingest_push(ingest, all_keys, values, 0);
+    CU_ASSERT(HT_ingest_finish(ingest) == CHUNK_SIZE);
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        CU_ASSERT(HT_sharded_find(s_table, all_keys[i]) == -i);
+    }
+    HT_sharded_destroy(s_table, 1);
+    _destroy_keys(all_keys, CHUNKS * CHUNK_SIZE);
+    free(all_keys);
+    free(values);
+}
+
 int main(void) {
     CU_initialize_registry();
     CU_pSuite suite = CU_add_suite("Main Tests", NULL, NULL);
@@ -341,7 +2503,39 @@ int main(void) {
     CU_ADD_TEST(suite, test_check);
     CU_ADD_TEST(suite, test_change);
     CU_ADD_TEST(suite, test_remove);
+    CU_ADD_TEST(suite, test_remove_chain);
+    CU_ADD_TEST(suite, test_long_chain);
+    CU_ADD_TEST(suite, test_node_cache);
+    CU_ADD_TEST(suite, test_stats);
+    CU_ADD_TEST(suite, test_get_upsert);
+    CU_ADD_TEST(suite, test_cache);
+    CU_ADD_TEST(suite, test_binary_keys);
+    CU_ADD_TEST(suite, test_iter_scan);
+    CU_ADD_TEST(suite, test_snapshot);
+    CU_ADD_TEST(suite, test_frozen);
     CU_ADD_TEST(suite, test_hash);
+    CU_ADD_TEST(suite, test_hash_seed);
+    CU_ADD_TEST(suite, test_resize);
+    CU_ADD_TEST(suite, test_arena);
+    CU_ADD_TEST(suite, test_intern);
+    CU_ADD_TEST(suite, test_compact);
+    CU_ADD_TEST(suite, test_index);
+    CU_ADD_TEST(suite, test_profile);
+    CU_ADD_TEST(suite, test_huge_pages);
+    CU_ADD_TEST(suite, test_batch);
+    CU_ADD_TEST(suite, test_build);
+    CU_ADD_TEST(suite, test_parallel);
+    CU_ADD_TEST(suite, test_rh_add_find);
+    CU_ADD_TEST(suite, test_rh_change_remove);
+    CU_ADD_TEST(suite, test_ck_add_find_remove);
+    CU_ADD_TEST(suite, test_st_add_find);
+    CU_ADD_TEST(suite, test_st_change_remove);
+    CU_ADD_TEST(suite, test_generic);
+    CU_ADD_TEST(suite, test_concurrent);
+    CU_ADD_TEST(suite, test_sharded);
+    CU_ADD_TEST(suite, test_versioned);
+    CU_ADD_TEST(suite, test_numa);
+    CU_ADD_TEST(suite, test_ingest);
     CU_basic_run_tests();
     CU_cleanup_registry();
 }
@@ -0,0 +1,330 @@
+/**
+ * @file versioned_table.c
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Read-copy-update publishing of hash tables. Writers build a new
+ * version of the table on the side, usually from a copy of the current
+ * one, and publish it with a single atomic swap. Readers never take a
+ * lock: they load the current version inside an epoch-based read-side
+ * section, and a replaced version is only destroyed once every reader
+ * that could still see it has left its section. Published versions are
+ * never written to, so readers share them freely. On NUMA machines, every
+ * version may also be replicated on each node, so that readers only ever
+ * touch the memory of their own node.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stdlib.h>
+#include "hash_table.h"
+#include "versioned_table.h"
+#include "ebr.h"
+#include "numa_placement.h"
+
+/**
+ * @brief Destroy a version once no reader can reach it anymore.
+ *
+ * @param ptr - The version to destroy.
+ */
+void _HT_versioned_free(void* ptr) {
+    HT_destroy(ptr);
+}
+
+/**
+ * @brief Make a table safe to read from many threads at once. Lookups
+ * only write to a table while it is being rehashed or in cache mode, so
+ * an ongoing rehash is finished first, and rehashing is then paused for
+ * good.
+ *
+ * @param h_table - The table to seal.
+ * @return int - 1 if the table was sealed, 0 if it is in cache mode,
+ * walked by an iterator, or its rehash cannot be finished.
+ */
+int _HT_versioned_seal(HT_Ht* h_table) {
+    if (h_table->cache || h_table->paused) return 0;
+    // Finished at the capacity the rehash was heading for, not shrunk
+    // to the amount of keys.
+    if (h_table->old_nodes && !HT_resize_parallel(h_table, h_table->capacity, 1))
+        return 0;
+    h_table->paused++;
+    return 1;
+}
+
+/**
+ * @brief Initializer function for a versioned table.
+ *
+ * @param initial - The first version, owned by the versioned table from
+ * now on, or NULL to start from an empty table. It must not be in cache
+ * mode nor walked by an iterator.
+ * @return HT_Versioned* - The created table, or NULL if the first
+ * version cannot be published.
+ */
+HT_Versioned* HT_versioned_create(HT_Ht* initial) {
+    if (!initial) initial = HT_create(1);
+    if (!_HT_versioned_seal(initial)) return NULL;
+    HT_Versioned* v_table = malloc(sizeof(HT_Versioned));
+    atomic_init(&v_table->current, initial);
+    atomic_init(&v_table->version, 1);
+    pthread_mutex_init(&v_table->lock, NULL);
+    v_table->replicas = 0;
+    v_table->local = NULL;
+    return v_table;
+}
+
+/**
+ * @brief Copy a table into a new table with the same hash function, seed,
+ * allocation strategy, key storage and ordered index, holding the keys in
+ * the same order, duplicates included.
+ *
+ * @param source - The table to copy. Must not be being rehashed.
+ * @param arena - Whether the copy carves its nodes from arenas even if
+ * the source does not.
+ * @return HT_Ht* - The copy.
+ */
+HT_Ht* _HT_versioned_clone(HT_Ht* source, int arena) {
+    HT_Ht* copy = HT_create(source->size);
+    HT_set_hash(copy, source->hash_fn, source->seed);
+    HT_set_shrink(copy, source->shrink);
+    HT_use_huge_pages(copy, source->huge_pages);
+    if (source->interleave)
+        HT_use_interleave(copy);
+    if (source->node_arena || arena)
+        HT_use_arena(copy);
+    // Versions borrowing or interning their keys share them with the copy.
+    if (source->borrow_keys)
+        HT_borrow_keys(copy);
+    if (source->intern)
+        HT_use_intern(copy, source->intern);
+    if (source->index)
+        HT_use_index(copy);
+    size_t chain_size = 16;
+    HT_Node** chain = malloc(sizeof(HT_Node*) * chain_size);
+    // Sealed versions are never being rehashed, so only `nodes` is walked.
+    for (size_t x = 0; x < source->capacity; x++) {
+        size_t length = 0;
+        for (HT_Node* node = source->nodes[x]; node; node = node->next) {
+            if (length == chain_size) {
+                chain_size *= 2;
+                chain = realloc(chain, sizeof(HT_Node*) * chain_size);
+            }
+            chain[length++] = node;
+        }
+        // Adding a chain backwards rebuilds it in the same order.
+        while (length--)
+            HT_add_bytes(copy, chain[length]->key, chain[length]->key_len, chain[length]->value);
+    }
+    free(chain);
+    return copy;
+}
+
+/**
+ * @brief Build the replica of a sealed version for one NUMA node. The
+ * calling thread prefers the node's memory while it copies, so the pages
+ * it touches first come from the node. That covers arrays of buckets
+ * mapped on their own and most arena slabs, which replicas carve their
+ * nodes and keys from. Memory `malloc` hands back from earlier frees,
+ * such as the smaller arrays and slabs, may already sit on another node:
+ * placement is a best effort, not a guarantee.
+ *
+ * @param source - The sealed version to replicate.
+ * @param node - The node to place the replica on.
+ * @return HT_Ht* - The sealed replica.
+ */
+HT_Ht* _HT_versioned_place(HT_Ht* source, int node) {
+    // The thread's own policy is put back afterwards. A policy that
+    // cannot be saved is left alone, and the replica placed by it.
+    HT_Numa_policy policy;
+    int saved = HT_numa_save(&policy);
+    if (saved)
+        HT_numa_prefer(node);
+    HT_Ht* replica = _HT_versioned_clone(source, 1);
+    if (saved)
+        HT_numa_restore(&policy);
+    _HT_versioned_seal(replica);
+    return replica;
+}
+
+/**
+ * @brief Replace the current version with a new one in a single atomic
+ * swap. Readers see either the old version or the new one, never a mix,
+ * and are not slowed down by the swap. Replicas are swapped first, one by
+ * one, and the version number is incremented last. The old version is destroyed once
+ * the last reader that may hold it has unpinned it.
+ *
+ * @param v_table - The table to publish to.
+ * @param next - The new version, owned by the versioned table from now
+ * on. It must not be in cache mode nor walked by an iterator, and must
+ * not be changed after this call.
+ * @return int - 1 if the version was published, 0 otherwise.
+ */
+int HT_versioned_publish(HT_Versioned* v_table, HT_Ht* next) {
+    pthread_mutex_lock(&v_table->lock);
+    if (!_HT_versioned_seal(next)) {
+        pthread_mutex_unlock(&v_table->lock);
+        return 0;
+    }
+    // Replicas are swapped in one by one, each reader seeing the old or
+    // the new version of its own node.
+    for (unsigned int i = 0; i < v_table->replicas; i++) {
+        HT_Ht* replica = _HT_versioned_place(next, i);
+        HT_ebr_retire(atomic_exchange(&v_table->local[i], replica), _HT_versioned_free);
+    }
+    HT_Ht* old = atomic_exchange(&v_table->current, next);
+    // Counted only once every replica and `current` are swapped, so a
+    // reader may already see the new version while the old number is
+    // still reported, but never the other way around.
+    atomic_fetch_add(&v_table->version, 1);
+    pthread_mutex_unlock(&v_table->lock);
+    HT_ebr_retire(old, _HT_versioned_free);
+    return 1;
+}
+
+/**
+ * @brief Keep a replica of every version on each NUMA node, so that
+ * readers pinning the table read the replica of the node they run on
+ * instead of sending every lookup of the other nodes across the
+ * interconnect. Replicas are rebuilt from each published version before
+ * it is swapped in, which makes publishing cost a copy per node, and take
+ * as much memory as the version each. Must be called before any reader
+ * uses the table.
+ *
+ * @param v_table - The table to replicate.
+ * @param nodes - The amount of replicas, or 0 for one per node of the
+ * machine. Readers of node `n` read replica `n % nodes`.
+ * @return int - 1 if the table is now replicated, 0 if it already was,
+ * or if 0 was given and the machine has a single node.
+ */
+int HT_versioned_replicate(HT_Versioned* v_table, unsigned int nodes) {
+    if (!nodes && (nodes = HT_numa_nodes()) <= 1) return 0;
+    if (nodes > HT_NUMA_MAX_NODES) nodes = HT_NUMA_MAX_NODES;
+    pthread_mutex_lock(&v_table->lock);
+    if (v_table->local) {
+        pthread_mutex_unlock(&v_table->lock);
+        return 0;
+    }
+    HT_Ht* current = atomic_load(&v_table->current);
+    v_table->local = malloc(sizeof(*v_table->local) * nodes);
+    for (unsigned int i = 0; i < nodes; i++)
+        atomic_init(&v_table->local[i], _HT_versioned_place(current, i));
+    v_table->replicas = nodes;
+    pthread_mutex_unlock(&v_table->lock);
+    return 1;
+}
+
+/**
+ * @brief Copy the current version into a new, private table that can be
+ * changed and later published with `HT_versioned_publish`. The copy uses
+ * the same hash function, seed, allocation strategy, key storage and
+ * ordered index, and holds the keys in the same order, duplicates included.
+ *
+ * @param v_table - The table to copy.
+ * @return HT_Ht* - The copy, owned by the caller until it is published.
+ */
+HT_Ht* HT_versioned_copy(HT_Versioned* v_table) {
+    // The version itself is copied rather than a replica, whose storage
+    // is chosen for its node.
+    HT_ebr_enter();
+    HT_Ht* copy = _HT_versioned_clone(atomic_load_explicit(&v_table->current, memory_order_acquire), 0);
+    HT_ebr_exit();
+    return copy;
+}
+
+/**
+ * @brief Pin the current version, to read it without any lock. The
+ * version stays valid, and unchanged, until `HT_versioned_unpin`, even if
+ * a new one is published meanwhile. It may be searched with `HT_get`,
+ * `HT_check` and `HT_find`, and walked by its buckets, but never changed.
+ *
+ * @param v_table - The table to read.
+ * @return HT_Ht* - The current version, or its replica for the NUMA node
+ * of the calling thread if the table is replicated.
+ */
+HT_Ht* HT_versioned_pin(HT_Versioned* v_table) {
+    HT_ebr_enter();
+    if (v_table->local)
+        return atomic_load_explicit(&v_table->local[HT_numa_node() % v_table->replicas], memory_order_acquire);
+    return atomic_load_explicit(&v_table->current, memory_order_acquire);
+}
+
+/**
+ * @brief Unpin the version pinned by the last `HT_versioned_pin` of the
+ * calling thread.
+ */
+void HT_versioned_unpin(void) {
+    HT_ebr_exit();
+}
+
+/**
+ * @brief Find the value of the provided key in the current version.
+ *
+ * @param v_table - The table to search.
+ * @param key - The key to search for.
+ * @param out - Set to the value of the key if it is found. May be NULL.
+ * @return int - 1 if found, 0 if not found.
+ */
+int HT_versioned_get(HT_Versioned* v_table, char* key, int* out) {
+    HT_Ht* current = HT_versioned_pin(v_table);
+    int found = HT_get(current, key, out);
+    HT_versioned_unpin();
+    return found;
+}
+
+/**
+ * @brief Determine whether or not the provided key exists within the
+ * current version.
+ *
+ * @param v_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - 0 if not found, 1 if found.
+ */
+int HT_versioned_check(HT_Versioned* v_table, char* key) {
+    return HT_versioned_get(v_table, key, NULL);
+}
+
+/**
+ * @brief Find the value of the provided key in the current version.
+ * Unlike `HT_find`, missing keys are safe, since a new version may drop
+ * a key at any time.
+ *
+ * @param v_table - The table to search.
+ * @param key - The key to search for.
+ * @return int - The value of the key, or 0 if it is missing.
+ */
+int HT_versioned_find(HT_Versioned* v_table, char* key) {
+    int value = 0;
+    HT_versioned_get(v_table, key, &value);
+    return value;
+}
+
+/**
+ * @brief Find how many versions have been published, the first one
+ * included. Readers can compare it between calls to notice a reload.
+ * The number grows once a publish has swapped in the version and all its
+ * replicas, so a pinned version may be newer than the number read before
+ * pinning, but a number read after its change implies the new version.
+ *
+ * @param v_table - The table to query.
+ * @return uint64_t - The number of the current version.
+ */
+uint64_t HT_versioned_version(HT_Versioned* v_table) {
+    return atomic_load(&v_table->version);
+}
+
+/**
+ * @brief Destroy the provided table, its current version and every
+ * replaced version still waiting for readers. No other thread may use
+ * the table anymore.
+ *
+ * @param v_table - The table to destroy.
+ */
+void HT_versioned_destroy(HT_Versioned* v_table) {
+    HT_ebr_barrier();
+    HT_destroy(atomic_load(&v_table->current));
+    for (unsigned int i = 0; i < v_table->replicas; i++)
+        HT_destroy(atomic_load(&v_table->local[i]));
+    free(v_table->local);
+    pthread_mutex_destroy(&v_table->lock);
+    free(v_table);
+}
@@ -0,0 +1,43 @@
+/**
+ * @file versioned_table.h
+ * @author Edouard Desparois-Perrault (eperrault23@andover.edu)
+ * @brief Header definitions for hash tables published as immutable
+ * versions, read without locks while new versions are built and swapped in.
+ * @version 0.1
+ * @date 2022-06-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+struct HT_ht;
+
+struct HT_versioned {
+    _Atomic(struct HT_ht *) current; // The published version. Never written to.
+    _Atomic uint64_t version; // Incremented by every publish, after its swaps.
+    pthread_mutex_t lock; // Serializes writers.
+    // Read-only copies of the current version, one per NUMA node, that
+    // readers pin instead of `current`. NULL unless `HT_versioned_replicate`
+    // was called.
+    unsigned int replicas;
+    _Atomic(struct HT_ht *) * local;
+};
+
+typedef struct HT_versioned HT_Versioned;
+
+HT_Versioned* HT_versioned_create(struct HT_ht * initial);
+int HT_versioned_publish(HT_Versioned* v_table, struct HT_ht * next);
+struct HT_ht * HT_versioned_copy(HT_Versioned* v_table);
+int HT_versioned_replicate(HT_Versioned* v_table, unsigned int nodes);
+struct HT_ht * HT_versioned_pin(HT_Versioned* v_table);
+void HT_versioned_unpin(void);
+int HT_versioned_get(HT_Versioned* v_table, char* key, int* out);
+int HT_versioned_check(HT_Versioned* v_table, char* key);
+int HT_versioned_find(HT_Versioned* v_table, char* key);
+uint64_t HT_versioned_version(HT_Versioned* v_table);
+void HT_versioned_destroy(HT_Versioned* v_table);